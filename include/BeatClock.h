@@ -0,0 +1,148 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BEATCLOCK_H_
+#define _BEATCLOCK_H_
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "typedefs.h"
+
+/**
+ * @brief   MIDI beat clock (24 ticks per quarter note) of a song with a constant tempo
+ *
+ * Ticks are counted from the start of the song, so their xmms2 time follows from the tick
+ * number without accumulating rounding errors. Relocations are only possible to sixteenth
+ * notes, as the Song Position Pointer counts in sixteenth notes ("MIDI beats").
+ */
+class BeatClock
+{
+    public:
+        /**
+         * @brief   Ticks per quarter note
+         */
+        static const int                        cPpqn = 24;
+
+        /**
+         * @brief   Ticks per sixteenth note (unit of the Song Position Pointer)
+         */
+        static const int                        cTicksPerSixteenth = cPpqn / 4;
+
+        /**
+         * @brief   Largest position a Song Position Pointer can express
+         */
+        static const int                        cMaxPosition = 0x3FFF;
+
+        /**
+         * @brief   Constructor. No tempo is known yet.
+         */
+        BeatClock() : _dfBpm( 0 ), _cTick( 0 )
+        {
+        }
+
+        /**
+         * @brief   Set the tempo
+         * @param   dfBpm
+         *              Quarter notes per minute or 0 if unknown
+         */
+        void setTempo( double dfBpm )
+        {
+            _dfBpm = dfBpm;
+        }
+
+        /**
+         * @brief   Get the tempo
+         * @return  Quarter notes per minute or 0 if unknown
+         */
+        double getTempo() const
+        {
+            return _dfBpm;
+        }
+
+        /**
+         * @brief   Indicate if a tempo is known
+         */
+        bool isValid() const
+        {
+            return _dfBpm > 0;
+        }
+
+        /**
+         * @brief   Get the xmms2 time of a tick
+         * @param   cTick
+         *              Tick number counted from the start of the song
+         * @return  Time in us
+         */
+        int64_t tickUs( int64_t cTick ) const
+        {
+            return static_cast<int64_t>( cTick * 60e6 / ( _dfBpm * cPpqn ) + 0.5 );
+        }
+
+        /**
+         * @brief   Get the first sixteenth note at or after a time
+         * @param   xtime
+         *              xmms2 time in ms
+         * @return  Sixteenth notes counted from the start of the song
+         */
+        int sixteenthAt( XTimePoint xtime ) const
+        {
+            return static_cast<int>( std::ceil( std::max( xtime, 0 ) * _dfBpm / 15000.0 - 1e-9 ) );
+        }
+
+        /**
+         * @brief   Build a Song Position Pointer message
+         * @param   iSixteenth
+         *              Position in sixteenth notes, clipped to {@link cMaxPosition}
+         */
+        static MidiMsg songPosition( int iSixteenth )
+        {
+            iSixteenth = std::min( iSixteenth, static_cast<int>( cMaxPosition ) );
+            return MIDI_MSG_SHORT( 0xF2, iSixteenth, iSixteenth >> 7 );
+        }
+
+        /**
+         * @brief   Move the tick counter to a sixteenth note
+         */
+        void locate( int iSixteenth )
+        {
+            _cTick = static_cast<int64_t>( iSixteenth ) * cTicksPerSixteenth;
+        }
+
+        /**
+         * @brief   Get the number of the next tick to send
+         */
+        int64_t tick() const
+        {
+            return _cTick;
+        }
+
+        /**
+         * @brief   Count the next tick as sent
+         */
+        void advance()
+        {
+            ++_cTick;
+        }
+
+    private:
+        double                                  _dfBpm;
+        int64_t                                 _cTick; // next tick to send
+};
+
+#endif // ifndef _BEATCLOCK_H_
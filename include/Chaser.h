@@ -0,0 +1,185 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHASER_H_
+#define _CHASER_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "typedefs.h"
+#include "Status.h"
+#include "ClockEstimator.h"
+
+/**
+ * @brief   Decide how XMMS2 follows an external time code master
+ *
+ * XMMS2 cannot vary its playback speed, so it is kept in sync by play, pause and seek
+ * commands only:
+ * - The master position is extrapolated with its rate, estimated by a regression over the
+ *   received positions (outliers from late deliveries are rejected).
+ * - Hysteresis: a locked slave is only resynced if it is off by more than cUnlock. After a
+ *   seek it counts as locked within cLock (or cUnlock after cMaxRetries seeks).
+ * - Seeks are at least cSeekHoldoff apart and each one is judged by the first status
+ *   reported after it has settled. The offset observed there (decoder and output delays)
+ *   is learned and applied to the following seeks.
+ */
+class Chaser
+{
+    public:
+        /**
+         * @brief   Transport commands
+         */
+        enum EAction
+        {
+            ECA_NONE,               ///< nothing to do
+            ECA_PLAY,               ///< start playback
+            ECA_PAUSE,              ///< pause playback
+            ECA_SEEK,               ///< seek to a position
+        };
+
+        /**
+         * @brief   The master counts as stopped without time code for this time
+         */
+        static const LTimePoint                 cMasterTimeout = 200 * LTimeMs;
+
+        /**
+         * @brief   Error (ms) below which a slave counts as locked after a seek
+         */
+        static const XTimePoint                 cLock = 30;
+
+        /**
+         * @brief   Error (ms) above which a locked slave is resynced
+         */
+        static const XTimePoint                 cUnlock = 100;
+
+        /**
+         * @brief   Minimum time between two seeks
+         */
+        static const LTimePoint                 cSeekHoldoff = 500 * LTimeMs;
+
+        /**
+         * @brief   Statuses earlier than this after a seek may still show the old position
+         */
+        static const LTimePoint                 cSettle = 150 * LTimeMs;
+
+        /**
+         * @brief   Seeks to reach cLock before settling for cUnlock
+         */
+        static const int                        cMaxRetries = 3;
+
+        /**
+         * @brief   Limit of the learned seek lead (ms)
+         */
+        static const XTimePoint                 cMaxBias = 1000;
+
+        /**
+         * @brief   Constructor
+         * @param   xOffset
+         *              Time code (ms) at which a song starts
+         */
+        Chaser( XTimePoint xOffset = 0 );
+
+        /**
+         * @brief   Feed a master position
+         * @param   lUs
+         *              Time code as time in us
+         * @param   ltime
+         *              Local time of the position
+         * @param   fLocate
+         *              The position does not follow the previous one
+         */
+        void master( int64_t lUs, LTimePoint ltime, bool fLocate );
+
+        /**
+         * @brief   Feed a status of XMMS2
+         */
+        void slave( const Status& grStatus );
+
+        /**
+         * @brief   Get the next transport command
+         * @param   lNow
+         *              Current local time
+         * @param   xSeek
+         *              Receives the position (ms) for ECA_SEEK
+         * @return  Command; the caller is expected to execute it right away
+         */
+        EAction decide( LTimePoint lNow, XTimePoint& xSeek );
+
+        /**
+         * @brief   Indicate if the slave is locked to the running master
+         */
+        bool isLocked() const
+        {
+            return _fLocked;
+        }
+
+        /**
+         * @brief   Get the learned lead of seek targets over the master position
+         * @return  Lead in ms (positive if XMMS2 ends up behind a seek target)
+         */
+        XTimePoint getSeekBias() const
+        {
+            return _xBias;
+        }
+
+    private:
+        /**
+         * @brief   Get the song position of the master
+         * @param   lTime
+         *              Local time
+         * @return  Song position in ms (negative before the song start)
+         */
+        XTimePoint masterAt( LTimePoint lTime ) const;
+
+        /**
+         * @brief   Get the song position of XMMS2
+         */
+        XTimePoint slaveAt( LTimePoint lTime ) const;
+
+        /**
+         * @brief   Indicate if the master is running
+         */
+        bool isMasterRunning( LTimePoint lNow ) const;
+
+        /**
+         * @brief   Seek to the master position
+         */
+        EAction seek( LTimePoint lNow, XTimePoint& xSeek );
+
+    private:
+        XTimePoint                              _xOffset;
+
+        // master
+        std::unique_ptr<ClockEstimator>         _pgrEstimator; // rate of the master (local ns per ms)
+        TimePoint                               _tMaster; // last master position (time code ms)
+        int                                     _cMaster; // positions since the last locate
+        bool                                    _fLocatePending; // follow a locate while stopped
+
+        // slave
+        Status                                  _grSlave;
+
+        // control
+        bool                                    _fLocked;
+        bool                                    _fStartPending; // play after the seek
+        LTimePoint                              _lLastSeek;
+        bool                                    _fMeasure; // judge the last seek by the next status
+        int                                     _cRetries;
+        XTimePoint                              _xBias; // learned seek lead
+};
+
+#endif // ifndef _CHASER_H_
@@ -0,0 +1,86 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include <time.h>
+
+#include <portmidi.h>
+
+#include "typedefs.h"
+
+/**
+ * @brief   Conversions between the local time base ({@link Now()}) and other clocks
+ *
+ * PortMidi works with millisecond time stamps of its time_proc. Passing {@link pmTimeProc()}
+ * to Pm_OpenOutput() makes PortMidi use the same raw monotonic clock as the rest of the
+ * program, so time stamps computed from LTimePoint values are exact up to PortMidi's
+ * resolution. Sleeping is only possible on CLOCK_MONOTONIC, so deadlines are mapped onto
+ * that clock right before they are used.
+ */
+class Clock
+{
+    public:
+        /**
+         * @brief   Time procedure for PortMidi
+         * @param   pv
+         *              Unused
+         * @return  Current local time in milliseconds relative to {@link origin()}
+         */
+        static PmTimestamp pmTimeProc( void* pv );
+
+        /**
+         * @brief   Convert a local time into a PortMidi time stamp of {@link pmTimeProc()}
+         * @param   lTime
+         *              Local time
+         * @return  PortMidi time stamp (rounded to the nearest millisecond)
+         */
+        static PmTimestamp toPm( LTimePoint lTime )
+        {
+            return static_cast<PmTimestamp>( ( lTime - origin() + LTimeMs / 2 ) / LTimeMs );
+        }
+
+        /**
+         * @brief   Convert a PortMidi time stamp of {@link pmTimeProc()} into a local time
+         * @param   ts
+         *              PortMidi time stamp (e.g. reception time of an input event)
+         * @return  Local time
+         */
+        static LTimePoint fromPm( PmTimestamp ts )
+        {
+            return origin() + static_cast<LTimePoint>( ts ) * LTimeMs;
+        }
+
+        /**
+         * @brief   Convert a local time into a CLOCK_MONOTONIC time (for absolute timers)
+         * @param   lTime
+         *              Local time
+         * @return  Corresponding CLOCK_MONOTONIC time
+         */
+        static struct timespec toMonotonic( LTimePoint lTime );
+
+        /**
+         * @brief   Origin of PortMidi time stamps
+         * @return  Local time of the first call
+         *
+         * PortMidi time stamps have 32 bits only, so they count from program start.
+         */
+        static LTimePoint origin();
+};
+
+#endif // ifndef _CLOCK_H_
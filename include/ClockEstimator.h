@@ -0,0 +1,164 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CLOCKESTIMATOR_H_
+#define _CLOCKESTIMATOR_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "typedefs.h"
+
+/**
+ * @brief   Estimate the relation between xmms2 playtime and local time from status samples
+ *
+ * Implementations are fed with the time points of consecutive statuses of one continuous
+ * playback segment and output a slope (in the fixed-point format of {@link TimeModel}), a
+ * point on the estimated line and a confidence value.
+ */
+class ClockEstimator
+{
+    public:
+        /**
+         * @brief   Available estimators
+         */
+        enum EClockEstimator
+        {
+            ECE_TWOPOINT,       ///< slope from the last two samples
+            ECE_REGRESSION,     ///< sliding window least squares with outlier rejection
+        };
+
+        /**
+         * @brief   Outcome of adding a sample
+         */
+        enum ESample
+        {
+            ES_ACCEPTED,        ///< sample is part of the estimate
+            ES_STALE,           ///< xmms2 time did not advance (e.g. a repeated status)
+            ES_OUTLIER,         ///< sample is too far from the current fit
+        };
+
+        /**
+         * @brief   Result of an estimation
+         */
+        struct Estimate
+        {
+            int64_t lSlope;                 ///< local ns per xmms2 ms, TimeModel::cFracBits fractional bits
+            TimePoint grAnchor;             ///< point on the estimated line at the newest sample
+            double dfConfidence;            ///< 0 (no idea) to 1 (perfect fit)
+        };
+
+        /**
+         * @brief   Create an estimator
+         * @param   iType
+         *              Element of EClockEstimator
+         * @return  New estimator
+         */
+        static std::unique_ptr<ClockEstimator> create( EClockEstimator iType );
+
+        virtual ~ClockEstimator() {}
+
+        /**
+         * @brief   Forget all samples (e.g. after a jump or a pause)
+         */
+        virtual void reset() = 0;
+
+        /**
+         * @brief   Add a sample
+         * @param   t
+         *              Time point of a status
+         * @return  Element of ESample
+         */
+        virtual ESample addSample( const TimePoint& t ) = 0;
+
+        /**
+         * @brief   Get the current estimate
+         * @param   grEstimate
+         *              Written if an estimate is available
+         * @return  False if there are not enough samples yet
+         */
+        virtual bool getEstimate( Estimate& grEstimate ) const = 0;
+};
+
+/**
+ * @brief   Slope from the last two samples, line through the newest one
+ *
+ * Every jitter in the signal delivery goes straight into the estimate.
+ */
+class TwoPointEstimator : public ClockEstimator
+{
+    public:
+        TwoPointEstimator();
+
+        virtual void reset();
+        virtual ESample addSample( const TimePoint& t );
+        virtual bool getEstimate( Estimate& grEstimate ) const;
+
+    private:
+        TimePoint                   _rgt[ 2 ]; // older, newer
+        int                         _cSamples;
+};
+
+/**
+ * @brief   Least squares fit over a sliding window of samples
+ *
+ * Sums are kept incrementally in exact integer arithmetic relative to a reference sample,
+ * so adding a sample is O(1) (the reference is moved once per window length). A sample
+ * whose distance from the current fit exceeds a multiple of the typical distance is
+ * rejected. If several samples in a row are rejected, the fit is considered outdated and
+ * restarted from the newest sample.
+ */
+class RegressionEstimator : public ClockEstimator
+{
+    public:
+        /**
+         * @brief   Window size (number of samples)
+         */
+        static const int            cWindow = 32;
+
+        RegressionEstimator();
+
+        virtual void reset();
+        virtual ESample addSample( const TimePoint& t );
+        virtual bool getEstimate( Estimate& grEstimate ) const;
+
+    private:
+        /**
+         * @brief   Recompute all sums relative to the oldest sample in the window
+         */
+        void rebase();
+
+        /**
+         * @brief   Distance of a sample from the current fit
+         */
+        LTimePoint residual( const TimePoint& t ) const;
+
+    private:
+        TimePoint                   _rgt[ cWindow ]; // ring of samples
+        int                         _iNext; // next ring slot
+        int                         _cSamples; // samples in ring
+        int                         _cAdded; // samples added since the last rebase
+        int                         _cRejected; // consecutive rejections
+
+        TimePoint                   _tRef; // reference of the sums
+        int64_t                     _lSx, _lSy, _lSxx; // relative sums
+        __int128                    _lSxy;
+
+        double                      _dfScale; // running mean of absolute residuals
+};
+
+#endif // ifndef _CLOCKESTIMATOR_H_
@@ -36,6 +36,10 @@
 
 #include "typedefs.h"
 #include "SongIdNotifier.h"
+#include "ClockEstimator.h"
+#include "Timecode.h"
+#include "Metrics.h"
+#include "MidiOut.h"
 
 /**
  * @brief   Parse and validate command line options/config files provided for
@@ -55,6 +59,15 @@ class Config {
             EMTF_30,        ///< NTSC non-drop (30 FPS)
         };
 
+        /**
+         * @brief   Threading model
+         */
+        enum EEngine
+        {
+            EE_THREADED,    ///< XMMS2 client and MIDI master run in separate threads
+            EE_EPOLL,       ///< single thread multiplexing XMMS2 and MIDI timers using epoll
+        };
+
         /**
          * @brief   Constructor. Parse argc/argv, read config files and print usage message(s).
          * @param   argc
@@ -80,6 +93,27 @@ class Config {
             return _iFPS;
         }
 
+        /**
+         * @brief   Get the frame rate bits of the time code
+         * @return  Rate bits as in the hour byte (see {@link FrameRate}) or -1 for no time code
+         */
+        int getRateBits() const
+        {
+            switch( _iFPS )
+            {
+                case EMTF_24:
+                    return FrameRate24::bRate;
+                case EMTF_25:
+                    return FrameRate25::bRate;
+                case EMTF_2997:
+                    return FrameRate2997::bRate;
+                case EMTF_30:
+                    return FrameRate30::bRate;
+                default:
+                    return -1;
+            }
+        }
+
         /**
          * @brief   Get the song begin notifier to send MIDI messages when a song begins
          * @return  Reference to a {@link SongIdNotifier}
@@ -107,6 +141,24 @@ class Config {
             return _iDevice;
         }
 
+        /**
+         * @brief   Get the MIDI output backend
+         * @return  Element of MidiOut::EMidiOut
+         */
+        MidiOut::EMidiOut getMidiOut() const
+        {
+            return _iMidiOut;
+        }
+
+        /**
+         * @brief   Get the ALSA sequencer port to connect to
+         * @return  Port (e.g. "20:0") or an empty string to wait for subscribers
+         */
+        const std::string& getAlsaPort() const
+        {
+            return _szAlsaPort;
+        }
+
         /**
          * @brief   Get the XMMS2 path
          * @return  Path to connect to (e.g. tcp path)
@@ -121,6 +173,236 @@ class Config {
             return _szXmmsPath;
         }
 
+        /**
+         * @brief   Get the threading model
+         * @return  Element of EEngine
+         */
+        EEngine getEngine() const
+        {
+            return _iEngine;
+        }
+
+        /**
+         * @brief   Get the estimator relating xmms2 playtime to local time
+         * @return  Element of ClockEstimator::EClockEstimator
+         */
+        ClockEstimator::EClockEstimator getClockEstimator() const
+        {
+            return _iClockEstimator;
+        }
+
+        /**
+         * @brief   Get the lower bound of the scheduling lookahead
+         * @return  Lookahead in ms
+         */
+        int getLookaheadMin() const
+        {
+            return _iLookaheadMin;
+        }
+
+        /**
+         * @brief   Get the upper bound of the scheduling lookahead
+         * @return  Lookahead in ms
+         */
+        int getLookaheadMax() const
+        {
+            return _iLookaheadMax;
+        }
+
+        /**
+         * @brief   Get how long time code is extrapolated when XMMS2 stops sending statuses
+         * @return  Freewheel window in ms
+         */
+        int getFreewheel() const
+        {
+            return _iFreewheel;
+        }
+
+        /**
+         * @brief   Indicate if song signals shall be sent at the predicted end of a song
+         * @return  True if song changes are predicted
+         */
+        bool predictSongChanges() const
+        {
+            return _fPredict;
+        }
+
+        /**
+         * @brief   Get the latency of the MIDI interface and the devices behind it
+         * @return  Latency in ns. Messages are sent earlier by this time.
+         */
+        LTimePoint getMidiLatency() const
+        {
+            return _lMidiLatency;
+        }
+
+        /**
+         * @brief   Get the latency between XMMS2's playtime and the audible audio
+         * @return  Latency in ns (only valid if {@link isAudioLatencyAuto()} is false)
+         */
+        LTimePoint getAudioLatency() const
+        {
+            return _lAudioLatency;
+        }
+
+        /**
+         * @brief   Indicate if the audio latency shall be derived from XMMS2's output buffer
+         * @return  True if the latency is queried from XMMS2
+         */
+        bool isAudioLatencyAuto() const
+        {
+            return _fAudioLatencyAuto;
+        }
+
+        /**
+         * @brief   Indicate if MIDI beat clock shall be sent
+         * @return  True if clock, start/continue/stop and song position are sent
+         */
+        bool sendBeatClock() const
+        {
+            return _fBeatClock;
+        }
+
+        /**
+         * @brief   Get the configured tempo of a song
+         * @param   ilSongId
+         *              xmms2 song id
+         * @return  Beats per minute or 0 if the medialib shall be asked
+         */
+        double getTempo( XSongId ilSongId ) const
+        {
+            TempoMap::const_iterator i = _mpdfTempo.find( ilSongId );
+            return i != _mpdfTempo.end() ? i->second : 0;
+        }
+
+        /**
+         * @brief   Get the device id MIDI Machine Control commands are addressed to
+         * @return  Device id (0x7F for all devices) or -1 if no MMC is sent
+         */
+        int getMmcDevice() const
+        {
+            return _iMmcDevice;
+        }
+
+        /**
+         * @brief   Get the directory to export Standard MIDI Files into
+         * @return  Path or an empty string if MIDI is sent live
+         */
+        const std::string& getExportDir() const
+        {
+            return _szExportDir;
+        }
+
+        /**
+         * @brief   Get the file listing the songs to export
+         * @return  Path or an empty string to read XMMS2's playlist
+         */
+        const std::string& getExportSongs() const
+        {
+            return _szExportSongs;
+        }
+
+        /**
+         * @brief   Get the file LTC audio is rendered into
+         * @return  Path ("-" for stdout) or an empty string if no LTC is rendered
+         */
+        const std::string& getLtcFile() const
+        {
+            return _szLtcFile;
+        }
+
+        /**
+         * @brief   Get the MIDI input device to chase time code from
+         * @return  PortMidi device id or -1 if time code is sent instead
+         */
+        PmDeviceID getChaseDevice() const
+        {
+            return _iChaseDevice;
+        }
+
+        /**
+         * @brief   Get the time code at which the current song starts in chase mode
+         * @return  Offset in ms
+         */
+        XTimePoint getChaseOffset() const
+        {
+            return _xChaseOffset;
+        }
+
+        /**
+         * @brief   Get the bit rate of the MIDI link
+         * @return  Bit rate (31250 for DIN MIDI) or 0 if the link is not limited
+         */
+        int getWireBaud() const
+        {
+            return _iWireBaud;
+        }
+
+        /**
+         * @brief   Indicate if the MIDI link applies running status to channel messages
+         * @return  True if repeated status bytes are omitted on the link
+         */
+        bool useRunningStatus() const
+        {
+            return _fRunningStatus;
+        }
+
+        /**
+         * @brief   Get the file the clock drift is persisted in
+         * @return  Path or an empty string if the drift shall not be persisted
+         */
+        const std::string& getDriftFile() const
+        {
+            return _szDriftFile;
+        }
+
+        /**
+         * @brief   Get the interval to print metrics at
+         * @return  Interval in seconds or 0 to disable
+         */
+        int getMetricsInterval() const
+        {
+            return _iMetricsInterval;
+        }
+
+        /**
+         * @brief   Get the real-time priority of the MIDI thread
+         * @return  SCHED_FIFO priority or 0 to run at normal priority
+         */
+        int getRealtimePriority() const
+        {
+            return _iRtPriority;
+        }
+
+        /**
+         * @brief   Get the number of additional output devices
+         * @return  Number of "--output" options
+         */
+        size_t getOutputCount() const
+        {
+            return _rggrOutput.size();
+        }
+
+        /**
+         * @brief   Get the configuration of an additional output device
+         * @param   i
+         *              Index of the output [0..getOutputCount())
+         * @return  Copy of this configuration with device, frame rate, MIDI latency, link
+         *          settings and song notifiers of the output, sending through PortMidi. LTC,
+         *          chase mode, export and further outputs are disabled. The song notifiers keep
+         *          using this object's id map, so the copy must not outlive this object.
+         */
+        Config forOutput( size_t i ) const;
+
+        /**
+         * @brief   Get the index of the output this configuration belongs to
+         * @return  0 for the main device ("-d"), 1... for the additional outputs
+         */
+        unsigned int getOutputIndex() const
+        {
+            return _iOutput;
+        }
+
         /**
          * @brief   Indicate if we shall be verbose
          * @return  True if verbosity requested
@@ -131,6 +413,27 @@ class Config {
         }
 
     private:
+        /**
+         * @brief   Settings of an additional output device
+         */
+        struct Output
+        {
+            PmDeviceID              iDevice;
+            EMidiTimecodeFramerate  iFPS;
+            LTimePoint              lMidiLatency;
+            int                     iWireBaud;
+            bool                    fRunningStatus;
+            SongIdNotifier          grBegin;
+            SongIdNotifier          grEnd;
+        };
+
+        /**
+         * @brief   Parse the value of an "--output" option and append the output
+         * @param   szOutput
+         *              <device>[,<option>=<value>...]
+         * @return  True if successful, otherwise false
+         */
+        bool _parseOutput( const std::string& szOutput );
 
         bool                    _fOk; // indicate if parsing succeeded
 
@@ -143,6 +446,33 @@ class Config {
         
         PmDeviceID              _iDevice;
         std::string             _szXmmsPath;
+
+        EEngine                 _iEngine;
+        int                     _iRtPriority;
+        ClockEstimator::EClockEstimator _iClockEstimator;
+        int                     _iLookaheadMin;
+        int                     _iLookaheadMax;
+        int                     _iMetricsInterval;
+        int                     _iFreewheel;
+        bool                    _fPredict;
+        LTimePoint              _lMidiLatency;
+        LTimePoint              _lAudioLatency;
+        bool                    _fAudioLatencyAuto;
+        int                     _iWireBaud;
+        bool                    _fRunningStatus;
+        bool                    _fBeatClock;
+        TempoMap                _mpdfTempo;
+        int                     _iMmcDevice;
+        std::string             _szExportDir;
+        std::string             _szExportSongs;
+        std::string             _szLtcFile;
+        PmDeviceID              _iChaseDevice;
+        XTimePoint              _xChaseOffset;
+        std::string             _szDriftFile;
+        MidiOut::EMidiOut       _iMidiOut;
+        std::string             _szAlsaPort;
+        std::vector<Output>     _rggrOutput;
+        unsigned int            _iOutput;
 };
 
 #endif // ifndef _CONFIG_H_
@@ -0,0 +1,203 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DRIFTESTIMATOR_H_
+#define _DRIFTESTIMATOR_H_
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+
+#include "typedefs.h"
+#include "TimeModel.h"
+
+/**
+ * @brief   Long-horizon estimate of the audio clock rate relative to the host clock
+ *
+ * XMMS2 playtime advances with the sample clock of the sound card, local time with the host
+ * clock. Their ratio hardly changes, so it is learned over all playback segments (songs,
+ * pause to pause) instead of per segment: local and xmms2 time spans of finished segments
+ * are summed up and weighted towards the last cHorizon of playback. A segment still running
+ * is included.
+ *
+ * The drift is the deviation of the ratio from 1 in ppm (positive if the sound card is slow
+ * compared to the host clock).
+ */
+class DriftEstimator
+{
+    public:
+        /**
+         * @brief   xmms2 time needed before the estimate is valid (ms)
+         */
+        static const XTimePoint                 cMinSpan = 30000;
+
+        /**
+         * @brief   Shorter segments are ignored, as the jitter of their end points dominates (ms)
+         */
+        static const XTimePoint                 cMinSegment = 5000;
+
+        /**
+         * @brief   Older segments fade out once this much playback has been seen (ms)
+         */
+        static const int64_t                    cHorizon = 6LL * 3600 * 1000;
+
+        /**
+         * @brief   Weight of a persisted estimate (ms of playback)
+         */
+        static const XTimePoint                 cPrior = 600000;
+
+        /**
+         * @brief   Constructor. No estimate
+         */
+        DriftEstimator() : _dfSumL( 0 ), _dfSumX( 0 ), _fSegment( false )
+        {
+        }
+
+        /**
+         * @brief   Start from an estimate of a previous run
+         * @param   dfPpm
+         *              Drift in ppm
+         */
+        void setPrior( double dfPpm )
+        {
+            _dfSumX = cPrior;
+            _dfSumL = cPrior * static_cast<double>( LTimeMs ) * ( 1 + dfPpm * 1e-6 );
+        }
+
+        /**
+         * @brief   Finish the current segment and start a new one
+         * @param   t
+         *              First time point of the new segment
+         */
+        void beginSegment( const TimePoint& t )
+        {
+            commit();
+            _tBegin = _tLast = t;
+            _fSegment = true;
+        }
+
+        /**
+         * @brief   Extend the current segment
+         * @param   t
+         *              Latest (preferably smoothed) time point of the segment
+         */
+        void update( const TimePoint& t )
+        {
+            if( _fSegment && t.xtime > _tLast.xtime )
+                _tLast = t;
+        }
+
+        /**
+         * @brief   Indicate if enough playback has been seen
+         */
+        bool isValid() const
+        {
+            double dfL, dfX;
+            sums( dfL, dfX );
+            return dfX >= cMinSpan;
+        }
+
+        /**
+         * @brief   Get the drift
+         * @return  Drift in ppm (0 if not valid)
+         */
+        double getPpm() const
+        {
+            double dfL, dfX;
+            sums( dfL, dfX );
+            if( dfX < cMinSpan )
+                return 0;
+            return ( dfL / ( dfX * LTimeMs ) - 1 ) * 1e6;
+        }
+
+        /**
+         * @brief   Get the playback time backing the estimate
+         * @return  xmms2 time in ms
+         */
+        int64_t getSpan() const
+        {
+            double dfL, dfX;
+            sums( dfL, dfX );
+            return static_cast<int64_t>( dfX );
+        }
+
+        /**
+         * @brief   Get the rate as slope of a TimeModel
+         * @return  Local nanoseconds per xmms2 millisecond, TimeModel::cFracBits fractional bits
+         */
+        int64_t getSlopeFixed() const
+        {
+            return std::llround( std::ldexp( LTimeMs * ( 1 + getPpm() * 1e-6 ), TimeModel::cFracBits ) );
+        }
+
+        /**
+         * @brief   Read an estimate persisted by {@link save()} and use it as prior
+         * @param   szFile
+         *              Path of the file
+         * @return  False if there was no valid estimate
+         */
+        bool load( const std::string& szFile );
+
+        /**
+         * @brief   Persist a drift
+         * @param   szFile
+         *              Path of the file
+         * @param   dfPpm
+         *              Drift in ppm
+         * @return  False if the file could not be written
+         */
+        static bool save( const std::string& szFile, double dfPpm );
+
+    private:
+        /**
+         * @brief   Get the sums including the current segment
+         */
+        void sums( double& dfL, double& dfX ) const
+        {
+            dfL = _dfSumL;
+            dfX = _dfSumX;
+            if( _fSegment && _tLast.xtime - _tBegin.xtime >= cMinSegment )
+            {
+                dfL += _tLast.ltime - _tBegin.ltime;
+                dfX += _tLast.xtime - _tBegin.xtime;
+            }
+        }
+
+        /**
+         * @brief   Add the current segment to the sums
+         */
+        void commit()
+        {
+            sums( _dfSumL, _dfSumX );
+            _fSegment = false;
+            if( _dfSumX > cHorizon )
+            {
+                double dfScale = cHorizon / _dfSumX;
+                _dfSumL *= dfScale;
+                _dfSumX *= dfScale;
+            }
+        }
+
+    private:
+        double                                  _dfSumL; // local time of finished segments (ns)
+        double                                  _dfSumX; // xmms2 time of finished segments (ms)
+        bool                                    _fSegment;
+        TimePoint                               _tBegin; // current segment
+        TimePoint                               _tLast;
+};
+
+#endif // ifndef _DRIFTESTIMATOR_H_
@@ -0,0 +1,91 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EVENTLOOP_H_
+#define _EVENTLOOP_H_
+
+#include <xmmsclient/xmmsclient++.h>
+
+#include "typedefs.h"
+#include "MidiMaster.h"
+
+/**
+ * @brief   Single-threaded XMMS2 main loop driving the MIDI master as well
+ *
+ * The XMMS2 connection and a timerfd for the next MIDI deadline are multiplexed using epoll.
+ * Status updates written by the XMMS2 callbacks are processed by the MIDI master in the same
+ * thread right after the callbacks returned, so there is no context switch between receiving
+ * a status and emitting MIDI.
+ */
+class EventLoop : public Xmms::MainloopInterface
+{
+    public:
+        /**
+         * @brief   Constructor
+         * @param   conn
+         *              XMMS2 connection to handle
+         * @param   master
+         *              MIDI master to poll
+         * @throws  std::runtime_error
+         */
+        EventLoop( xmmsc_connection_t* conn, MidiMaster& master );
+
+        /**
+         * @brief   Destructor. Close file descriptors.
+         */
+        ~EventLoop();
+
+        EventLoop( const EventLoop& ) = delete;
+        EventLoop& operator=( const EventLoop& ) = delete;
+
+        /**
+         * @brief   Run until the XMMS2 connection is closed
+         */
+        virtual void run();
+
+    private:
+        /**
+         * @brief   Callback of libxmmsclient signalling if there is data to send
+         * @param   fNeedOut
+         *              True if the connection wants to write
+         * @param   pv
+         *              Pointer to the EventLoop
+         */
+        static void needOut( int fNeedOut, void* pv );
+
+        /**
+         * @brief   Update the epoll events of the XMMS2 connection
+         * @param   fOut
+         *              True to wait for the connection to become writable as well
+         */
+        void watchConnection( bool fOut );
+
+        /**
+         * @brief   Arm the timer for the next MIDI deadline (or disarm it)
+         * @return  False if the timer could not be set, the loop would miss the deadlines then
+         */
+        bool armTimer();
+
+    private:
+        MidiMaster&                 _master;
+
+        int                         _fdEpoll;
+        int                         _fdTimer;
+        int                         _fdXmms;
+};
+
+#endif // ifndef _EVENTLOOP_H_
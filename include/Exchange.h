@@ -20,39 +20,167 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <type_traits>
+#include <climits>
+#include <chrono>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 /**
- * @brief   Class provinding a simple mechanism to exchange messages between threads.
+ * @brief   Helpers shared by the lock-free exchange policies
+ */
+namespace ExchangeDetail
+{
+    /**
+     * @brief   Number of polling rounds before a blocking reader goes to sleep
+     */
+    static const int                            cSpin = 128;
+
+    /**
+     * @brief   Sleep as long as *pi equals iVal (or until woken up)
+     * @param   pi
+     *              Word to wait on
+     * @param   iVal
+     *              Value observed by the caller
+     *
+     * The call may return spuriously, so callers have to check their condition again.
+     */
+    inline void futexWait( std::atomic<int>* pi, int iVal )
+    {
+#ifdef __linux__
+        syscall( SYS_futex, reinterpret_cast<int*>( pi ), FUTEX_WAIT_PRIVATE, iVal, nullptr, nullptr, 0 );
+#else
+        if( pi->load( std::memory_order_acquire ) == iVal )
+            std::this_thread::yield();
+#endif
+    }
+
+    /**
+     * @brief   Sleep as long as *pi equals iVal, but not beyond tDeadline
+     * @param   pi
+     *              Word to wait on
+     * @param   iVal
+     *              Value observed by the caller
+     * @param   tDeadline
+     *              Point in time to return at the latest
+     * @return  False if the deadline has passed
+     *
+     * The call may return spuriously, so callers have to check their condition again.
+     */
+    inline bool futexWaitUntil( std::atomic<int>* pi, int iVal,
+            const std::chrono::steady_clock::time_point& tDeadline )
+    {
+        std::chrono::steady_clock::duration dt = tDeadline - std::chrono::steady_clock::now();
+        if( dt <= std::chrono::steady_clock::duration::zero() )
+            return false;
+#ifdef __linux__
+        std::chrono::seconds dtSec = std::chrono::duration_cast<std::chrono::seconds>( dt );
+        struct timespec ts;
+        ts.tv_sec = dtSec.count();
+        ts.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>( dt - dtSec ).count();
+        // FUTEX_WAIT measures the relative timeout against CLOCK_MONOTONIC like steady_clock
+        syscall( SYS_futex, reinterpret_cast<int*>( pi ), FUTEX_WAIT_PRIVATE, iVal, &ts, nullptr, 0 );
+#else
+        if( pi->load( std::memory_order_acquire ) == iVal )
+            std::this_thread::yield();
+#endif
+        return true;
+    }
+
+    /**
+     * @brief   Wake up all threads sleeping on pi
+     * @param   pi
+     *              Word to wake waiters on
+     */
+    inline void futexWake( std::atomic<int>* pi )
+    {
+#ifdef __linux__
+        syscall( SYS_futex, reinterpret_cast<int*>( pi ), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0 );
+#else
+        (void)pi;
+#endif
+    }
+
+    /**
+     * @brief   Storage for a trivially copyable type which can be written and read concurrently
+     *          without a data race
+     *
+     * The object is copied word by word using relaxed atomics. Consistency of the whole object
+     * has to be ensured by the caller (e.g. using a sequence counter).
+     */
+    template<class T>
+    class AtomicStorage
+    {
+        static_assert( std::is_trivially_copyable<T>::value,
+                "lock-free exchange requires a trivially copyable message type" );
+        static_assert( alignof( T ) <= alignof( unsigned long ),
+                "lock-free exchange does not support over-aligned message types" );
+
+        static const unsigned int               cWords = ( sizeof( T ) + sizeof( unsigned long ) - 1 )
+                                                            / sizeof( unsigned long );
+
+        public:
+            AtomicStorage()
+            {
+                for( unsigned int i = 0; i < cWords; ++i )
+                    _rgl[ i ].store( 0, std::memory_order_relaxed );
+            }
+
+            /**
+             * @brief   Copy data into the storage
+             */
+            void store( const T& data )
+            {
+                unsigned long rgl[ cWords ] = {};
+                std::memcpy( rgl, &data, sizeof( T ) );
+                for( unsigned int i = 0; i < cWords; ++i )
+                    _rgl[ i ].store( rgl[ i ], std::memory_order_relaxed );
+            }
+
+            /**
+             * @brief   Copy data out of the storage
+             */
+            T load() const
+            {
+                unsigned long rgl[ cWords ];
+                for( unsigned int i = 0; i < cWords; ++i )
+                    rgl[ i ] = _rgl[ i ].load( std::memory_order_relaxed );
+                T data;
+                std::memcpy( &data, rgl, sizeof( T ) );
+                return data;
+            }
+
+        private:
+            std::atomic<unsigned long>          _rgl[ cWords ];
+    };
+}
+
+/**
+ * @brief   Exchange policy using a mutex and a condition_variable
  *
- * This is accomplished using a condition_variable. When trying to read the message, the call
- * is blocked until there is a message ready to read. Multiple senders/receivers are allowed,
- * but each message is considered new only once. Only one message can be cached at a time (no FIFO).
+ * When trying to read the message, the call is blocked until there is a message ready to read.
+ * Multiple senders/receivers are allowed, but each message is considered new only once.
+ * Only one message can be cached at a time (no FIFO).
  */
 template<class T>
-class Exchange
+class MutexExchangePolicy
 {
     public:
 
-        /**
-         * @brief   Default Constructor
-         */
-        Exchange() : _fReady( false )
+        MutexExchangePolicy() : _fReady( false )
         {
         }
 
-        /**
-         * @brief   Constructor with explicit data
-         * @param   data
-         *              Message
-         * @param   fReady
-         *              True to mark message as ready to read
-         */
-        Exchange( const T& data, bool fReady = true ) : _data( data ), _fReady( fReady )
+        MutexExchangePolicy( const T& data, bool fReady ) : _data( data ), _fReady( fReady )
         {
         }
-        
-        Exchange( const Exchange& ) = delete;
-        Exchange& operator=( const Exchange& ) = delete;
 
         /**
          * @brief   Set the message which will be delivered to a waiting reader or on the next
@@ -75,7 +203,7 @@ class Exchange
         /**
          * @brief   Read the current message
          * @param   fNew
-         *              If true only message marked as new is returned. Thus, the call might be 
+         *              If true only message marked as new is returned. Thus, the call might be
          *              blocking if no new message is available yet.
          * @return  Current message
          */
@@ -88,6 +216,24 @@ class Exchange
             return _data;
         }
 
+        /**
+         * @brief   Read a new message, waiting at most until a deadline
+         * @param   data
+         *              Written if a new message was available in time
+         * @param   tDeadline
+         *              Point in time to return at the latest
+         * @return  True if a new message was read, false on timeout
+         */
+        bool readUntil( T& data, const std::chrono::steady_clock::time_point& tDeadline )
+        {
+            std::unique_lock<std::mutex> lock( _mutex );
+            if( !_monitor.wait_until( lock, tDeadline, [this] { return _fReady; } ) )
+                return false;
+            _fReady = false; // mark message as read
+            data = _data;
+            return true;
+        }
+
 
     private:
         T                               _data;
@@ -96,6 +242,428 @@ class Exchange
         std::condition_variable         _monitor;
 };
 
+/**
+ * @brief   Lock-free exchange policy for exactly one writer and one reader (seqlock)
+ *
+ * The writer never blocks: it bumps a sequence counter to an odd value, copies the message and
+ * bumps the counter to the next even value. The reader copies the message and retries if the
+ * counter changed meanwhile. A blocking reader spins for a short while and then sleeps on the
+ * sequence counter (futex), so the writer only enters the kernel if somebody is actually sleeping.
+ *
+ * T has to be trivially copyable. Only one message can be cached at a time (no FIFO).
+ */
+template<class T>
+class SeqLockExchangePolicy
+{
+    public:
+
+        SeqLockExchangePolicy() : _iSeq( 0 ), _iSeqRead( 0 ), _cWaiting( 0 )
+        {
+        }
 
-#endif //ifndef _EXCHANGE_H_
+        SeqLockExchangePolicy( const T& data, bool fReady ) :
+            _iSeq( fReady ? 2 : 0 ), _iSeqRead( 0 ), _cWaiting( 0 )
+        {
+            _data.store( data );
+        }
+
+        /**
+         * @brief   Set the message which will be delivered to a waiting reader or on the next
+         *          call to {@link read()}
+         * @param   data
+         *              Message
+         * @return  True if the last message had not been delivered yet
+         */
+        bool write( const T& data )
+        {
+            int iSeq = _iSeq.load( std::memory_order_relaxed );
+            _iSeq.store( iSeq + 1, std::memory_order_relaxed );
+            std::atomic_thread_fence( std::memory_order_release );
+            _data.store( data );
+            _iSeq.store( iSeq + 2 ); // seq_cst: must not be reordered with the check of _cWaiting
+
+            if( _cWaiting.load() )
+                ExchangeDetail::futexWake( &_iSeq );
+
+            return _iSeqRead.load( std::memory_order_relaxed ) != iSeq;
+        }
+
+        /**
+         * @brief   Read the current message
+         * @param   fNew
+         *              If true only message marked as new is returned. Thus, the call might be
+         *              blocking if no new message is available yet.
+         * @return  Current message
+         */
+        T read( bool fNew = true )
+        {
+            if( fNew )
+                waitNew();
+
+            while( 1 )
+            {
+                int iSeq = _iSeq.load( std::memory_order_acquire );
+                if( iSeq & 1 )
+                    continue; // write in progress, will be finished soon
+                T data = _data.load();
+                std::atomic_thread_fence( std::memory_order_acquire );
+                if( _iSeq.load( std::memory_order_relaxed ) == iSeq )
+                {
+                    _iSeqRead.store( iSeq, std::memory_order_relaxed ); // mark message as read
+                    return data;
+                }
+            }
+        }
+
+        /**
+         * @brief   Read a new message, waiting at most until a deadline
+         * @param   data
+         *              Written if a new message was available in time
+         * @param   tDeadline
+         *              Point in time to return at the latest
+         * @return  True if a new message was read, false on timeout
+         */
+        bool readUntil( T& data, const std::chrono::steady_clock::time_point& tDeadline )
+        {
+            if( !waitNew( &tDeadline ) )
+                return false;
+            data = read( false );
+            return true;
+        }
+
+    private:
+        /**
+         * @brief   Block until the sequence counter moved past the last message read
+         * @param   ptDeadline
+         *              Deadline or nullptr to wait infinitely
+         * @return  False on timeout
+         */
+        bool waitNew( const std::chrono::steady_clock::time_point* ptDeadline = nullptr )
+        {
+            int iSeqRead = _iSeqRead.load( std::memory_order_relaxed );
+            for( int i = 0; i < ExchangeDetail::cSpin; ++i )
+                if( _iSeq.load( std::memory_order_acquire ) != iSeqRead )
+                    return true;
+
+            bool fNew = true;
+            _cWaiting.fetch_add( 1 );
+            int iSeq;
+            while( ( iSeq = _iSeq.load() ) == iSeqRead )
+            {
+                if( !ptDeadline )
+                    ExchangeDetail::futexWait( &_iSeq, iSeq );
+                else if( !ExchangeDetail::futexWaitUntil( &_iSeq, iSeq, *ptDeadline ) )
+                {
+                    fNew = false;
+                    break;
+                }
+            }
+            _cWaiting.fetch_sub( 1 );
+            return fNew;
+        }
+
+    private:
+        std::atomic<int>                        _iSeq; // even: stable, odd: write in progress
+        std::atomic<int>                        _iSeqRead; // sequence number of the last message read
+        std::atomic<int>                        _cWaiting; // number of sleeping readers
+        ExchangeDetail::AtomicStorage<T>        _data;
+};
+
+/**
+ * @brief   Per-type settings for QueueExchangePolicy
+ *
+ * Specialize this template to allow merging of queued messages.
+ */
+template<class T>
+struct ExchangeTraits
+{
+    /**
+     * @brief   Maximum number of queued messages
+     */
+    static const unsigned int                   cQueue = 64;
+
+    /**
+     * @brief   Decide if a new message may replace the newest queued one
+     * @param   older
+     *              Newest message in the queue (not yet read)
+     * @param   newer
+     *              Message to be written
+     * @return  True if older carries no information which is not also contained in newer
+     */
+    static bool coalesce( const T& older, const T& newer )
+    {
+        return false;
+    }
+};
+
+/**
+ * @brief   Lock-free exchange policy for exactly one writer and one reader with a bounded FIFO
+ *
+ * Messages are delivered in order. If ExchangeTraits<T>::coalesce() allows it, a new message
+ * replaces the newest queued message instead of taking a new slot. If the queue is full
+ * anyway, the newest queued message is replaced and counted as dropped, so the reader always
+ * ends up with the latest message.
+ *
+ * Each slot carries a state word. The writer may only merge into a slot by switching its state
+ * to "writing", the reader may only take a slot by switching its state to "consumed"; whoever
+ * comes first wins and the other one retries. T has to be trivially copyable and default
+ * constructible.
+ */
+template<class T>
+class QueueExchangePolicy
+{
+        static const unsigned int               cQueue = ExchangeTraits<T>::cQueue;
 
+        // slot state: version << 2 | flags
+        static const int                        fWriting = 1;
+        static const int                        fConsumed = 2;
+
+        struct Slot
+        {
+            Slot() : iState( fConsumed ) {}
+
+            std::atomic<int>                    iState;
+            ExchangeDetail::AtomicStorage<T>    data;
+        };
+
+    public:
+
+        QueueExchangePolicy() :
+            _iHead( 0 ), _iTail( 0 ), _iSeq( 0 ), _cWaiting( 0 ), _cCoalesced( 0 ), _cDropped( 0 )
+        {
+        }
+
+        QueueExchangePolicy( const T& data, bool fReady ) :
+            _iHead( 0 ), _iTail( 0 ), _iSeq( 0 ), _cWaiting( 0 ), _cCoalesced( 0 ), _cDropped( 0 ),
+            _dataLast( data )
+        {
+            if( fReady )
+                write( data );
+        }
+
+        /**
+         * @brief   Queue a message
+         * @param   data
+         *              Message
+         * @return  True if there were messages which had not been delivered yet
+         */
+        bool write( const T& data )
+        {
+            unsigned int iHead = _iHead.load( std::memory_order_relaxed );
+            unsigned int cQueued = iHead - _iTail.load( std::memory_order_acquire );
+
+            bool fMerge = cQueued > 0 && ExchangeTraits<T>::coalesce( _dataHead, data );
+            if( fMerge || cQueued >= cQueue )
+            {
+                if( replace( _rgSlot[ ( iHead - 1 ) % cQueue ], data ) )
+                {
+                    if( fMerge )
+                        _cCoalesced.fetch_add( 1, std::memory_order_relaxed );
+                    else
+                        _cDropped.fetch_add( 1, std::memory_order_relaxed );
+                    _dataHead = data;
+                    notify();
+                    return true;
+                }
+                // reader took the slot meanwhile, so there is room for a new one
+                cQueued = iHead - _iTail.load( std::memory_order_acquire );
+            }
+
+            Slot& slot = _rgSlot[ iHead % cQueue ];
+            slot.data.store( data );
+            slot.iState.store( ( slot.iState.load( std::memory_order_relaxed ) & ~3 ) + 4,
+                    std::memory_order_release );
+            _iHead.store( iHead + 1 );
+            _dataHead = data;
+            notify();
+            return cQueued > 0;
+        }
+
+        /**
+         * @brief   Read the next message
+         * @param   fNew
+         *              If true the call blocks until a message is queued. Otherwise, the last
+         *              message read is returned again if the queue is empty.
+         * @return  Next message
+         */
+        T read( bool fNew = true )
+        {
+            if( fNew )
+                waitNew();
+            pop( _dataLast );
+            return _dataLast;
+        }
+
+        /**
+         * @brief   Read the next message, waiting at most until a deadline
+         * @param   data
+         *              Written if a message was available in time
+         * @param   tDeadline
+         *              Point in time to return at the latest
+         * @return  True if a message was read, false on timeout
+         */
+        bool readUntil( T& data, const std::chrono::steady_clock::time_point& tDeadline )
+        {
+            if( !waitNew( &tDeadline ) )
+                return false;
+            pop( _dataLast );
+            data = _dataLast;
+            return true;
+        }
+
+        /**
+         * @brief   Number of messages merged into a queued one
+         */
+        unsigned long getCoalesced() const
+        {
+            return _cCoalesced.load( std::memory_order_relaxed );
+        }
+
+        /**
+         * @brief   Number of messages lost because the queue was full
+         */
+        unsigned long getDropped() const
+        {
+            return _cDropped.load( std::memory_order_relaxed );
+        }
+
+    private:
+        /**
+         * @brief   Overwrite a queued slot unless the reader took it already
+         * @return  True if successful
+         */
+        bool replace( Slot& slot, const T& data )
+        {
+            int iState = slot.iState.load( std::memory_order_acquire );
+            if( ( iState & fConsumed ) ||
+                    !slot.iState.compare_exchange_strong( iState, iState | fWriting ) )
+                return false;
+            std::atomic_thread_fence( std::memory_order_release );
+            slot.data.store( data );
+            slot.iState.store( iState + 4, std::memory_order_release );
+            return true;
+        }
+
+        /**
+         * @brief   Take the oldest queued message
+         * @param   data
+         *              Written if a message was available
+         * @return  True if a message was available
+         */
+        bool pop( T& data )
+        {
+            unsigned int iTail = _iTail.load( std::memory_order_relaxed );
+            if( iTail == _iHead.load( std::memory_order_acquire ) )
+                return false;
+
+            Slot& slot = _rgSlot[ iTail % cQueue ];
+            while( 1 )
+            {
+                int iState = slot.iState.load( std::memory_order_acquire );
+                if( iState & fWriting )
+                    continue; // merge in progress, will be finished soon
+                T dataSlot = slot.data.load();
+                std::atomic_thread_fence( std::memory_order_acquire );
+                if( slot.iState.compare_exchange_strong( iState, iState | fConsumed ) )
+                {
+                    data = dataSlot;
+                    break;
+                }
+            }
+            _iTail.store( iTail + 1, std::memory_order_release );
+            return true;
+        }
+
+        /**
+         * @brief   Block until the queue is not empty
+         * @param   ptDeadline
+         *              Deadline or nullptr to wait infinitely
+         * @return  False on timeout
+         */
+        bool waitNew( const std::chrono::steady_clock::time_point* ptDeadline = nullptr )
+        {
+            unsigned int iTail = _iTail.load( std::memory_order_relaxed );
+            for( int i = 0; i < ExchangeDetail::cSpin; ++i )
+                if( _iHead.load( std::memory_order_acquire ) != iTail )
+                    return true;
+
+            bool fNew = true;
+            _cWaiting.fetch_add( 1 );
+            while( 1 )
+            {
+                int iSeq = _iSeq.load();
+                if( _iHead.load() != iTail )
+                    break;
+                if( !ptDeadline )
+                    ExchangeDetail::futexWait( &_iSeq, iSeq );
+                else if( !ExchangeDetail::futexWaitUntil( &_iSeq, iSeq, *ptDeadline ) )
+                {
+                    fNew = false;
+                    break;
+                }
+            }
+            _cWaiting.fetch_sub( 1 );
+            return fNew;
+        }
+
+        /**
+         * @brief   Wake up a sleeping reader
+         */
+        void notify()
+        {
+            _iSeq.fetch_add( 1 );
+            if( _cWaiting.load() )
+                ExchangeDetail::futexWake( &_iSeq );
+        }
+
+    private:
+        Slot                                    _rgSlot[ cQueue ];
+        std::atomic<unsigned int>               _iHead; // next slot to write
+        std::atomic<unsigned int>               _iTail; // next slot to read
+        std::atomic<int>                        _iSeq; // bumped on every write, reader sleeps on it
+        std::atomic<int>                        _cWaiting; // number of sleeping readers
+        std::atomic<unsigned long>              _cCoalesced;
+        std::atomic<unsigned long>              _cDropped;
+
+        T                                       _dataHead; // newest message written (writer only)
+        T                                       _dataLast; // last message read (reader only)
+};
+
+/**
+ * @brief   Class provinding a simple mechanism to exchange messages between threads.
+ *
+ * When trying to read the message, the call is blocked until there is a message ready to read.
+ * Each message is considered new only once. The synchronization strategy is selected by Policy:
+ * - MutexExchangePolicy (default): multiple senders/receivers, any copyable T
+ * - SeqLockExchangePolicy: one sender and one receiver, lock-free, trivially copyable T
+ * - QueueExchangePolicy: like SeqLockExchangePolicy, but with a bounded FIFO
+ */
+template<class T, template<class> class Policy = MutexExchangePolicy>
+class Exchange : public Policy<T>
+{
+    public:
+
+        /**
+         * @brief   Default Constructor
+         */
+        Exchange()
+        {
+        }
+
+        /**
+         * @brief   Constructor with explicit data
+         * @param   data
+         *              Message
+         * @param   fReady
+         *              True to mark message as ready to read
+         */
+        Exchange( const T& data, bool fReady = true ) : Policy<T>( data, fReady )
+        {
+        }
+
+        Exchange( const Exchange& ) = delete;
+        Exchange& operator=( const Exchange& ) = delete;
+};
+
+
+#endif //ifndef _EXCHANGE_H_
@@ -0,0 +1,101 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOOKAHEAD_H_
+#define _LOOKAHEAD_H_
+
+#include <algorithm>
+
+#include "typedefs.h"
+
+/**
+ * @brief   Adapt how far ahead time code is committed to the MIDI output
+ *
+ * A long lookahead survives late wakeups of the MIDI thread, a short one keeps the amount of
+ * stale quarter frames small which are still queued when playback jumps. The lookahead
+ * follows a peak detector of the observed lateness with fast attack and slow release,
+ * multiplied by a headroom factor, and is clipped to [min, max].
+ */
+class Lookahead
+{
+    public:
+        /**
+         * @brief   Headroom factor applied to the lateness peak
+         */
+        static const int                        cHeadroom = 2;
+
+        /**
+         * @brief   Lookahead kept on top of the scaled lateness peak
+         */
+        static const LTimePoint                 cMargin = 5 * LTimeMs;
+
+        /**
+         * @brief   The peak decays by 1/cDecay per observation (about 5 s at 25 FPS)
+         */
+        static const int                        cDecay = 64;
+
+        /**
+         * @brief   Constructor. Starts with the maximum lookahead
+         * @param   lMin
+         *              Lower bound
+         * @param   lMax
+         *              Upper bound
+         */
+        Lookahead( LTimePoint lMin, LTimePoint lMax ) :
+            _lMin( lMin ), _lMax( std::max( lMin, lMax ) ), _lPeak( _lMax ), _lLookahead( _lMax )
+        {
+        }
+
+        /**
+         * @brief   Feed an observation made when enqueuing time code
+         * @param   lLateness
+         *              Time passed since the planned wakeup
+         * @param   lQueued
+         *              Time until the queued messages run out (negative if the queue ran dry)
+         */
+        void observe( LTimePoint lLateness, LTimePoint lQueued )
+        {
+            // whatever of the lookahead has been used up must be covered
+            LTimePoint lNeed = std::max( lLateness, _lLookahead - lQueued );
+            _lPeak = std::max( lNeed, _lPeak - _lPeak / cDecay );
+            _lLookahead = std::min( _lMax, std::max( _lMin, cHeadroom * _lPeak + cMargin ) );
+        }
+
+        /**
+         * @brief   Get the current lookahead
+         */
+        LTimePoint get() const
+        {
+            return _lLookahead;
+        }
+
+        /**
+         * @brief   Get the current lateness peak
+         */
+        LTimePoint getPeak() const
+        {
+            return _lPeak;
+        }
+
+    private:
+        LTimePoint                              _lMin;
+        LTimePoint                              _lMax;
+        LTimePoint                              _lPeak; // decaying lateness peak
+        LTimePoint                              _lLookahead;
+};
+
+#endif // ifndef _LOOKAHEAD_H_
@@ -0,0 +1,115 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LTCRENDERER_H_
+#define _LTCRENDERER_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "typedefs.h"
+#include "Timecode.h"
+
+/**
+ * @brief   Renders SMPTE linear time code (LTC) as 16 bit PCM samples
+ *
+ * Each frame is an 80 bit word (BCD time, flags, sync word) sent with bi-phase mark code:
+ * the level changes at every bit boundary and additionally in the middle of a 1 bit. The
+ * polarity correction bit makes the number of 1 bits even, so every frame starts with the
+ * same level.
+ *
+ * Rendering works on half bits: each one is a run of 10 to 13 samples at 48 kHz, filled
+ * with a single store of a cLanes wide vector. The store may run past the end of the half
+ * bit and is overwritten by the next one, so output buffers need cLanes samples of slack.
+ * Frames have a whole number of samples; with 29.97 fps the lengths alternate so that the
+ * stream stays exact.
+ */
+class LtcRenderer
+{
+    public:
+        /**
+         * @brief   Sample rate (Hz)
+         */
+        static const int                        cSampleRate = 48000;
+
+        /**
+         * @brief   Bits per frame
+         */
+        static const int                        cBits = 80;
+
+        /**
+         * @brief   Samples filled by one vector store (longer than any half bit)
+         */
+        static const int                        cLanes = 16;
+
+        /**
+         * @brief   Upper bound of the samples of a frame (24 fps: 2000)
+         */
+        static const int                        cMaxFrameSamples = 2048;
+
+        /**
+         * @brief   Sync word (bits 64-79, first bit in the least significant position)
+         */
+        static const uint16_t                   wSync = 0xBFFC;
+
+        /**
+         * @brief   Constructor
+         * @param   bRate
+         *              Frame rate bits (see {@link FrameRate})
+         * @param   sAmplitude
+         *              Peak level of the samples
+         */
+        LtcRenderer( MidiByte bRate, int16_t sAmplitude = 16384 );
+
+        /**
+         * @brief   Get the data bits of a frame
+         * @param   grBSD
+         *              Frame label
+         * @return  Bits 0-63, first bit in the least significant position
+         */
+        uint64_t encode( const BSDTime& grBSD ) const;
+
+        /**
+         * @brief   Render the next frame of the stream
+         * @param   grBSD
+         *              Frame label
+         * @param   rgs
+         *              Receives the samples, space for cMaxFrameSamples + cLanes samples
+         * @return  Number of samples
+         */
+        int render( const BSDTime& grBSD, int16_t* rgs );
+
+        /**
+         * @brief   Get the number of samples of the next frame
+         */
+        int nextFrameSamples() const;
+
+        /**
+         * @brief   Restart the stream (e.g. after a gap)
+         */
+        void reset();
+
+    private:
+        std::unique_ptr<MtcEncoder>             _pgrRate; // frame arithmetic of the rate
+        int                                     _iPolarityBit; // 59 at 25 fps, otherwise 27
+        bool                                    _fDrop;
+        int16_t                                 _sAmplitude;
+        int                                     _cFrames; // frames rendered since reset
+        bool                                    _fHigh; // level of the last half bit
+};
+
+#endif // ifndef _LTCRENDERER_H_
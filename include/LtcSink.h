@@ -0,0 +1,149 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LTCSINK_H_
+#define _LTCSINK_H_
+
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+#include <atomic>
+#include <thread>
+#include <memory>
+
+#include "typedefs.h"
+#include "Timecode.h"
+#include "LtcRenderer.h"
+
+/**
+ * @brief   Writes LTC for the frames sent as MIDI time code into a PCM stream
+ *
+ * The stream is 16 bit mono at {@link LtcRenderer::cSampleRate}, either raw (little
+ * endian) or as WAV file if the path ends with ".wav". "-" writes raw samples to stdout,
+ * e.g. for a pipe into an audio player.
+ *
+ * Sample 0 corresponds to the start of the first frame, every later sample to the local
+ * time elapsed since. Gaps (pause, stop) are filled with silence; a frame that would
+ * overlap the previous one (jump backwards) starts right after it.
+ *
+ * Rendering happens in the calling (MIDI) thread, writing in a thread of its own: samples
+ * are passed through a lock-free ring, so a stalled consumer (e.g. a pipe) cannot delay
+ * the time code. If the ring is full, blocks are dropped and counted; they are replaced by
+ * silence once there is room again, so the following samples keep their time.
+ */
+class LtcSink
+{
+    private:
+        /**
+         * @brief   Samples of silence written at once
+         */
+        static const int cSilence = 4096;
+
+        /**
+         * @brief   Capacity of the ring between renderer and writer thread (samples, ~5 s)
+         */
+        static const unsigned int cRing = 1 << 18;
+
+    public:
+        /**
+         * @brief   Constructor
+         * @param   szPath
+         *              Output file, "-" for stdout
+         * @param   bRate
+         *              Frame rate bits (see {@link FrameRate})
+         * @throws  std::runtime_error
+         */
+        LtcSink( const std::string& szPath, MidiByte bRate );
+
+        /**
+         * @brief   Destructor, writes the remaining samples and completes the WAV header
+         */
+        ~LtcSink();
+
+        /**
+         * @brief   Write a frame
+         * @param   grBSD
+         *              Frame label
+         * @param   lStart
+         *              Local time the frame starts at
+         */
+        void frame( const BSDTime& grBSD, LTimePoint lStart );
+
+        /**
+         * @brief   Fill the stream with silence
+         * @param   lTime
+         *              Local time up to which the stream shall be complete
+         */
+        void silenceUntil( LTimePoint lTime );
+
+        /**
+         * @brief   Get the number of samples written so far
+         */
+        int64_t getSamples() const
+        {
+            return _cSamples;
+        }
+
+        /**
+         * @brief   Get the number of samples dropped because the writer fell behind
+         */
+        int64_t getDropped() const
+        {
+            return _cDropped.load( std::memory_order_relaxed );
+        }
+
+    private:
+        /**
+         * @brief   Sample index of a local time
+         */
+        int64_t sampleAt( LTimePoint lTime ) const;
+
+        /**
+         * @brief   Pass samples in little endian order to the writer thread
+         */
+        void write( int16_t* rgs, int c );
+
+        /**
+         * @brief   Writer thread: write the ring to the file until stopped
+         */
+        void drain();
+
+        /**
+         * @brief   Write the WAV header for the samples written so far
+         */
+        void writeHeader();
+
+    private:
+        FILE*                       _pfOut;
+        bool                        _fWav;
+        LtcRenderer                 _grRenderer;
+        LTimePoint                  _lOrigin; // local time of sample 0
+        int64_t                     _cSamples; // samples rendered
+        int16_t                     _rgs[ LtcRenderer::cMaxFrameSamples + LtcRenderer::cLanes ];
+
+        // ring to the writer thread
+        std::unique_ptr<int16_t[]>  _rgsRing;
+        std::atomic<uint64_t>       _iHead; // next sample to render into the ring
+        std::atomic<uint64_t>       _iTail; // next sample to write to the file
+        std::atomic<int64_t>        _cDropped;
+        int64_t                     _cGap; // dropped samples not yet replaced by silence
+        std::atomic<bool>           _fStop;
+        int64_t                     _cWritten; // samples in the file (writer thread)
+        std::thread                 _thWriter;
+};
+
+#endif // ifndef _LTCSINK_H_
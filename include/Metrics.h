@@ -0,0 +1,129 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+/**
+ * @brief   Process wide counters and gauges
+ *
+ * Values are written lock-free from any thread (including the real-time MIDI thread) and
+ * can be dumped from another thread.
+ */
+class Metrics
+{
+    public:
+        /**
+         * @brief   Available metrics
+         */
+        enum EMetric
+        {
+            EM_LOOKAHEAD,           ///< current scheduling lookahead (ns)
+            EM_LATENESS_PEAK,       ///< decaying peak of the scheduling lateness (ns)
+            EM_UNDERRUNS,           ///< frames enqueued after their deadline
+            EM_FREEWHEELS,          ///< dropouts of XMMS2 statuses bridged by extrapolation
+            EM_FREEWHEEL_HOLDS,     ///< dropouts longer than the freewheel window
+            EM_RELOCATES,           ///< full frames sent to resync after freewheeling
+            EM_DRIFT_PPB,           ///< audio clock vs. host clock drift (ppb)
+            EM_DRIFT_SPAN,          ///< playback time backing the drift estimate (ms)
+            EM_WRITE_ERRORS,        ///< failed PortMidi writes
+            EM_WIRE_LATE,           ///< time code and clock messages delayed by a busy MIDI link
+            EM_WIRE_DEFERRED,       ///< other messages moved into a gap of the time code
+            EM_WIRE_DELAY_PEAK,     ///< largest delay of a message on the MIDI link (us)
+            EM_QUEUE_DEPTH,         ///< messages waiting in the output's own queues
+            EM_STATUS_DROPS,        ///< statuses dropped because the output fell behind
+            EM_PENDING_FULL,        ///< waits for a slot in the full real-time pending ring
+            EM_LTC_DROPS,           ///< LTC samples dropped because the audio consumer fell behind
+            EM_COUNT                ///< number of metrics
+        };
+
+        /**
+         * @brief   Maximum number of output devices with metrics of their own
+         */
+        static const unsigned int   cMaxDevices = 8;
+
+        /**
+         * @brief   Get the process wide instance of an output device
+         * @param   iDevice
+         *              0 for the main device, 1... for further outputs (less than cMaxDevices)
+         */
+        static Metrics& get( unsigned int iDevice = 0 )
+        {
+            static Metrics rggrMetrics[ cMaxDevices ];
+            return rggrMetrics[ iDevice ];
+        }
+
+        /**
+         * @brief   Set a gauge
+         */
+        void set( EMetric iMetric, int64_t l )
+        {
+            _rgl[ iMetric ].store( l, std::memory_order_relaxed );
+        }
+
+        /**
+         * @brief   Increment a counter
+         */
+        void add( EMetric iMetric, int64_t l = 1 )
+        {
+            _rgl[ iMetric ].fetch_add( l, std::memory_order_relaxed );
+        }
+
+        /**
+         * @brief   Raise a peak value
+         */
+        void max( EMetric iMetric, int64_t l )
+        {
+            int64_t lOld = _rgl[ iMetric ].load( std::memory_order_relaxed );
+            while( l > lOld && !_rgl[ iMetric ].compare_exchange_weak( lOld, l, std::memory_order_relaxed ) )
+                ;
+        }
+
+        /**
+         * @brief   Read a metric
+         */
+        int64_t value( EMetric iMetric ) const
+        {
+            return _rgl[ iMetric ].load( std::memory_order_relaxed );
+        }
+
+        /**
+         * @brief   Write all metrics as "name=value" pairs in one line
+         * @param   os
+         *              Stream to write to
+         */
+        void dump( std::ostream& os ) const;
+
+    private:
+        Metrics()
+        {
+            for( int i = 0; i < EM_COUNT; ++i )
+                _rgl[ i ].store( 0, std::memory_order_relaxed );
+        }
+
+        Metrics( const Metrics& ) = delete;
+        Metrics& operator=( const Metrics& ) = delete;
+
+    private:
+        std::atomic<int64_t>        _rgl[ EM_COUNT ];
+};
+
+#endif // ifndef _METRICS_H_
@@ -23,17 +23,26 @@
 #include <stdexcept>
 #include <chrono>
 #include <thread>
+#include <memory>
+#include <atomic>
 
 #include <portmidi.h>
-#ifndef _PORTTIME_H_
-#define _PORTTIME_H_
-#include <porttime.h>
-#endif
 
 #include "typedefs.h"
 #include "Exchange.h"
 #include "Config.h"
 #include "Status.h"
+#include "TimeModel.h"
+#include "ClockEstimator.h"
+#include "Lookahead.h"
+#include "DriftEstimator.h"
+#include "Timecode.h"
+#include "WireScheduler.h"
+#include "BeatClock.h"
+#include "LtcSink.h"
+#include "Mmc.h"
+#include "Metrics.h"
+#include "MidiOut.h"
 
 /**
  * @brief   Responsible for emitting MIDI commands
@@ -46,15 +55,9 @@ class MidiMaster
 {
     private:
         /**
-         * @brief   Struct for BSD time
+         * @brief   Capacity of the real-time pending message ring
          */
-        struct BSDTime
-        {
-            MidiByte hour;                  ///< Hour including frame rate information
-            MidiByte minute;                ///< Minute
-            MidiByte second;                ///< Second
-            MidiByte frame;                 ///< Frame
-        };
+        static const unsigned int cPending = 256;
 
     public:
         /**
@@ -63,22 +66,80 @@ class MidiMaster
          *              Config object
          * @param   ex
          *              Status exchange object to get playback information from
+         * @param   pgrDriftSource
+         *              Master learning the drift, null to learn it here (and use the drift file)
          * @throws  std::runtime_error
          *
          * The constructor will also open the midi device.
+         *
+         * All outputs follow the same XMMS2 clock, so only one master learns its drift and the
+         * others use that estimate instead of diverging ones of their own. The source must
+         * outlive this master.
          */
-        MidiMaster( const Config& config, Exchange<Status>& ex );
+        MidiMaster( const Config& config, StatusExchange& ex, const MidiMaster* pgrDriftSource = nullptr );
 
         /**
          * @brief   Main loop. Start sending midi packets and runs infinitely
+         *
+         * The loop wakes up whenever a new status arrives or the next quarter frames are due,
+         * whichever comes first. Thus, time code is emitted according to the frame clock even
+         * if XMMS2 sends playtime signals slower than the schedule time.
          */
         void run();
 
+        /**
+         * @brief   Get the drift learned by this master, may be called from other threads
+         * @return  Rate as slope of a TimeModel, 0 while there is no valid estimate
+         */
+        int64_t getDriftSlope() const
+        {
+            return _lDriftSlope.load( std::memory_order_relaxed );
+        }
+
+        /**
+         * @brief   Process all queued statuses and send everything which is due without blocking
+         *
+         * Used by event loops which run the MIDI master in the same thread as the XMMS2 client.
+         * Call this whenever new statuses may have arrived or the time returned by
+         * {@link nextWakeup()} has been reached.
+         */
+        void poll();
+
+        /**
+         * @brief   Get the point in time the master needs to be polled at the latest
+         * @param   lTime
+         *              Local time to wake up at (only written if something has to be scheduled)
+         * @return  False if nothing is scheduled (poll on new statuses only)
+         */
+        bool nextWakeup( LTimePoint& lTime );
+
     private:
+        /**
+         * @brief   Process a new status and react on state transitions
+         * @param   grStatus
+         *              Status read from the exchange
+         */
+        void processStatus( const Status& grStatus );
+
+        /**
+         * @brief   Enqueue quarter frames and emit pending messages as far as due
+         */
+        void service();
+
+        /**
+         * @brief   Get the point in time the next quarter frames have to be enqueued at
+         * @param   lTime
+         *              Local time to wake up at (only written if something has to be scheduled)
+         * @return  False if nothing has to be scheduled
+         */
+        bool nextEnqueueTime( LTimePoint& lTime );
+
         /**
          * @brief   Update time extrapolation values
          *
-         * Time points are directly extracted from _grStatus*
+         * The time point of _grStatusNew is fed into the clock estimator, whose estimate
+         * replaces slope and y-intercept. While the estimate is uncertain, its slope is blended
+         * with the long-term drift estimate.
          */
         void updateTimeInt();
 
@@ -86,10 +147,17 @@ class MidiMaster
          * @brief   Adapt time extrapolation values to a changed local clock (e.g. after a pause)
          * 
          * Neccessary data is red from _grStatusNew. Speed of time advancing is not changed
-         * but the y-intercept only
+         * but the y-intercept only (unless a long-term drift estimate is available). The clock
+         * estimator and a new drift segment are started from this status.
          */
         void updateTimeYIntercept();
 
+        /**
+         * @brief   Get the long-term rate of the shared drift estimate
+         * @return  Slope of a TimeModel, 0 while there is no valid estimate
+         */
+        int64_t driftSlope() const;
+
         /**
          * @brief   Do time extrapolation
          * @param   xtime
@@ -98,6 +166,23 @@ class MidiMaster
          */
         LTimePoint timeInt( XTimePoint xtime );
 
+        /**
+         * @brief   Get the time stamp to send a message related to an xmms2 time with
+         * @param   xtime
+         *              xmms2 time
+         * @return  Local time at which the message has to leave, such that it takes effect
+         *          when xtime is heard (i.e. earlier by the latency of the MIDI output)
+         */
+        LTimePoint outputTime( XTimePoint xtime );
+
+        /**
+         * @brief   Get the time stamp to send a message related to an xmms2 time with
+         * @param   xtimeUs
+         *              xmms2 time in us
+         * @return  Local time at which the message has to leave (see {@link outputTime()})
+         */
+        LTimePoint outputTimeUs( int64_t xtimeUs );
+
         /**
          * @brief   Convert xmms2 time points to midi frame numbers
          * @param   xtime
@@ -119,15 +204,53 @@ class MidiMaster
          * @brief   Send midi song stop signal
          * @param   iXSongId
          *              xmms2 song id
+         * @param   when
+         *              Local time to send the signal at
          */
-        void sendStopId( XSongId iXSongId );
+        void sendStopId( XSongId iXSongId, LTimePoint when );
 
         /**
          * @brief   Send midi song start signal
          * @param   iXSongId
          *              xmms2 song id
+         * @param   when
+         *              Local time to send the signal at
+         */
+        void sendStartId( XSongId iXSongId, LTimePoint when );
+
+        /**
+         * @brief   Make a song the announced one
+         * @param   iXSongId
+         *              xmms2 song id or XSongIdInvalid if no song is playing
+         * @param   when
+         *              Local time to send the signals at
+         *
+         * Sends the stop signal of the previously announced song and the start signal of the
+         * new one, unless the song is already announced (e.g. by a prediction). Thus, a wrong
+         * prediction is corrected as soon as the actual song is known.
+         */
+        void announce( XSongId iXSongId, LTimePoint when );
+
+        /**
+         * @brief   Get the predicted local time of the next song change
+         * @param   lTime
+         *              Local time of the song change (only written if a prediction is pending)
+         * @return  False if there is nothing to predict
+         */
+        bool predictionTime( LTimePoint& lTime );
+
+        /**
+         * @brief   Send the song signals of a predicted song change ahead of the broadcast
+         * @param   lHorizon
+         *              Local time up to which messages are committed now
+         * @return  True if the song change was predicted now
+         *
+         * Uses the duration of the current song and the id of the next one in the playlist.
+         * The time code and the time model move on to the next song at the predicted time and
+         * the beat clock stops. The broadcast of the actual song change confirms or corrects
+         * the prediction.
          */
-        void sendStartId( XSongId iXSongId );
+        bool predictSongChange( LTimePoint lHorizon );
 
         /**
          * @brief   Enqueue quarter frames
@@ -139,63 +262,218 @@ class MidiMaster
          */
         void enqueueFrames();
 
+        /**
+         * @brief   Adapt the lookahead to how late time code is enqueued
+         * @param   lNow
+         *              Current local time
+         * @param   lQueued
+         *              Time until the messages enqueued so far run out
+         */
+        void observeLateness( LTimePoint lNow, LTimePoint lQueued );
+
+        /**
+         * @brief   Get the time without statuses after which XMMS2 is considered stalled
+         */
+        LTimePoint stallTime() const;
+
+        /**
+         * @brief   Check if time code may still be extrapolated without new statuses
+         * @param   lDeadline
+         *              Local time of the quarter frames to enqueue
+         * @return  False if the freewheel window is exceeded and time code has to be held
+         *
+         * Counts freewheel events and holds.
+         */
+        bool freewheel( LTimePoint lDeadline );
+
+        /**
+         * @brief   Resync with the first status after freewheeling
+         * @return  True if a full frame was sent (i.e. the status must not be checked for jumps)
+         *
+         * Small errors are corrected by moving the time model. If time code was held or the
+         * error is at least a frame, a full frame relocates the slaves.
+         */
+        bool endFreewheel();
+
+        /**
+         * @brief   Send a MIDI Machine Control command (if configured)
+         * @param   iCommand
+         *              Command without parameters
+         * @param   when
+         *              Local time to send the command at
+         */
+        void sendMmc( Mmc::ECommand iCommand, LTimePoint when );
+
+        /**
+         * @brief   Send a MIDI Machine Control locate and deferred play (if configured)
+         * @param   iFrame
+         *              Frame to locate to
+         * @param   when
+         *              Local time to send the commands at
+         * @param   fPlay
+         *              Send deferred play after the locate
+         *
+         * The locate is only sent if a frame rate is configured. Slaves can pre-roll to the
+         * position before the first quarter frame arrives.
+         */
+        void sendMmcLocate( int iFrame, LTimePoint when, bool fPlay = true );
+
+        /**
+         * @brief   Get the tempo of the current song
+         * @return  Beats per minute from the configuration or the medialib, 0 if unknown
+         */
+        double tempo() const;
+
+        /**
+         * @brief   Get the local time of a beat clock tick
+         * @param   cTick
+         *              Tick number counted from the start of the song
+         */
+        LTimePoint clockTime( int64_t cTick );
+
+        /**
+         * @brief   Move the beat clock to a position and start it if playing
+         * @param   xtime
+         *              xmms2 time to continue at
+         *
+         * Sends stop, the song position pointer of the next sixteenth note and start (at the
+         * beginning of the song) or continue. Without a tempo the clock stays stopped.
+         */
+        void locateClock( XTimePoint xtime );
+
+        /**
+         * @brief   Send a stop message if the beat clock is running
+         */
+        void stopClock();
+
+        /**
+         * @brief   Enqueue beat clock ticks
+         * @param   lUntil
+         *              Enqueue all ticks before this local time
+         *
+         * Ticks are interleaved with quarter frames by {@link enqueueFrames()}, so both share
+         * the wakeups and output batches.
+         */
+        void enqueueClock( LTimePoint lUntil );
+
         /**
          * @brief   Do song start sequence.
          *
-         *  The start sequence consists of sending a song start id, refreshing the frame counter
+         *  The start sequence consists of announcing the song, refreshing the frame counter
          *  and sending an absolute time position.
+         *  A predicted song change which starts within a frame of the prediction has already
+         *  been located, its time code runs on.
          *  All data is read from _grStatusNew.
          */
         void songStart();
 
         /**
-         * @brief   Convert a frame number into a BSD time
-         * @param   iFrame
-         *              Absolute frame number to convert
-         * @return  Time position as BSDTime. Hour contains frame rate information
+         * @brief   Write a short MIDI message
+         * @param   when
+         *              Local time to send the message at
+         * @param   msg
+         *              Message to send
+         *
+         * The message passes the wire scheduler, which may move it back on slow links, and
+         * is then handed to {@link emit()}.
+         */
+        void writeShort( LTimePoint when, MidiMsg msg );
+
+        /**
+         * @brief   Write a SysEx message
+         * @param   when
+         *              Local time to send the message at
+         * @param   rgbMsg
+         *              Message terminated by 0xF7 (16 bytes at most)
+         * @see     writeShort()
+         */
+        void writeSysEx( LTimePoint when, const MidiByte* rgbMsg );
+
+        /**
+         * @brief   Emit all messages the wire scheduler has released
+         */
+        void drainWire();
+
+        /**
+         * @brief   Emit a message at its wire time
+         * @param   grMsg
+         *              Message
+         *
+         * In real-time mode the message is kept in the pending ring and emitted by the
+         * main loop right at its deadline. If the ring is full, this blocks until its oldest
+         * message is due. Otherwise, it is passed on to the output backend, which schedules it.
+         */
+        void emit( const WireMsg& grMsg );
+
+        /**
+         * @brief   Send all pending messages whose deadline has been reached (real-time mode)
          */
-        BSDTime getBSDTime( int iFrame ) const;
+        void emitPending();
+
+        /**
+         * @brief   Count and report failed writes to the output backend
+         * @param   fOk
+         *              Result of a {@link MidiOut} call
+         */
+        void checkWrite( bool fOk );
 
     private:
         const Config&               _config;
+        Metrics&                    _grMetrics; // metrics of this output device
 
         // save status to compare with on status updates
         Status                      _grStatusOld;
         Status                      _grStatusNew;
         int                         _cStatusValid; // number of valid statuses; after a stop/song change
                                                    // interpolation would change otherwise
-        Exchange<Status>&           _grStatusExchange;
+        StatusExchange&             _grStatusExchange;
     
         // midi device
-        PortMidiStream*             _hMidiOut;
+        std::unique_ptr<MidiOut>    _pgrOut;
+
+        // real-time mode: messages are emitted by ourselves instead of the output's scheduler
+        bool                        _fRealTime;
+        WireMsg                     _rgPending[ cPending ];
+        unsigned int                _iPendingHead; // next slot to write
+        unsigned int                _iPendingTail; // next slot to emit
+
+        // byte budget of the MIDI link
+        WireScheduler               _grWire;
 
         // connection parameters
-        PtTimestamp                 _iNextTimeSlot; // ensure non-decreasing time stamps
+        LTimePoint                  _iNextTimeSlot; // ensure non-decreasing time stamps
 
-        LTimePoint                  _cScheduleTime; // time to wake up before the next time code enqueuing is
-                                                    // necessary. Should be about 10 ms
+        Lookahead                   _grLookahead; // time to wake up before the next time code enqueuing is
+                                                  // necessary
+        LTimePoint                  _lPlannedEnqueue; // wakeup time returned by nextEnqueueTime()
+        bool                        _fObserveLateness; // next enqueuing happens at a planned wakeup
 
-        int                         _FPS; // midi time code fps
-        /**
-         * @brief   FPS representation in bits for time code messages
-         *
-         * Format: 0rr00000
-         * 
-         * rr
-         * 00 = 24 frames/s
-         * 01 = 25 frames/s
-         * 10 = 29.97 frames/s
-         * 11 = 30 frames/s
-         */
-        MidiByte                    _bFPS;
-        XTimePoint                  _QXTimeT; // duration of a quarter frame in xmms2 time
+        // freewheeling through XMMS2 dropouts
+        LTimePoint                  _lFreewheel; // how long to extrapolate after XMMS2 stalled
+        LTimePoint                  _lLastStatus; // local time the last status was processed at
+        LTimePoint                  _lStatusInterval; // mean time between statuses
+        bool                        _fFreewheel; // extrapolating without recent statuses
+        bool                        _fHold; // freewheel window exceeded, no time code sent
+
+        XSongId                     _ilAnnouncedId; // song whose start signal was sent last
+
+        LTimePoint                  _lMidiLatency; // latency of the MIDI interface and devices
+
+        std::unique_ptr<MtcEncoder> _pgrMtc; // frame arithmetic of the configured rate, null if no
+                                             // time code is sent
+        std::unique_ptr<LtcSink>    _pgrLtc; // LTC audio of the sent frames, null if not rendered
         int                         _cFrame; // index of next midi time code frame
         XTimePoint                  _lTimepoint; // next encoded time point
 
-        // linear time extrapolation parameters (=dL/dX*x+n)
-        LTimePoint                  _lTimeInt_dL; // local time delta (nominator of slope)
-        XTimePoint                  _lTimeInt_dX; // xmms2 time delta (denominator of slope)
-        LTimePoint                  _lTimeInt_n; // constant offset (y-intercept)
+        BeatClock                   _grBeatClock; // tempo and tick counter of the current song
+        bool                        _fClock; // clock started on the output
+
+        // linear time extrapolation (=dL/dX*x+n)
+        TimeModel                   _grTimeModel;
+        std::unique_ptr<ClockEstimator> _pgrEstimator; // fed with status times of one playback segment
+        DriftEstimator              _grDrift; // rate learned across segments
+        const MidiMaster*           _pgrDriftSource; // master learning the drift, null if it is this one
+        std::atomic<int64_t>        _lDriftSlope; // published rate of _grDrift, 0 if not valid
         
 };
 
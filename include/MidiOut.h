@@ -0,0 +1,275 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MIDIOUT_H_
+#define _MIDIOUT_H_
+
+#include <string>
+#include <memory>
+#include <stdexcept>
+
+#include <portmidi.h>
+
+#include "typedefs.h"
+
+#ifdef HAVE_ALSA
+// declared by <alsa/asoundlib.h>, which is only needed by the implementation
+typedef struct _snd_seq snd_seq_t;
+typedef struct snd_midi_event snd_midi_event_t;
+typedef struct snd_seq_event snd_seq_event_t;
+#endif
+
+/**
+ * @brief   MIDI output backend the {@link MidiMaster} writes its messages to
+ *
+ * Messages carry the local time they shall be sent at. A backend opened for immediate
+ * output (real-time mode, where the master sleeps until each deadline itself) ignores the
+ * time and sends right away. Writes may be buffered until {@link flush()}.
+ */
+class MidiOut
+{
+    public:
+        /**
+         * @brief   Available backends
+         */
+        enum EMidiOut
+        {
+            EMO_PORTMIDI,       ///< PortMidi, scheduled by PortMidi's userspace thread
+            EMO_ALSA,           ///< ALSA sequencer, scheduled on a kernel timer queue
+        };
+
+        /**
+         * @brief   Create a backend
+         * @param   iType
+         *              Element of EMidiOut
+         * @param   iDevice
+         *              PortMidi device id (EMO_PORTMIDI)
+         * @param   szPort
+         *              Sequencer port to connect to, e.g. "20:0" or "VirMIDI 1-0", or an empty
+         *              string to only serve subscribers (EMO_ALSA)
+         * @param   fImmediate
+         *              True to ignore time stamps and send right away
+         * @return  New backend
+         * @throws  std::runtime_error
+         */
+        static std::unique_ptr<MidiOut> create( EMidiOut iType, PmDeviceID iDevice,
+                const std::string& szPort, bool fImmediate );
+
+        virtual ~MidiOut() {}
+
+        /**
+         * @brief   Write a short message
+         * @param   when
+         *              Local time to send the message at
+         * @param   msg
+         *              Message in PortMidi's packing (status in the lowest byte)
+         * @return  False if writing failed (see {@link getError()})
+         */
+        virtual bool writeShort( LTimePoint when, MidiMsg msg ) = 0;
+
+        /**
+         * @brief   Write a SysEx message
+         * @param   when
+         *              Local time to send the message at
+         * @param   rgbMsg
+         *              Message terminated by 0xF7
+         * @return  False if writing failed (see {@link getError()})
+         */
+        virtual bool writeSysEx( LTimePoint when, const MidiByte* rgbMsg ) = 0;
+
+        /**
+         * @brief   Pass buffered messages on to the driver
+         * @return  False if writing failed (see {@link getError()})
+         */
+        virtual bool flush() = 0;
+
+        /**
+         * @brief   Describe the last failure
+         * @return  Error message
+         */
+        virtual const char* getError() const = 0;
+};
+
+/**
+ * @brief   Backend collecting short messages into batches
+ *
+ * A batch is submitted when it is full, on {@link flush()} and before a SysEx message, so
+ * the order of all messages is kept.
+ */
+class BatchedMidiOut : public MidiOut
+{
+    public:
+        /**
+         * @brief   Capacity of the batch of short messages submitted at once
+         */
+        static const int cBatch = 64;
+
+        BatchedMidiOut() : _cEvent( 0 )
+        {
+        }
+
+        virtual bool writeShort( LTimePoint when, MidiMsg msg );
+        virtual bool writeSysEx( LTimePoint when, const MidiByte* rgbMsg );
+        virtual bool flush();
+
+    protected:
+        /**
+         * @brief   Submit a batch of short messages
+         * @param   rgEvent
+         *              Messages with PortMidi time stamps
+         * @param   cEvent
+         *              Number of messages [1..cBatch]
+         * @return  False if writing failed
+         */
+        virtual bool submit( PmEvent* rgEvent, int cEvent ) = 0;
+
+        /**
+         * @brief   Submit a SysEx message, all short messages written before have been submitted
+         * @param   when
+         *              Local time to send the message at
+         * @param   rgbMsg
+         *              Message terminated by 0xF7
+         * @return  False if writing failed
+         */
+        virtual bool submitSysEx( LTimePoint when, const MidiByte* rgbMsg ) = 0;
+
+    private:
+        PmEvent                     _rgEvent[ cBatch ];
+        int                         _cEvent;
+};
+
+/**
+ * @brief   PortMidi backend. Short messages are batched into a single Pm_Write.
+ */
+class PortMidiOut : public BatchedMidiOut
+{
+    public:
+        /**
+         * @brief   Constructor, opens the device
+         * @param   iDevice
+         *              PortMidi output device id
+         * @param   fImmediate
+         *              True to open the device without latency, PortMidi ignores time stamps then
+         * @throws  std::runtime_error
+         */
+        PortMidiOut( PmDeviceID iDevice, bool fImmediate );
+
+        virtual ~PortMidiOut();
+
+        virtual const char* getError() const;
+
+    protected:
+        virtual bool submit( PmEvent* rgEvent, int cEvent );
+        virtual bool submitSysEx( LTimePoint when, const MidiByte* rgbMsg );
+
+    private:
+        PortMidiStream*             _hMidiOut;
+        PmError                     _iErr; // result of the last failed write
+};
+
+#ifdef HAVE_ALSA
+/**
+ * @brief   ALSA sequencer backend
+ *
+ * Events are scheduled with real-time stamps on a queue of our own, so the kernel sends
+ * them on time (on the high resolution timer if available) and no userspace thread has
+ * to wake up for each message. The queue runs on the kernel's monotonic clock while the
+ * local time base is the raw one, so the mapping between both is refreshed regularly.
+ */
+class AlsaSeqOut : public MidiOut
+{
+    private:
+        /**
+         * @brief   Longest SysEx message encoded at once
+         */
+        static const int cMaxSysEx = 256;
+
+        /**
+         * @brief   Interval to refresh the mapping of local time onto queue time
+         */
+        static const LTimePoint cSyncInterval = 1000 * LTimeMs;
+
+    public:
+        /**
+         * @brief   Constructor, creates the client, port and queue
+         * @param   szPort
+         *              Sequencer port to connect to or an empty string
+         * @param   fImmediate
+         *              True to send events directly instead of through the queue
+         * @throws  std::runtime_error
+         */
+        AlsaSeqOut( const std::string& szPort, bool fImmediate );
+
+        virtual ~AlsaSeqOut();
+
+        virtual bool writeShort( LTimePoint when, MidiMsg msg );
+        virtual bool writeSysEx( LTimePoint when, const MidiByte* rgbMsg );
+        virtual bool flush();
+        virtual const char* getError() const;
+
+    private:
+        /**
+         * @brief   Release the sequencer and throw an error
+         * @param   szWhat
+         *              Failed action
+         * @param   iErr
+         *              Negative ALSA error code
+         * @throws  std::runtime_error
+         */
+        void fatal( const std::string& szWhat, int iErr );
+
+        /**
+         * @brief   Map the local time onto the queue time
+         * @return  False if the queue status could not be read, the previous mapping is kept
+         */
+        bool sync();
+
+        /**
+         * @brief   Address and schedule an encoded event and put it into the output buffer
+         * @param   grEvent
+         *              Event
+         * @param   when
+         *              Local time to send the event at
+         * @return  False if writing failed
+         */
+        bool output( snd_seq_event_t& grEvent, LTimePoint when );
+
+        /**
+         * @brief   Remember a failure
+         * @param   iErr
+         *              Negative ALSA error code
+         * @return  False
+         */
+        bool fail( int iErr )
+        {
+            _iErr = iErr;
+            return false;
+        }
+
+    private:
+        snd_seq_t*                  _hSeq;
+        snd_midi_event_t*           _hEncoder; // MIDI bytes to sequencer events
+        int                         _iPort;
+        int                         _iQueue;
+        bool                        _fImmediate;
+        LTimePoint                  _lOrigin; // local time of queue time 0
+        LTimePoint                  _lSynced; // local time the origin was measured at
+        int                         _iErr; // last failure
+};
+#endif // ifdef HAVE_ALSA
+
+#endif // ifndef _MIDIOUT_H_
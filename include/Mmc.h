@@ -0,0 +1,93 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MMC_H_
+#define _MMC_H_
+
+#include "typedefs.h"
+#include "Timecode.h"
+
+/**
+ * @brief   MIDI Machine Control messages (SysEx F0 7F <device> 06 ... F7)
+ */
+class Mmc
+{
+    public:
+        /**
+         * @brief   MIDI Machine Control commands
+         */
+        enum ECommand
+        {
+            EMMC_STOP           = 0x01,     ///< stop
+            EMMC_PLAY           = 0x02,     ///< play
+            EMMC_DEFERRED_PLAY  = 0x03,     ///< play as soon as a pending locate is done
+            EMMC_LOCATE         = 0x44,     ///< locate to a time code position
+        };
+
+        /**
+         * @brief   Length of a command without data
+         */
+        static const unsigned int cbCommand = 6;
+
+        /**
+         * @brief   Length of a locate command
+         */
+        static const unsigned int cbLocate = 13;
+
+        /**
+         * @brief   Build a command without data
+         * @param   bDevice
+         *              Device id (0x7F for all devices)
+         * @param   iCommand
+         *              Command
+         * @param   rgbMsg
+         *              Receives the message
+         */
+        static void command( MidiByte bDevice, ECommand iCommand, MidiByte rgbMsg[ cbCommand ] )
+        {
+            rgbMsg[ 0 ] = 0xF0;
+            rgbMsg[ 1 ] = 0x7F;
+            rgbMsg[ 2 ] = bDevice;
+            rgbMsg[ 3 ] = 0x06;
+            rgbMsg[ 4 ] = iCommand;
+            rgbMsg[ 5 ] = 0xF7;
+        }
+
+        /**
+         * @brief   Build a locate command (target field, subframe 0)
+         * @param   bDevice
+         *              Device id (0x7F for all devices)
+         * @param   grBSD
+         *              Target time code including the rate bits
+         * @param   rgbMsg
+         *              Receives the message
+         */
+        static void locate( MidiByte bDevice, const BSDTime& grBSD, MidiByte rgbMsg[ cbLocate ] )
+        {
+            command( bDevice, EMMC_LOCATE, rgbMsg );
+            rgbMsg[ 5 ] = 0x06;
+            rgbMsg[ 6 ] = 0x01;
+            rgbMsg[ 7 ] = grBSD.hour;
+            rgbMsg[ 8 ] = grBSD.minute;
+            rgbMsg[ 9 ] = grBSD.second;
+            rgbMsg[ 10 ] = grBSD.frame;
+            rgbMsg[ 11 ] = 0x00;
+            rgbMsg[ 12 ] = 0xF7;
+        }
+};
+
+#endif // ifndef _MMC_H_
@@ -0,0 +1,121 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MTCDECODER_H_
+#define _MTCDECODER_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "typedefs.h"
+#include "Timecode.h"
+
+/**
+ * @brief   Decoder of incoming MIDI time code
+ *
+ * Quarter frames carry the label of the frame at which piece 0 was sent, in the BSD layout
+ * of {@link MtcEncoder}. The first complete, ascending sequence of 8 pieces locks the
+ * decoder (2 frames). From then on every quarter frame yields a position with quarter frame
+ * resolution, and each completed sequence is checked against the counted frame. Full frame
+ * SysEx messages lock immediately.
+ *
+ * Positions are the time code converted to time (us since 00:00:00:00) at the local time
+ * the message was received.
+ */
+class MtcDecoder
+{
+    public:
+        /**
+         * @brief   Decoded time code position
+         */
+        struct Position
+        {
+            int64_t lUs;                    ///< time code as time in us
+            LTimePoint ltime;               ///< local time of reception
+            bool fLocate;                   ///< position does not follow the previous one
+        };
+
+        /**
+         * @brief   Constructor
+         */
+        MtcDecoder();
+
+        /**
+         * @brief   Feed a quarter frame
+         * @param   bData
+         *              Data byte of the quarter frame message (0nnndddd)
+         * @param   ltime
+         *              Local time of reception
+         * @param   grPos
+         *              Receives the position
+         * @return  True if a position was decoded
+         */
+        bool quarterFrame( MidiByte bData, LTimePoint ltime, Position& grPos );
+
+        /**
+         * @brief   Feed a SysEx message
+         * @param   rgbMsg
+         *              Message starting with 0xF0
+         * @param   cb
+         *              Length of the message
+         * @param   ltime
+         *              Local time of reception
+         * @param   grPos
+         *              Receives the position
+         * @return  True if the message is a full frame message
+         */
+        bool sysEx( const MidiByte* rgbMsg, unsigned int cb, LTimePoint ltime, Position& grPos );
+
+        /**
+         * @brief   Indicate if quarter frames are being decoded
+         */
+        bool isLocked() const
+        {
+            return _fLocked;
+        }
+
+        /**
+         * @brief   Drop the lock (e.g. after time code stopped)
+         */
+        void reset();
+
+    private:
+        /**
+         * @brief   Time of a quarter frame position
+         * @param   iFrame
+         *              Frame at which piece 0 was sent
+         * @param   iPiece
+         *              Piece 0..7
+         */
+        int64_t quarterUs( int iFrame, int iPiece ) const;
+
+        /**
+         * @brief   Use the frame rate of the received time code
+         */
+        void setRate( MidiByte bRate );
+
+    private:
+        std::unique_ptr<MtcEncoder>             _pgrRate; // frame arithmetic of the received rate
+        MidiByte                                _rgbPiece[ 8 ]; // nibbles of the current sequence
+        int                                     _iNext; // next expected piece or -1 if out of order
+        int                                     _cPieces; // pieces received in order
+        int                                     _iFrame; // frame of piece 0 of the current sequence
+        bool                                    _fLocked;
+        bool                                    _fLocate; // next position is a relocation
+};
+
+#endif // ifndef _MTCDECODER_H_
@@ -0,0 +1,114 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MTCSLAVE_H_
+#define _MTCSLAVE_H_
+
+#include <iostream>
+#include <stdexcept>
+
+#include <portmidi.h>
+#include <xmmsclient/xmmsclient++.h>
+
+#include "typedefs.h"
+#include "Exchange.h"
+#include "Config.h"
+#include "Status.h"
+#include "MtcDecoder.h"
+#include "Chaser.h"
+
+/**
+ * @brief   Follows MIDI time code received from another device (chase mode)
+ *
+ * Runs in its own thread instead of {@link MidiMaster}: incoming quarter frames and full
+ * frame messages are decoded with their PortMidi reception time, and XMMS2 is driven by
+ * the decisions of a {@link Chaser}. Commands go through a separate, synchronous XMMS2
+ * connection, so the main loop of {@link XmmsClient} keeps delivering statuses.
+ */
+class MtcSlave
+{
+    private:
+        /**
+         * @brief   Number of events read from PortMidi at once
+         */
+        static const int cRead = 64;
+
+        /**
+         * @brief   Longest SysEx message of interest (full frame is 10 bytes)
+         */
+        static const unsigned int cMaxSysEx = 16;
+
+    public:
+        /**
+         * @brief   Constructor
+         * @param   config
+         *              Config object
+         * @param   ex
+         *              Status exchange object to get playback information from
+         * @throws  std::runtime_error
+         */
+        MtcSlave( const Config& config, StatusExchange& ex );
+
+        /**
+         * @brief   Main loop (blocking), polls the MIDI input every millisecond
+         */
+        void run();
+
+    private:
+        /**
+         * @brief   Read and decode all pending MIDI input
+         */
+        void readInput();
+
+        /**
+         * @brief   Decode a byte of a SysEx message
+         * @param   b
+         *              Byte
+         * @param   ltime
+         *              Local time of reception
+         */
+        void sysExByte( MidiByte b, LTimePoint ltime );
+
+        /**
+         * @brief   Pass a decoded position to the chaser
+         */
+        void position( const MtcDecoder::Position& grPos );
+
+        /**
+         * @brief   Send a transport command to XMMS2
+         * @param   iAction
+         *              Command
+         * @param   xSeek
+         *              Position (ms) for Chaser::ECA_SEEK
+         */
+        void execute( Chaser::EAction iAction, XTimePoint xSeek );
+
+    private:
+        Xmms::Client                _client;
+        StatusExchange&             _grStatusExchange;
+        PortMidiStream*             _hMidiIn;
+        bool                        _fVerbose;
+
+        MtcDecoder                  _grDecoder;
+        Chaser                      _grChaser;
+        PmEvent                     _rgEvent[ cRead ];
+        MidiByte                    _rgbSysEx[ cMaxSysEx ];
+        unsigned int                _cbSysEx;
+        bool                        _fSysEx; // inside a SysEx message
+};
+
+#endif // ifndef _MTCSLAVE_H_
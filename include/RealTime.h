@@ -0,0 +1,52 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _REALTIME_H_
+#define _REALTIME_H_
+
+/**
+ * @file    RealTime.h
+ * @brief   Helpers to run a thread with real-time guarantees
+ */
+
+#include "typedefs.h"
+
+namespace RealTime
+{
+    /**
+     * @brief   Lock all current and future pages of the process into memory
+     * @return  True if successful
+     */
+    bool lockMemory();
+
+    /**
+     * @brief   Switch the calling thread to SCHED_FIFO and pre-fault its stack
+     * @param   iPriority
+     *              SCHED_FIFO priority (1-99)
+     * @return  True if the scheduling policy could be changed
+     */
+    bool enterRealtime( int iPriority );
+
+    /**
+     * @brief   Sleep until an absolute local time
+     * @param   lTime
+     *              Local time to wake up at
+     */
+    void sleepUntil( LTimePoint lTime );
+}
+
+#endif // ifndef _REALTIME_H_
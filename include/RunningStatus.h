@@ -0,0 +1,116 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RUNNINGSTATUS_H_
+#define _RUNNINGSTATUS_H_
+
+#include "typedefs.h"
+
+/**
+ * @brief   MIDI running status of an output port
+ *
+ * Consecutive channel messages with the same status byte may omit it on the wire, which saves
+ * a third of the bytes of a burst of three byte messages. System common messages (e.g.
+ * quarter frames) and SysEx cancel the running status, real-time messages leave it alone.
+ *
+ * Both backends take complete messages, so whether the bytes are actually saved depends on
+ * the driver (ALSA's rawmidi drivers apply running status by default). This class only
+ * predicts the bytes on the wire for the byte budget of the {@link WireScheduler}; enabled
+ * for a driver that does not compress, the budget underestimates how busy the link is.
+ */
+class RunningStatus
+{
+    public:
+        /**
+         * @brief   Constructor
+         * @param   fEnabled
+         *              Omit repeated status bytes. If false, messages are encoded completely.
+         */
+        RunningStatus( bool fEnabled = true ) :
+            _fEnabled( fEnabled ), _bStatus( 0 )
+        {
+        }
+
+        /**
+         * @brief   Get the number of bytes of a complete short message
+         */
+        static unsigned int length( MidiMsg msg )
+        {
+            MidiByte bStatus = msg & 0xFF;
+            if( bStatus < 0xF0 )
+                // program change and channel pressure have a single data byte
+                return ( bStatus & 0xE0 ) == 0xC0 ? 2 : 3;
+            switch( bStatus )
+            {
+                case 0xF1: // quarter frame
+                case 0xF3: // song select
+                    return 2;
+                case 0xF2: // song position pointer
+                    return 3;
+                default:
+                    return 1;
+            }
+        }
+
+        /**
+         * @brief   Get the number of bytes a message takes on the wire next
+         * @param   msg
+         *              Short message
+         */
+        unsigned int size( MidiMsg msg ) const
+        {
+            return length( msg ) - ( isRunning( msg & 0xFF ) ? 1 : 0 );
+        }
+
+        /**
+         * @brief   Account for a message sent and advance the running status
+         * @param   msg
+         *              Short message
+         * @return  Number of bytes the message takes on the wire
+         */
+        unsigned int advance( MidiMsg msg )
+        {
+            MidiByte bStatus = msg & 0xFF;
+            unsigned int cb = size( msg );
+            if( bStatus < 0xF8 )
+                _bStatus = bStatus < 0xF0 ? bStatus : 0;
+            return cb;
+        }
+
+        /**
+         * @brief   Forget the running status (e.g. after a SysEx message)
+         */
+        void reset()
+        {
+            _bStatus = 0;
+        }
+
+    private:
+        /**
+         * @brief   Indicate if a status byte can be omitted
+         */
+        bool isRunning( MidiByte bStatus ) const
+        {
+            return _fEnabled && bStatus < 0xF0 && bStatus == _bStatus;
+        }
+
+    private:
+        bool                                    _fEnabled;
+        MidiByte                                _bStatus; // last channel status or 0
+};
+
+#endif // ifndef _RUNNINGSTATUS_H_
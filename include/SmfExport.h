@@ -0,0 +1,131 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SMFEXPORT_H_
+#define _SMFEXPORT_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+#include "typedefs.h"
+#include "Config.h"
+#include "SongIdNotifier.h"
+#include "Timecode.h"
+
+/**
+ * @brief   Renders the MIDI stream of a playlist into Standard MIDI Files ahead of time
+ *
+ * Each song becomes a type 1 file (conductor track and one track with the stream) with
+ * SMPTE time division of the configured frame rate, so every quarter frame falls exactly
+ * on a tick. A song's stream is what is sent while it is played from the beginning within
+ * a playlist:
+ * - song begin notification, MMC locate to 0 and deferred play (if configured), full frame
+ * - quarter frames of all frame pairs starting before the end of the song
+ * - song end notification at the end of the song
+ *
+ * All messages are built by the same encoders as the live output. Songs are independent,
+ * so they are rendered in parallel.
+ */
+class SmfExport
+{
+    public:
+        /**
+         * @brief   Ticks per frame (4 per quarter frame)
+         */
+        static const int                        cTicksPerFrame = 80;
+
+        /**
+         * @brief   Song of the playlist
+         */
+        struct Song
+        {
+            XSongId ilSongId;               ///< xmms2 song id
+            XTimePoint lDuration;           ///< duration in ms
+        };
+
+        /**
+         * @brief   Constructor
+         * @param   bRate
+         *              Frame rate bits (see {@link FrameRate})
+         * @param   grBegin
+         *              Song begin notifier
+         * @param   grEnd
+         *              Song end notifier
+         * @param   iMmcDevice
+         *              MMC device id or -1 if no MMC is sent
+         */
+        SmfExport( MidiByte bRate, const SongIdNotifier& grBegin, const SongIdNotifier& grEnd,
+                int iMmcDevice = -1 );
+
+        /**
+         * @brief   Render the file of a song
+         * @param   grSong
+         *              Song
+         * @return  Contents of the file
+         */
+        std::string render( const Song& grSong ) const;
+
+        /**
+         * @brief   Render and write the files of all songs in parallel
+         * @param   rggrSongs
+         *              Songs in playlist order
+         * @param   szDir
+         *              Output directory; files are named <position>-<song id>.mid
+         * @param   cThreads
+         *              Number of worker threads (0 for one per core)
+         * @throws  std::runtime_error
+         */
+        void write( const std::vector<Song>& rggrSongs, const std::string& szDir,
+                unsigned int cThreads = 0 ) const;
+
+        /**
+         * @brief   Read the songs from a file standing in for the playlist and medialib
+         * @param   szFile
+         *              Lines of "<song id> <duration in ms>" in playlist order, '#' comments
+         * @param   rggrSongs
+         *              Receives the songs
+         * @throws  std::runtime_error
+         */
+        static void loadSongs( const std::string& szFile, std::vector<Song>& rggrSongs );
+
+        /**
+         * @brief   Read the songs of XMMS2's active playlist and their durations
+         * @param   config
+         *              Config object (XMMS2 path)
+         * @param   rggrSongs
+         *              Receives the songs
+         * @throws  std::runtime_error
+         */
+        static void loadPlaylist( const Config& config, std::vector<Song>& rggrSongs );
+
+    private:
+        /**
+         * @brief   Get the tick of a song position
+         */
+        int64_t tickAt( XTimePoint xtime ) const;
+
+    private:
+        MidiByte                                _bRate;
+        std::unique_ptr<MtcEncoder>             _pgrRate; // frame arithmetic (const use only)
+        const SongIdNotifier&                   _grBegin;
+        const SongIdNotifier&                   _grEnd;
+        int                                     _iMmcDevice;
+};
+
+#endif // ifndef _SMFEXPORT_H_
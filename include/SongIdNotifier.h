@@ -71,6 +71,27 @@ class SongIdNotifier
                bool                     fLE = false
             );
 
+        /**
+         * @brief   Copy constructor. The copy uses the same id map as other.
+         */
+        SongIdNotifier( const SongIdNotifier& other ) = default;
+
+        /**
+         * @brief   Take over the message settings of another notifier
+         * @param   other
+         *              Notifier to copy command, channel, endianness and offset from
+         * @return  *this
+         *
+         * The id map is not copied, this notifier keeps using its own.
+         */
+        SongIdNotifier& operator=( const SongIdNotifier& other )
+        {
+            _dlId = other._dlId;
+            _rgbStatus = other._rgbStatus;
+            _fLE = other._fLE;
+            return *this;
+        }
+
         /**
          * @brief   Generate a MIDI message
          * @param   ilSongId
@@ -21,6 +21,7 @@
 #include <utility>
 
 #include "typedefs.h"
+#include "Exchange.h"
 
 /**
  * @brief   Class to exchange time, playback status and song id
@@ -48,7 +49,8 @@ class Status
          * @brief   Default Constructor
          */
         Status() : _iState( EPS_INVALID ), _ilSongId( XSongIdInvalid ), 
-                   _grTime( TimePointInvalid )
+                   _grTime( TimePointInvalid ), _lDuration( XTimePointInvalid ),
+                   _ilNextSongId( XSongIdInvalid ), _dfBpm( 0 )
         {
         }
 
@@ -112,13 +114,105 @@ class Status
             return _ilSongId;
         }
 
+        /**
+         * @brief   Set the duration of the current song
+         * @param   lDuration
+         *              Duration in ms or XTimePointInvalid if unknown
+         */
+        void setDuration( XTimePoint lDuration )
+        {
+            _lDuration = lDuration;
+        }
+
+        /**
+         * @brief   Get the duration of the current song
+         * @return  Duration in ms or XTimePointInvalid if unknown
+         */
+        XTimePoint getDuration() const
+        {
+            return _lDuration;
+        }
+
+        /**
+         * @brief   Set the id of the song following the current one in the playlist
+         * @param   ilSongId
+         *              Next xmms2 song id or XSongIdInvalid if there is none
+         */
+        void setNextSongId( XSongId ilSongId )
+        {
+            _ilNextSongId = ilSongId;
+        }
+
+        /**
+         * @brief   Get the id of the song following the current one in the playlist
+         * @return  Next xmms2 song id or XSongIdInvalid if unknown
+         */
+        XSongId getNextSongId() const
+        {
+            return _ilNextSongId;
+        }
+
+        /**
+         * @brief   Set the tempo of the current song
+         * @param   dfBpm
+         *              Beats per minute or 0 if unknown
+         */
+        void setBpm( double dfBpm )
+        {
+            _dfBpm = dfBpm;
+        }
+
+        /**
+         * @brief   Get the tempo of the current song
+         * @return  Beats per minute from the medialib or 0 if unknown
+         */
+        double getBpm() const
+        {
+            return _dfBpm;
+        }
+
     private:
         // save playback state and song id
         EPlaybackStatus         _iState;
         XSongId                 _ilSongId;
 
         TimePoint               _grTime;
+
+        // used to predict the next song change
+        XTimePoint              _lDuration;
+        XSongId                 _ilNextSongId;
+
+        // used for the beat clock
+        double                  _dfBpm;
 };
 
+/**
+ * @brief   Queue settings for Status objects
+ *
+ * Pure playtime updates are merged into the newest queued status, while every change of
+ * playback status or song id keeps its own slot. Duration and next song id are merely
+ * updated by merging, as only their latest values matter.
+ */
+template<>
+struct ExchangeTraits<Status>
+{
+    static const unsigned int                   cQueue = 64;
+
+    static bool coalesce( const Status& older, const Status& newer )
+    {
+        return older.getPlaybackStatus() == newer.getPlaybackStatus() &&
+            older.getSongId() == newer.getSongId();
+    }
+};
+
+/**
+ * @brief   Exchange handing Status objects from the XMMS2 client to the MIDI master
+ *
+ * There is exactly one writer (XmmsClient) and one reader (MidiMaster), so the lock-free
+ * policy can be used. Neither thread ever waits for a lock held by the other one, and no
+ * state transition is lost if the reader falls behind.
+ */
+typedef Exchange<Status, QueueExchangePolicy> StatusExchange;
+
 #endif // ifndef _STATUS_H_
 
@@ -0,0 +1,155 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TIMEMODEL_H_
+#define _TIMEMODEL_H_
+
+#include <cstdint>
+
+#include "typedefs.h"
+
+/**
+ * @brief   Linear model mapping xmms2 playback time onto local time
+ *
+ * ltime = slope * xtime + intercept
+ *
+ * The slope (local nanoseconds per xmms2 millisecond) is kept as a 64-bit fixed-point number
+ * with cFracBits fractional bits. Extrapolation needs one multiplication with a 128-bit
+ * intermediate and a shift, so it neither overflows for any xtime representable as
+ * XTimePoint nor needs a division or floating point arithmetic.
+ *
+ * Rounding is done by adding half a unit before shifting (i.e. floor(s*x + 1/2)). As the
+ * slope is never negative, this is a non-decreasing function of xtime: extrapolated time
+ * stamps never run backwards.
+ */
+class TimeModel
+{
+    public:
+        /**
+         * @brief   Number of fractional bits of the slope
+         */
+        static const int                        cFracBits = 32;
+
+        /**
+         * @brief   Constructor. Slope 1 (real time), intercept 0
+         */
+        TimeModel() : _lSlope( LTimeMs << cFracBits ), _lIntercept( 0 )
+        {
+        }
+
+        /**
+         * @brief   Set the slope from a pair of deltas
+         * @param   dL
+         *              Local time delta
+         * @param   dX
+         *              xmms2 time delta (must be positive)
+         *
+         * Negative slopes are clipped to zero to keep the model monotone.
+         */
+        void setSlope( LTimePoint dL, XTimePoint dX )
+        {
+            if( dX <= 0 )
+                return;
+            if( dL <= 0 )
+            {
+                _lSlope = 0;
+                return;
+            }
+            __int128 lSlope = ( ( static_cast<__int128>( dL ) << cFracBits ) + dX / 2 ) / dX;
+            _lSlope = lSlope > INT64_MAX ? INT64_MAX : static_cast<int64_t>( lSlope );
+        }
+
+        /**
+         * @brief   Set the slope as fixed-point number
+         * @param   lSlope
+         *              Local nanoseconds per xmms2 millisecond, cFracBits fractional bits
+         */
+        void setSlopeFixed( int64_t lSlope )
+        {
+            _lSlope = lSlope < 0 ? 0 : lSlope;
+        }
+
+        /**
+         * @brief   Get the slope as fixed-point number
+         * @return  Local nanoseconds per xmms2 millisecond, cFracBits fractional bits
+         */
+        int64_t getSlopeFixed() const
+        {
+            return _lSlope;
+        }
+
+        /**
+         * @brief   Move the model such that it passes through a time point (slope unchanged)
+         * @param   t
+         *              Time point to pass through
+         */
+        void setIntercept( const TimePoint& t )
+        {
+            _lIntercept = t.ltime - scale( t.xtime );
+        }
+
+        /**
+         * @brief   Get the intercept
+         * @return  Local time corresponding to xtime 0
+         */
+        LTimePoint getIntercept() const
+        {
+            return _lIntercept;
+        }
+
+        /**
+         * @brief   Extrapolate
+         * @param   xtime
+         *              xmms2 time
+         * @return  Local time corresponding to xtime
+         */
+        LTimePoint at( int64_t xtime ) const
+        {
+            return _lIntercept + scale( xtime );
+        }
+
+        /**
+         * @brief   Extrapolate a time given with sub-millisecond resolution
+         * @param   xtimeUs
+         *              xmms2 time in us
+         * @return  Local time corresponding to xtimeUs
+         */
+        LTimePoint atMicro( int64_t xtimeUs ) const
+        {
+            // floor division keeps the result non-decreasing
+            __int128 lScaled = static_cast<__int128>( _lSlope ) * xtimeUs;
+            __int128 lMs = lScaled >= 0 ? lScaled / 1000 : -( ( -lScaled + 999 ) / 1000 );
+            return _lIntercept + static_cast<LTimePoint>( ( lMs +
+                        ( static_cast<__int128>( 1 ) << ( cFracBits - 1 ) ) ) >> cFracBits );
+        }
+
+    private:
+        /**
+         * @brief   Multiply by the slope and round
+         */
+        LTimePoint scale( int64_t xtime ) const
+        {
+            return static_cast<LTimePoint>( ( static_cast<__int128>( _lSlope ) * xtime +
+                        ( static_cast<__int128>( 1 ) << ( cFracBits - 1 ) ) ) >> cFracBits );
+        }
+
+    private:
+        int64_t                                 _lSlope; // fixed point, never negative
+        LTimePoint                              _lIntercept;
+};
+
+#endif // ifndef _TIMEMODEL_H_
@@ -0,0 +1,419 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TIMECODE_H_
+#define _TIMECODE_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "typedefs.h"
+
+/**
+ * @brief   Struct for BSD time
+ */
+struct BSDTime
+{
+    MidiByte hour;                  ///< Hour including frame rate information
+    MidiByte minute;                ///< Minute
+    MidiByte second;                ///< Second
+    MidiByte frame;                 ///< Frame
+};
+
+namespace TimecodeDetail
+{
+    /**
+     * @brief   Pack of indices 0..N-1
+     */
+    template<int... I>
+    struct Indices
+    {
+    };
+
+    template<int N, int... I>
+    struct MakeIndices : MakeIndices<N - 1, N - 1, I...>
+    {
+    };
+
+    template<int... I>
+    struct MakeIndices<0, I...>
+    {
+        typedef Indices<I...> type;
+    };
+
+    /**
+     * @brief   Data bytes of the two quarter frames transmitting a field value
+     * @param   i
+     *              Value of the field
+     * @param   iField
+     *              0 = frame, 1 = second, 2 = minute, 3 = hour
+     * @param   bExtra
+     *              Bits added to the high nibble (frame rate in the hour)
+     * @return  Low piece in the low byte, high piece in the high byte
+     */
+    constexpr uint16_t nibblePair( int i, int iField, MidiByte bExtra )
+    {
+        return static_cast<uint16_t>( ( ( iField * 2 ) << 4 | ( i & 0x0F ) ) |
+                ( ( ( iField * 2 + 1 ) << 4 | ( i >> 4 ) | bExtra ) << 8 ) );
+    }
+
+    /**
+     * @brief   Quarter frame data bytes for all values of a field
+     */
+    template<class Seq, int Field, MidiByte Extra>
+    struct NibbleTable;
+
+    template<int Field, MidiByte Extra, int... I>
+    struct NibbleTable<Indices<I...>, Field, Extra>
+    {
+        static constexpr uint16_t rg[ sizeof...( I ) ] = { nibblePair( I, Field, Extra )... };
+    };
+
+    template<int Field, MidiByte Extra, int... I>
+    constexpr uint16_t NibbleTable<Indices<I...>, Field, Extra>::rg[ sizeof...( I ) ];
+}
+
+/**
+ * @brief   Compile-time description of a MIDI time code frame rate
+ * @tparam  Num
+ *              Numerator of the frame rate (frames per second)
+ * @tparam  Den
+ *              Denominator of the frame rate
+ * @tparam  Drop
+ *              True for drop-frame numbering (29.97 FPS)
+ * @tparam  Bits
+ *              Frame rate bits in the hour byte (0rr00000)
+ */
+template<int Num, int Den, bool Drop, MidiByte Bits>
+struct FrameRate
+{
+    static const int                            cNum = Num;
+    static const int                            cDen = Den;
+    static const bool                           fDrop = Drop;
+    static const MidiByte                       bRate = Bits;
+    static const int                            cNominal = ( Num + Den - 1 ) / Den; ///< frames per labelled second
+};
+
+typedef FrameRate<24, 1, false, 0x00>           FrameRate24;    ///< film
+typedef FrameRate<25, 1, false, 0x20>           FrameRate25;    ///< PAL
+typedef FrameRate<30000, 1001, true, 0x40>      FrameRate2997;  ///< NTSC drop-frame
+typedef FrameRate<30, 1, false, 0x60>           FrameRate30;    ///< NTSC non-drop
+
+/**
+ * @brief   Frame arithmetic of a MIDI time code stream
+ *
+ * Frames are counted from xmms2 time 0 in real frames; labels (BSD time) take drop-frame
+ * numbering into account. The rate is chosen once at startup by instantiating
+ * {@link MtcEncoderT}, so no calculation depends on a run-time frame rate.
+ *
+ * For streaming, the encoder keeps a time code counter. It is set by {@link seek()} and
+ * advanced two frames per quarter frame block with carry propagation; the quarter frame
+ * bytes are looked up in per-rate tables built at compile time.
+ */
+class MtcEncoder
+{
+    public:
+        /**
+         * @brief   Create the frame arithmetic of a frame rate
+         * @param   bRate
+         *              Frame rate bits as in the hour byte (0rr00000)
+         * @return  Encoder (the bits always denote a valid rate)
+         */
+        static std::unique_ptr<MtcEncoder> create( MidiByte bRate );
+
+        /**
+         * @brief   Build a full frame message (F0 7F 7F 01 01 hh mm ss ff F7)
+         * @param   grBSD
+         *              Frame label including the rate bits
+         * @param   rgbMsg
+         *              Receives the message
+         */
+        static void fullFrame( const BSDTime& grBSD, MidiByte rgbMsg[ 10 ] )
+        {
+            const MidiByte rgbHeader[] = { 0xF0, 0x7F, 0x7F, 0x01, 0x01 };
+            for( int i = 0; i < 5; ++i )
+                rgbMsg[ i ] = rgbHeader[ i ];
+            rgbMsg[ 5 ] = grBSD.hour;
+            rgbMsg[ 6 ] = grBSD.minute;
+            rgbMsg[ 7 ] = grBSD.second;
+            rgbMsg[ 8 ] = grBSD.frame;
+            rgbMsg[ 9 ] = 0xF7;
+        }
+
+        virtual ~MtcEncoder() {}
+
+        /**
+         * @brief   Get the frame running at an xmms2 time
+         * @param   xtime
+         *              xmms2 time in ms (not negative)
+         * @return  Frame index
+         */
+        virtual int frameAt( XTimePoint xtime ) const = 0;
+
+        /**
+         * @brief   Get the start of a frame
+         * @param   iFrame
+         *              Frame index
+         * @return  xmms2 time in us
+         */
+        virtual int64_t frameStartUs( int iFrame ) const = 0;
+
+        /**
+         * @brief   Get the label of a frame
+         * @param   iFrame
+         *              Frame index
+         * @return  BSD time including the frame rate bits
+         */
+        virtual BSDTime bsdTime( int iFrame ) const = 0;
+
+        /**
+         * @brief   Get the frame of a label (inverse of {@link bsdTime()})
+         * @param   grBSD
+         *              BSD time, the frame rate bits are ignored
+         * @return  Frame index
+         */
+        virtual int frameOf( const BSDTime& grBSD ) const = 0;
+
+        /**
+         * @brief   Get the frame rate bits as in the hour byte (0rr00000)
+         */
+        virtual MidiByte rateBits() const = 0;
+
+        /**
+         * @brief   Set the time code counter to a frame (full recompute, e.g. on a relocate)
+         * @param   iFrame
+         *              Frame index
+         */
+        virtual void seek( int iFrame ) = 0;
+
+        /**
+         * @brief   Get the frame the counter is at
+         * @return  Frame index
+         */
+        virtual int frame() const = 0;
+
+        /**
+         * @brief   Get the label of the frame the counter is at
+         * @return  BSD time including the frame rate bits
+         */
+        virtual BSDTime current() const = 0;
+
+        /**
+         * @brief   Get the label of the frame following a label, stepped with carry propagation
+         * @param   grBSD
+         *              Label including the frame rate bits
+         * @return  Label of the next frame
+         */
+        virtual BSDTime successor( const BSDTime& grBSD ) const = 0;
+
+        /**
+         * @brief   Get the quarter frames of the two frames starting at the counter, and
+         *          advance the counter by these two frames
+         * @param   rgb
+         *              Receives the data bytes of the 8 quarter frame messages
+         */
+        virtual void nextQuarterFrames( MidiByte rgb[ 8 ] ) = 0;
+};
+
+/**
+ * @brief   Frame arithmetic specialized for a frame rate
+ * @tparam  Rate
+ *              Instance of {@link FrameRate}
+ *
+ * All divisions are by compile-time constants.
+ */
+template<class Rate>
+class MtcEncoderT : public MtcEncoder
+{
+    private:
+        // quarter frame data bytes per field value
+        typedef TimecodeDetail::NibbleTable<typename TimecodeDetail::MakeIndices<Rate::cNominal>::type,
+                0, 0>                           FrameTable;
+        typedef TimecodeDetail::NibbleTable<typename TimecodeDetail::MakeIndices<60>::type,
+                1, 0>                           SecondTable;
+        typedef TimecodeDetail::NibbleTable<typename TimecodeDetail::MakeIndices<60>::type,
+                2, 0>                           MinuteTable;
+        typedef TimecodeDetail::NibbleTable<typename TimecodeDetail::MakeIndices<24>::type,
+                3, ( Rate::bRate >> 4 )>        HourTable;
+
+    public:
+        MtcEncoderT()
+        {
+            seek( 0 );
+        }
+
+        virtual int frameAt( XTimePoint xtime ) const
+        {
+            return static_cast<int>( static_cast<int64_t>( xtime ) * Rate::cNum / ( 1000LL * Rate::cDen ) );
+        }
+
+        virtual int64_t frameStartUs( int iFrame ) const
+        {
+            return ( static_cast<int64_t>( iFrame ) * 1000000 * Rate::cDen + Rate::cNum / 2 ) / Rate::cNum;
+        }
+
+        virtual BSDTime bsdTime( int iFrame ) const
+        {
+            int iLabel = label( iFrame );
+            BSDTime grBSD;
+            grBSD.frame = iLabel % Rate::cNominal;
+            int iSecond = iLabel / Rate::cNominal;
+            grBSD.second = iSecond % 60;
+            grBSD.minute = iSecond / 60 % 60;
+            grBSD.hour = ( iSecond / 3600 % 24 ) | Rate::bRate; // add frame rate information
+            return grBSD;
+        }
+
+        virtual int frameOf( const BSDTime& grBSD ) const
+        {
+            int cMinutes = ( grBSD.hour & 0x1F ) * 60 + grBSD.minute;
+            int iLabel = ( cMinutes * 60 + grBSD.second ) * Rate::cNominal + grBSD.frame;
+            if( !Rate::fDrop )
+                return iLabel;
+            // two labels skipped per minute, except for every tenth minute
+            return iLabel - 2 * ( cMinutes - cMinutes / 10 );
+        }
+
+        virtual MidiByte rateBits() const
+        {
+            return Rate::bRate;
+        }
+
+        virtual void seek( int iFrame )
+        {
+            BSDTime grBSD = bsdTime( iFrame );
+            _iFrame = iFrame;
+            _ff = grBSD.frame;
+            _ss = grBSD.second;
+            _mm = grBSD.minute;
+            _hh = grBSD.hour & 0x1F;
+        }
+
+        virtual int frame() const
+        {
+            return _iFrame;
+        }
+
+        virtual BSDTime current() const
+        {
+            BSDTime grBSD;
+            grBSD.frame = _ff;
+            grBSD.second = _ss;
+            grBSD.minute = _mm;
+            grBSD.hour = _hh | Rate::bRate;
+            return grBSD;
+        }
+
+        virtual BSDTime successor( const BSDTime& grBSD ) const
+        {
+            BSDTime grNext = grBSD;
+            if( ++grNext.frame < Rate::cNominal )
+                return grNext;
+            grNext.frame = 0;
+            if( ++grNext.second < 60 )
+                return grNext;
+            grNext.second = 0;
+            if( ++grNext.minute == 60 )
+            {
+                grNext.minute = 0;
+                grNext.hour = ( ( grNext.hour & 0x1F ) + 1 ) % 24 | Rate::bRate;
+            }
+            if( Rate::fDrop && grNext.minute % 10 != 0 )
+                grNext.frame = 2; // labels 0 and 1 do not exist
+            return grNext;
+        }
+
+        virtual void nextQuarterFrames( MidiByte rgb[ 8 ] )
+        {
+            uint16_t w;
+            w = FrameTable::rg[ _ff ];
+            rgb[ 0 ] = w & 0xFF;
+            rgb[ 1 ] = w >> 8;
+            w = SecondTable::rg[ _ss ];
+            rgb[ 2 ] = w & 0xFF;
+            rgb[ 3 ] = w >> 8;
+            w = MinuteTable::rg[ _mm ];
+            rgb[ 4 ] = w & 0xFF;
+            rgb[ 5 ] = w >> 8;
+            w = HourTable::rg[ _hh ];
+            rgb[ 6 ] = w & 0xFF;
+            rgb[ 7 ] = w >> 8;
+            advance();
+        }
+
+        /**
+         * @brief   Get the label number of a frame
+         * @param   iFrame
+         *              Frame index
+         * @return  Frame number as counted by the labels
+         *
+         * Drop-frame time code skips labels 0 and 1 at the start of every minute except for
+         * every tenth minute, i.e. 18 labels per 17982 frames.
+         */
+        static int label( int iFrame )
+        {
+            if( !Rate::fDrop )
+                return iFrame;
+            int iTen = iFrame / 17982, iRest = iFrame % 17982;
+            return iFrame + 18 * iTen + ( iRest >= 2 ? 2 * ( ( iRest - 2 ) / 1798 ) : 0 );
+        }
+
+    private:
+        /**
+         * @brief   Advance the counter by two frames with carry propagation
+         */
+        void advance()
+        {
+            _iFrame += 2;
+            _ff += 2;
+            if( _ff < Rate::cNominal )
+                return;
+            _ff -= Rate::cNominal;
+            if( ++_ss < 60 )
+                return;
+            _ss = 0;
+            if( ++_mm == 60 )
+            {
+                _mm = 0;
+                if( ++_hh == 24 )
+                    _hh = 0;
+            }
+            if( Rate::fDrop && _mm % 10 != 0 )
+                _ff += 2; // labels 0 and 1 do not exist
+        }
+
+    private:
+        int                                     _iFrame;
+        int                                     _ff, _ss, _mm, _hh; // label of _iFrame
+};
+
+inline std::unique_ptr<MtcEncoder> MtcEncoder::create( MidiByte bRate )
+{
+    switch( bRate & 0x60 )
+    {
+        case FrameRate24::bRate:
+            return std::unique_ptr<MtcEncoder>( new MtcEncoderT<FrameRate24>() );
+        case FrameRate25::bRate:
+            return std::unique_ptr<MtcEncoder>( new MtcEncoderT<FrameRate25>() );
+        case FrameRate2997::bRate:
+            return std::unique_ptr<MtcEncoder>( new MtcEncoderT<FrameRate2997>() );
+        default:
+            return std::unique_ptr<MtcEncoder>( new MtcEncoderT<FrameRate30>() );
+    }
+}
+
+#endif // ifndef _TIMECODE_H_
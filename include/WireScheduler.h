@@ -0,0 +1,192 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WIRESCHEDULER_H_
+#define _WIRESCHEDULER_H_
+
+#include "typedefs.h"
+#include "RunningStatus.h"
+
+/**
+ * @brief   MIDI message on its way to an output port
+ */
+struct WireMsg
+{
+    LTimePoint when;                ///< Time to put the message on the wire at
+    MidiMsg msg;                    ///< Short message or 0 for a SysEx message
+    MidiByte rgbSysEx[ 16 ];        ///< SysEx message terminated by 0xF7
+};
+
+/**
+ * @brief   Byte budget of a slow MIDI link (e.g. 5-pin DIN at 31.25 kbaud)
+ *
+ * Every byte occupies the link for 10 bit times, so a 10 byte SysEx blocks a DIN cable for
+ * 3.2 ms. The scheduler models when the link is busy and assigns each message the time it
+ * actually gets on the wire:
+ * - Time code (quarter frames, full frames) and real-time messages (beat clock) are urgent
+ *   and go out as soon as the link is free.
+ * - Quarter frames form a regular stream. Other messages only go out if they end before the
+ *   next expected quarter frame. Otherwise they are deferred into the gap after it.
+ *
+ * Message sizes follow the running status of the link if it is enabled.
+ *
+ * Messages are submitted in time order and taken out in wire order with {@link pop()}, which
+ * must be called until it fails after every {@link submit()}. The delay reported there is the
+ * time a message was moved back. Without a byte budget messages pass unchanged.
+ */
+class WireScheduler
+{
+    public:
+        /**
+         * @brief   Bit rate of a DIN MIDI link
+         */
+        static const int                        cDinBaud = 31250;
+
+        /**
+         * @brief   Bits on the wire per byte (start bit, 8 data bits, stop bit)
+         */
+        static const int                        cBitsPerByte = 10;
+
+        /**
+         * @brief   Urgent messages further apart do not form a stream
+         */
+        static const LTimePoint                 cMaxPeriod = 50 * LTimeMs;
+
+        /**
+         * @brief   Maximum number of deferred messages. Further ones force the oldest out.
+         */
+        static const unsigned int               cDeferred = 16;
+
+        /**
+         * @brief   Constructor
+         * @param   iBaud
+         *              Bit rate of the link or 0 if it is not limited (e.g. USB)
+         * @param   fRunningStatus
+         *              The link applies running status
+         */
+        WireScheduler( int iBaud = 0, bool fRunningStatus = false );
+
+        /**
+         * @brief   Get the number of bytes of a SysEx message including 0xF7
+         */
+        static unsigned int sizeSysEx( const MidiByte* rgbMsg );
+
+        /**
+         * @brief   Indicate if a message is time critical
+         * @param   grMsg
+         *              Short message (quarter frame, real-time) or SysEx (full frame)
+         */
+        static bool isUrgent( const WireMsg& grMsg );
+
+        /**
+         * @brief   Indicate if the link has a byte budget
+         */
+        bool isLimited() const
+        {
+            return _lByte > 0;
+        }
+
+        /**
+         * @brief   Get the number of messages waiting for a gap in the time code
+         */
+        unsigned int deferred() const
+        {
+            return _iDeferredHead - _iDeferredTail;
+        }
+
+        /**
+         * @brief   Submit a message
+         * @param   grMsg
+         *              Message with the time it is due
+         */
+        void submit( const WireMsg& grMsg );
+
+        /**
+         * @brief   Take the next message to write to the port
+         * @param   grMsg
+         *              Message with the time it gets on the wire
+         * @param   lDelay
+         *              Time the message was moved back
+         * @return  False if no message is ready
+         */
+        bool pop( WireMsg& grMsg, LTimePoint& lDelay );
+
+        /**
+         * @brief   The time code stream ends (stop, pause, hold): release deferred messages
+         */
+        void endStream();
+
+    private:
+        /**
+         * @brief   Message with its wire time assigned
+         */
+        struct Placed
+        {
+            WireMsg grMsg;
+            LTimePoint lDelay;
+        };
+
+        /**
+         * @brief   Wire time of a number of bytes
+         */
+        LTimePoint duration( unsigned int cb ) const
+        {
+            return cb * _lByte;
+        }
+
+        /**
+         * @brief   Get the number of bytes a message takes on the wire next
+         */
+        unsigned int size( const WireMsg& grMsg ) const
+        {
+            return grMsg.msg ? _grRunningStatus.size( grMsg.msg ) : sizeSysEx( grMsg.rgbSysEx );
+        }
+
+        /**
+         * @brief   Assign the wire time and queue a message for output
+         * @param   grMsg
+         *              Message
+         * @param   lStart
+         *              Wire time
+         */
+        void place( const WireMsg& grMsg, LTimePoint lStart );
+
+        /**
+         * @brief   Place deferred messages which end before a time
+         * @param   lLimit
+         *              Deferred messages must be off the wire by then, unbounded if invalid
+         */
+        void release( LTimePoint lLimit );
+
+    private:
+        LTimePoint                              _lByte; // wire time of one byte
+        LTimePoint                              _lBusy; // link is occupied until
+        LTimePoint                              _lLastUrgent; // time of the last stream message
+        unsigned int                            _cbLastUrgent;
+        LTimePoint                              _lPeriod; // spacing of the stream or 0
+        RunningStatus                           _grRunningStatus;
+
+        WireMsg                                 _rgDeferred[ cDeferred ];
+        unsigned int                            _iDeferredHead;
+        unsigned int                            _iDeferredTail;
+
+        Placed                                  _rgOut[ cDeferred + 1 ];
+        unsigned int                            _iOut; // next message to pop
+        unsigned int                            _cOut;
+};
+
+#endif // ifndef _WIRESCHEDULER_H_
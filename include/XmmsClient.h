@@ -21,6 +21,8 @@
 #include <string>
 #include <iostream>
 #include <chrono>
+#include <map>
+#include <vector>
 
 #include <xmmsclient/xmmsclient++.h>
 
@@ -35,6 +37,17 @@
  */
 class XmmsClient
 {
+    private:
+        /**
+         * @brief   Medialib information cached per song
+         */
+        struct SongInfo
+        {
+            XTimePoint lDuration;           ///< Duration in ms
+            long cbPerSecond;               ///< Output data rate in bytes per second
+            double dfBpm;                   ///< Tempo or 0 if unknown
+        };
+
     public:
         /**
          * @brief   Constructor
@@ -44,13 +57,45 @@ class XmmsClient
          *              Exchange object to write status updates to
          * @throws  std::runtime_error
          */
-        XmmsClient( const Config& config, Exchange<Status>& ex );
+        XmmsClient( const Config& config, StatusExchange& ex );
 
         /**
          * @brief   Main loop. Register all signals and broadcasts and loop infinitely
          */
         void run();
 
+        /**
+         * @brief   Replace the XMMS2 main loop used by {@link run()}
+         * @param   pml
+         *              Main loop to use. The XMMS2 client takes ownership.
+         */
+        void setMainloop( Xmms::MainloopInterface* pml )
+        {
+            _client.setMainloop( pml );
+        }
+
+        /**
+         * @brief   Get the underlying XMMS2 connection (e.g. to build a custom main loop)
+         * @return  Connection handle
+         */
+        xmmsc_connection_t* getConnection() const
+        {
+            return _client.getConnection();
+        }
+
+        /**
+         * @brief   Also write status updates to another exchange (e.g. of an additional output)
+         * @param   ex
+         *              Exchange object, must outlive the client
+         *
+         * Each exchange has its own reader, so a reader falling behind only drops its own
+         * statuses.
+         */
+        void fanOut( StatusExchange& ex )
+        {
+            _rgpgrFanOut.push_back( &ex );
+        }
+
         /**
          * @brief   Receive current playtime
          * @param   lTime
@@ -75,6 +120,46 @@ class XmmsClient
          */
         bool broadcastStatus( const Xmms::Playback::Status& iState );
 
+        /**
+         * @brief   Receive medialib information about a song
+         * @param   grInfo
+         *              Properties of the song (id, duration and format are used)
+         * @return  False (one-shot request)
+         */
+        bool mediaInfo( const Xmms::PropDict& grInfo );
+
+        /**
+         * @brief   Receive the size of XMMS2's output buffer
+         * @param   szValue
+         *              Value of "output.buffersize" in bytes
+         * @return  False (one-shot request)
+         */
+        bool outputBufferSize( const std::string& szValue );
+
+        /**
+         * @brief   Receive the current position in the active playlist
+         * @param   grPos
+         *              Dictionary holding the position
+         * @return  True to continue receiving this broadcast
+         */
+        bool playlistPos( const Xmms::Dict& grPos );
+
+        /**
+         * @brief   Receive notification about a changed playlist
+         * @param   grChange
+         *              Description of the change (unused, the playlist is reloaded)
+         * @return  True to continue receiving this broadcast (will always be true)
+         */
+        bool playlistChanged( const Xmms::Dict& grChange );
+
+        /**
+         * @brief   Receive the entries of the active playlist
+         * @param   rgilIds
+         *              XMMS2 song ids in playlist order
+         * @return  False (one-shot request)
+         */
+        bool playlistEntries( const Xmms::List<int>& rgilIds );
+
         /**
          * @brief   Error handler for XMMS2 calls
          * @param   szMsg
@@ -83,12 +168,49 @@ class XmmsClient
          */
         bool errorHandler( const std::string& szMsg );
 
+    private:
+        /**
+         * @brief   Write the current status to the exchange
+         */
+        void sendStatus();
+
+        /**
+         * @brief   Look up a song, request it from the medialib if unknown
+         * @param   ilSongId
+         *              XMMS2 song id
+         * @return  Cached information or null
+         */
+        const SongInfo* songInfo( XSongId ilSongId );
+
+        /**
+         * @brief   Update the next song id from the cached playlist and prefetch its duration
+         */
+        void updateNextSongId();
+
+        /**
+         * @brief   Use the information about the current song: set its duration and derive the
+         *          audio latency from the output buffer size
+         * @param   grSong
+         *              Information about the current song
+         */
+        void applySongInfo( const SongInfo& grSong );
+
     private:
         Xmms::Client                _client;
         const Config&               _config;
         Status                      _grStatus;
 
-        Exchange<Status>&           _grStatusExchange;
+        StatusExchange&             _grStatusExchange;
+        std::vector<StatusExchange*> _rgpgrFanOut; // exchanges of additional outputs
+
+        // song change prediction: medialib information is cached, as songs repeat
+        std::map<XSongId, SongInfo> _mpgrSongInfo;
+        std::vector<XSongId>        _rgilPlaylist;
+        int                         _iPlaylistPos;
+
+        // playtime is shifted to the time the audio is heard
+        LTimePoint                  _lAudioLatency;
+        long                        _cbOutputBuffer; // 0 if unknown
 
 };
 
@@ -25,11 +25,9 @@
 
 #include <map>
 #include <utility>
+#include <cstdint>
 
-#ifndef _PORTTIME_H_
-#define _PORTTIME_H_
-#include <porttime.h>
-#endif
+#include <time.h>
 
 /**
  * @brief   xmms2 song id
@@ -57,6 +55,16 @@ typedef std::map<XSongId, MSongId>              IdMap;
  */
 typedef std::pair<XSongId, MSongId>             IdMapEntry;
 
+/**
+ * @brief   Type for mapping XMMS2 song ids to their tempo (beats per minute)
+ */
+typedef std::map<XSongId, double>               TempoMap;
+
+/**
+ * @brief   Entry of a {@link TempoMap}
+ */
+typedef std::pair<XSongId, double>              TempoMapEntry;
+
 /**
  * @brief   Complete MIDI message
  */
@@ -78,22 +86,27 @@ typedef int                                     XTimePoint;
 static const XTimePoint                         XTimePointInvalid = 0;
 
 /**
- * @brief   System clock to use
+ * @brief   Representation of a local time in nanoseconds (CLOCK_MONOTONIC_RAW)
  */
-//typedef std::chrono::high_resolution_clock      Clock;
+typedef int64_t                                 LTimePoint;
 
 /**
- * @brief   Representation of a local time
+ * @brief   One millisecond in local time units
  */
-typedef PtTimestamp                             LTimePoint;
+static const LTimePoint                         LTimeMs = 1000000;
 
 /**
  * @brief   Get current local time
  * @return  LTimePoint representing the current local time
+ *
+ * The raw monotonic clock is neither stepped nor slewed by NTP. See {@link Clock} for
+ * conversions to other time bases.
  */
 static inline LTimePoint Now()
 {
-    return Pt_Time();
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC_RAW, &ts );
+    return static_cast<LTimePoint>( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
 }
 
 /**
@@ -0,0 +1,169 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+
+#include "Chaser.h"
+#include "TimeModel.h"
+
+Chaser::Chaser( XTimePoint xOffset ) :
+    _xOffset( xOffset ), _pgrEstimator( ClockEstimator::create( ClockEstimator::ECE_REGRESSION ) ),
+    _tMaster( TimePointInvalid ), _cMaster( 0 ), _fLocatePending( false ), _fLocked( false ),
+    _fStartPending( false ), _lLastSeek( LTimePointInvalid ), _fMeasure( false ),
+    _cRetries( 0 ), _xBias( 0 )
+{
+}
+
+void Chaser::master( int64_t lUs, LTimePoint ltime, bool fLocate )
+{
+    if( fLocate )
+    {
+        _pgrEstimator->reset();
+        _cMaster = 0;
+        _fLocatePending = true;
+    }
+    _tMaster = TimePoint( static_cast<XTimePoint>( lUs / 1000 ) - _xOffset, ltime );
+    _pgrEstimator->addSample( _tMaster );
+    ++_cMaster;
+}
+
+void Chaser::slave( const Status& grStatus )
+{
+    _grSlave = grStatus;
+    if( !_fMeasure || _cMaster == 0 || grStatus.getPlaybackStatus() != Status::EPS_PLAYING )
+        return;
+    const TimePoint& t = grStatus.getTime();
+    if( t.ltime < _lLastSeek + cSettle )
+        return;
+
+    // first settled status after a seek: learn the remaining error
+    _fMeasure = false;
+    XTimePoint xError = t.xtime - masterAt( t.ltime );
+    _xBias -= xError;
+    if( _xBias > cMaxBias )
+        _xBias = cMaxBias;
+    else if( _xBias < -cMaxBias )
+        _xBias = -cMaxBias;
+    if( std::abs( xError ) <= cLock || ( ++_cRetries >= cMaxRetries && std::abs( xError ) <= cUnlock ) )
+    {
+        _fLocked = true;
+        _cRetries = 0;
+    }
+}
+
+Chaser::EAction Chaser::decide( LTimePoint lNow, XTimePoint& xSeek )
+{
+    bool fPlaying = _grSlave.getPlaybackStatus() == Status::EPS_PLAYING;
+    bool fHoldoff = _lLastSeek != LTimePointInvalid && lNow - _lLastSeek < cSeekHoldoff;
+
+    if( !isMasterRunning( lNow ) )
+    {
+        _fLocked = false;
+        _fStartPending = false;
+        _fMeasure = false;
+        if( fPlaying )
+            return ECA_PAUSE;
+        if( _fLocatePending && _cMaster > 0 && !fHoldoff )
+        {
+            // follow the master while it stands still (e.g. cueing)
+            _fLocatePending = false;
+            xSeek = _tMaster.xtime < 0 ? 0 : _tMaster.xtime;
+            _lLastSeek = lNow;
+            return ECA_SEEK;
+        }
+        return ECA_NONE;
+    }
+    _fLocatePending = false;
+
+    XTimePoint xMaster = masterAt( lNow );
+    if( xMaster + _xBias < 0 )
+    {
+        // before the song start: wait at position 0
+        _fLocked = false;
+        if( fPlaying )
+            return ECA_PAUSE;
+        if( _grSlave.getTime().xtime != 0 && !fHoldoff )
+        {
+            xSeek = 0;
+            _lLastSeek = lNow;
+            return ECA_SEEK;
+        }
+        return ECA_NONE;
+    }
+
+    if( !fPlaying )
+    {
+        _fLocked = false;
+        if( _fStartPending )
+        {
+            _fStartPending = false;
+            return ECA_PLAY;
+        }
+        if( fHoldoff )
+            return ECA_NONE;
+        _fStartPending = true;
+        return seek( lNow, xSeek );
+    }
+    _fStartPending = false;
+
+    if( _fMeasure )
+        return ECA_NONE;
+    XTimePoint xError = slaveAt( lNow ) - xMaster;
+    if( _fLocked && std::abs( xError ) > cUnlock )
+        _fLocked = false;
+    else if( !_fLocked && std::abs( xError ) <= cLock )
+        _fLocked = true;
+    if( _fLocked || fHoldoff )
+        return ECA_NONE;
+    return seek( lNow, xSeek );
+}
+
+Chaser::EAction Chaser::seek( LTimePoint lNow, XTimePoint& xSeek )
+{
+    xSeek = masterAt( lNow ) + _xBias;
+    if( xSeek < 0 )
+        xSeek = 0;
+    _lLastSeek = lNow;
+    _fMeasure = true;
+    _fLocked = false;
+    return ECA_SEEK;
+}
+
+XTimePoint Chaser::masterAt( LTimePoint lTime ) const
+{
+    ClockEstimator::Estimate grEstimate;
+    if( !_pgrEstimator->getEstimate( grEstimate ) || grEstimate.lSlope <= 0 )
+        return _tMaster.xtime + static_cast<XTimePoint>( ( lTime - _tMaster.ltime ) / LTimeMs );
+    __int128 lScaled = static_cast<__int128>( lTime - grEstimate.grAnchor.ltime ) << TimeModel::cFracBits;
+    return grEstimate.grAnchor.xtime + static_cast<XTimePoint>( lScaled / grEstimate.lSlope );
+}
+
+XTimePoint Chaser::slaveAt( LTimePoint lTime ) const
+{
+    const TimePoint& t = _grSlave.getTime();
+    if( _grSlave.getPlaybackStatus() != Status::EPS_PLAYING )
+        return t.xtime;
+    return t.xtime + static_cast<XTimePoint>( ( lTime - t.ltime ) / LTimeMs );
+}
+
+bool Chaser::isMasterRunning( LTimePoint lNow ) const
+{
+    if( _cMaster < 2 || lNow - _tMaster.ltime > cMasterTimeout )
+        return false;
+    ClockEstimator::Estimate grEstimate;
+    return _pgrEstimator->getEstimate( grEstimate ) && grEstimate.lSlope > 0;
+}
@@ -0,0 +1,44 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Clock.h"
+
+PmTimestamp Clock::pmTimeProc( void* /* pv */ )
+{
+    return toPm( Now() );
+}
+
+struct timespec Clock::toMonotonic( LTimePoint lTime )
+{
+    // both clocks advance at (almost) the same rate, so mapping the current offset is
+    // precise enough for the next deadline
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    LTimePoint lMono = static_cast<LTimePoint>( ts.tv_sec ) * 1000000000 + ts.tv_nsec +
+        ( lTime - Now() );
+    if( lMono < 0 )
+        lMono = 0;
+    ts.tv_sec = lMono / 1000000000;
+    ts.tv_nsec = lMono % 1000000000;
+    return ts;
+}
+
+LTimePoint Clock::origin()
+{
+    static const LTimePoint lOrigin = Now();
+    return lOrigin;
+}
@@ -0,0 +1,209 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "ClockEstimator.h"
+#include "TimeModel.h"
+
+/**
+ * @brief   Minimum number of samples before outliers are rejected
+ */
+static const int cRejectMin = 4;
+
+/**
+ * @brief   A sample is an outlier if its residual exceeds this multiple of the typical residual
+ */
+static const double dfRejectFactor = 4.0;
+
+/**
+ * @brief   Residuals below this are never rejected (scheduling noise of the local machine)
+ */
+static const LTimePoint cRejectFloor = 2 * LTimeMs;
+
+/**
+ * @brief   Number of rejections in a row after which the fit is restarted
+ */
+static const int cRejectMax = 3;
+
+/**
+ * @brief   Residual which halves the confidence
+ */
+static const double dfResidualRef = 1.0 * LTimeMs;
+
+std::unique_ptr<ClockEstimator> ClockEstimator::create( EClockEstimator iType )
+{
+    if( iType == ECE_TWOPOINT )
+        return std::unique_ptr<ClockEstimator>( new TwoPointEstimator() );
+    return std::unique_ptr<ClockEstimator>( new RegressionEstimator() );
+}
+
+TwoPointEstimator::TwoPointEstimator()
+{
+    reset();
+}
+
+void TwoPointEstimator::reset()
+{
+    _cSamples = 0;
+}
+
+ClockEstimator::ESample TwoPointEstimator::addSample( const TimePoint& t )
+{
+    if( _cSamples > 0 && t.xtime <= _rgt[ 1 ].xtime )
+        return ES_STALE; // only update if times are valid
+    _rgt[ 0 ] = _rgt[ 1 ];
+    _rgt[ 1 ] = t;
+    if( _cSamples < 2 )
+        ++_cSamples;
+    return ES_ACCEPTED;
+}
+
+bool TwoPointEstimator::getEstimate( Estimate& grEstimate ) const
+{
+    if( _cSamples < 2 )
+        return false;
+    TimeModel grModel;
+    grModel.setSlope( _rgt[ 1 ].ltime - _rgt[ 0 ].ltime, _rgt[ 1 ].xtime - _rgt[ 0 ].xtime );
+    grEstimate.lSlope = grModel.getSlopeFixed();
+    grEstimate.grAnchor = _rgt[ 1 ];
+    grEstimate.dfConfidence = 1.0;
+    return true;
+}
+
+RegressionEstimator::RegressionEstimator()
+{
+    reset();
+}
+
+void RegressionEstimator::reset()
+{
+    _iNext = 0;
+    _cSamples = 0;
+    _cAdded = 0;
+    _cRejected = 0;
+    _lSx = _lSy = _lSxx = 0;
+    _lSxy = 0;
+    _dfScale = 0;
+}
+
+ClockEstimator::ESample RegressionEstimator::addSample( const TimePoint& t )
+{
+    if( _cSamples > 0 && t.xtime <= _rgt[ ( _iNext + cWindow - 1 ) % cWindow ].xtime )
+        return ES_STALE; // time must advance within a segment
+
+    if( _cSamples >= cRejectMin )
+    {
+        double dfRes = std::fabs( static_cast<double>( residual( t ) ) );
+        if( dfRes > cRejectFloor && dfRes > dfRejectFactor * _dfScale )
+        {
+            if( ++_cRejected < cRejectMax )
+                return ES_OUTLIER;
+            // the fit does not describe the samples anymore, so start over
+            reset();
+        } else
+        {
+            _cRejected = 0;
+            _dfScale += ( dfRes - _dfScale ) / cWindow;
+        }
+    }
+
+    if( _cSamples == 0 )
+        _tRef = t;
+
+    // remove the oldest sample if the window is full
+    if( _cSamples == cWindow )
+    {
+        const TimePoint& tOld = _rgt[ _iNext ];
+        int64_t x = tOld.xtime - _tRef.xtime;
+        int64_t y = tOld.ltime - _tRef.ltime;
+        _lSx -= x;
+        _lSy -= y;
+        _lSxx -= x * x;
+        _lSxy -= static_cast<__int128>( x ) * y;
+    } else
+        ++_cSamples;
+
+    _rgt[ _iNext ] = t;
+    _iNext = ( _iNext + 1 ) % cWindow;
+
+    int64_t x = t.xtime - _tRef.xtime;
+    int64_t y = t.ltime - _tRef.ltime;
+    _lSx += x;
+    _lSy += y;
+    _lSxx += x * x;
+    _lSxy += static_cast<__int128>( x ) * y;
+
+    // keep relative values small
+    if( ++_cAdded >= cWindow )
+        rebase();
+
+    return ES_ACCEPTED;
+}
+
+bool RegressionEstimator::getEstimate( Estimate& grEstimate ) const
+{
+    if( _cSamples < 2 )
+        return false;
+
+    __int128 lDen = static_cast<__int128>( _cSamples ) * _lSxx - static_cast<__int128>( _lSx ) * _lSx;
+    if( lDen <= 0 )
+        return false;
+    __int128 lNum = static_cast<__int128>( _cSamples ) * _lSxy - static_cast<__int128>( _lSx ) * _lSy;
+    __int128 lSlope = ( ( lNum << TimeModel::cFracBits ) + lDen / 2 ) / lDen;
+    grEstimate.lSlope = lSlope < 0 ? 0 : lSlope > INT64_MAX ? INT64_MAX : static_cast<int64_t>( lSlope );
+
+    // fitted local time at the newest sample: mean(y) + slope * (x - mean(x))
+    const TimePoint& tNew = _rgt[ ( _iNext + cWindow - 1 ) % cWindow ];
+    double dfSlope = static_cast<double>( lNum ) / static_cast<double>( lDen );
+    double dfX = tNew.xtime - _tRef.xtime;
+    double dfY = ( static_cast<double>( _lSy ) + dfSlope * ( dfX * _cSamples - _lSx ) ) / _cSamples;
+    grEstimate.grAnchor = TimePoint( tNew.xtime, _tRef.ltime + static_cast<LTimePoint>( std::llround( dfY ) ) );
+
+    grEstimate.dfConfidence = ( static_cast<double>( _cSamples ) / cWindow ) *
+        ( dfResidualRef / ( dfResidualRef + _dfScale ) );
+    return true;
+}
+
+void RegressionEstimator::rebase()
+{
+    _cAdded = 0;
+    _tRef = _rgt[ ( _iNext + cWindow - _cSamples ) % cWindow ]; // oldest sample
+    _lSx = _lSy = _lSxx = 0;
+    _lSxy = 0;
+    for( int i = 0; i < _cSamples; ++i )
+    {
+        const TimePoint& t = _rgt[ ( _iNext + cWindow - _cSamples + i ) % cWindow ];
+        int64_t x = t.xtime - _tRef.xtime;
+        int64_t y = t.ltime - _tRef.ltime;
+        _lSx += x;
+        _lSy += y;
+        _lSxx += x * x;
+        _lSxy += static_cast<__int128>( x ) * y;
+    }
+}
+
+LTimePoint RegressionEstimator::residual( const TimePoint& t ) const
+{
+    Estimate grEstimate;
+    if( !getEstimate( grEstimate ) )
+        return 0;
+    TimeModel grModel;
+    grModel.setSlopeFixed( grEstimate.lSlope );
+    grModel.setIntercept( grEstimate.grAnchor );
+    return t.ltime - grModel.at( t.xtime );
+}
@@ -27,12 +27,51 @@ namespace std {
      * @return  in
      */
     std::istream& operator>>( std::istream& in, IdMapEntry& mapll );
+
+    /**
+     * @brief   Read TempoMap items from an istream
+     * @param   in
+     *              istream object to read from
+     * @param   mpdf
+     *              TempoMap entry to write (key,value) pairs to
+     * @return  in
+     */
+    std::istream& operator>>( std::istream& in, TempoMapEntry& mpdf );
 }
 
 /**
  * @brief   Parser for response file option
  * @see     http://www.boost.org/doc/libs/1_36_0/doc/html/program_options/howto.html#id3453181
  */
+bool _parseFps( const std::string& szFps, Config::EMidiTimecodeFramerate& iFPS )
+{
+    if( szFps == "none" )
+    {
+        iFPS = Config::EMTF_NONE;
+    } else
+    if( szFps == "film" )
+    {
+        iFPS = Config::EMTF_24;
+    } else
+    if( szFps == "pal" )
+    {
+        iFPS = Config::EMTF_25;
+    } else
+    if( szFps == "ntscd" )
+    {
+        iFPS = Config::EMTF_2997;
+    } else
+    if( szFps == "ntsc" )
+    {
+        iFPS = Config::EMTF_30;
+    } else
+    {
+        std::cerr << "Frame rate invalid." << std::endl;
+        return false;
+    }
+    return true;
+}
+
 std::pair<std::string, std::string> at_option_parser( std::string const& sz );
 
 namespace po = ::boost::program_options;
@@ -49,22 +88,68 @@ namespace po = ::boost::program_options;
  */
 bool _parseSongIdNotifierOptions( po::variables_map mpszgr, std::string szName, SongIdNotifier& gr );
 
+/**
+ * @brief   Helper function to parse a frame rate name
+ * @param   szFps
+ *              One of "none", "film", "pal", "ntscd", "ntsc"
+ * @param   iFPS
+ *              Reference to write the frame rate to
+ * @return  True if successful, otherwise false
+ */
+bool _parseFps( const std::string& szFps, Config::EMidiTimecodeFramerate& iFPS );
+
 Config::Config( int argc, char* argv[] ) :
     _fOk( false ),
     _fVerbose( false ),
     _grIdNotifierBegin( _mpllId ),
-    _grIdNotifierEnd( _mpllId )
+    _grIdNotifierEnd( _mpllId ),
+    _iEngine( EE_THREADED ),
+    _iRtPriority( 0 ),
+    _iClockEstimator( ClockEstimator::ECE_REGRESSION ),
+    _iLookaheadMin( 20 ),
+    _iLookaheadMax( 150 ),
+    _iMetricsInterval( 0 ),
+    _iFreewheel( 2000 ),
+    _fPredict( true ),
+    _lMidiLatency( 0 ),
+    _lAudioLatency( 0 ),
+    _fAudioLatencyAuto( false ),
+    _iWireBaud( 0 ),
+    _fRunningStatus( false ),
+    _fBeatClock( false ),
+    _iMmcDevice( -1 ),
+    _iChaseDevice( -1 ),
+    _xChaseOffset( 0 ),
+    _iMidiOut( MidiOut::EMO_PORTMIDI ),
+    _iOutput( 0 )
 {
     po::options_description grDesc( "Available options" );
     grDesc.add_options()
         ( "help,h", "Show this message and exit" )
         ( "verbose,v", "Show more detailed messages" )
-        ( "list,l", "Show available MIDI output devices and their IDs, and exit" )
+        ( "list,l", "Show available MIDI output and input devices and their IDs, and exit" )
         ( "response-file", po::value<std::string>(), "Load response file with \"@file\".\nAttention: Short options in response files must not be followed by a whitespace. However, long options are always followed by a whitespace." )
         
         ( "device,d", po::value<PmDeviceID>(&_iDevice)->default_value( Pm_GetDefaultOutputDeviceID() ), "Set the MIDI device number to use. This must be an output device. See also option \"-l\"." )
+        ( "output", po::value< std::vector<std::string> >()->composing(), "<device>[,<option>=<value>...]\nAlso send to this MIDI output device (may be given multiple times). Each output gets its own thread, so a slow or blocked interface does not delay the others. Options override the main device's settings for this output: fps, midi-latency, wire-baud, running-status (0 or 1), begin-status, end-status, begin-channel, end-channel, begin-littleendian, end-littleendian (e.g. \"3,fps=pal,midi-latency=2.5\")." )
+        ( "backend", po::value<std::string>()->default_value( "portmidi" ), "Set the MIDI output backend. One of\n \"portmidi\" (device \"-d\", messages are scheduled by PortMidi)\n \"alsa\" (ALSA sequencer port \"Xmms2MidiMaster\", messages are scheduled on a kernel timer queue)" )
+        ( "alsa-port", po::value<std::string>( &_szAlsaPort ), "Connect the ALSA sequencer backend to this port (e.g. \"20:0\" or \"VirMIDI 1-0\"). Without it, other clients have to subscribe (e.g. with aconnect)." )
         ( "xmms-path,x", po::value<std::string>( &_szXmmsPath )->default_value( std::getenv( "XMMS_PATH" ) ? : "" ), "Override the environment variable XMMS_PATH. If neither the environment variable nor this option is present, connect to XMMS2's default path." )
 
+        ( "engine,t", po::value<std::string>()->default_value( "threaded" ), "Set the threading model. One of\n \"threaded\" (XMMS2 client and MIDI output in separate threads)\n \"epoll\" (single thread multiplexing XMMS2 and MIDI timers)" )
+        ( "realtime,r", po::value<int>( &_iRtPriority )->implicit_value( 70 ), "Emit time code from a real-time thread (SCHED_FIFO) with the given priority (1-99, default 70). Memory is locked and each message is sent right at its deadline instead of being queued in PortMidi." )
+
+        ( "estimator,k", po::value<std::string>()->default_value( "regression" ), "Set how xmms2 playtime is related to local time. One of\n \"regression\" (least squares fit over the last statuses, rejects late statuses)\n \"twopoint\" (slope from the last two statuses)" )
+        ( "lookahead-min", po::value<int>( &_iLookaheadMin )->default_value( 20 ), "Set the minimum time (ms) time code is sent ahead to the MIDI device. The lookahead adapts to the observed scheduling lateness between minimum and maximum." )
+        ( "lookahead-max", po::value<int>( &_iLookaheadMax )->default_value( 150 ), "Set the maximum time (ms) time code is sent ahead to the MIDI device." )
+        ( "freewheel", po::value<int>( &_iFreewheel )->default_value( 2000 ), "Keep sending time code for this time (ms) if XMMS2 stops reporting the playtime (e.g. while the daemon is busy). When reports return, time code is resynced, if necessary with a full frame." )
+        ( "midi-latency", po::value<double>()->default_value( 0 ), "Latency (ms, fractions allowed) of the MIDI interface and the devices behind it. MIDI messages are sent earlier by this time." )
+        ( "audio-latency", po::value<std::string>()->default_value( "0" ), "Latency (ms, fractions allowed) between XMMS2's playtime and the audible audio, or \"auto\" to derive it from XMMS2's output buffer size and the format of the current song." )
+        ( "wire-baud", po::value<int>( &_iWireBaud )->default_value( 0 ), "Bit rate of the MIDI link (31250 for 5-pin DIN MIDI). Time code is given priority on the link and other messages are moved into the gaps between quarter frames. 0 (e.g. for USB devices) disables." )
+        ( "running-status", "The driver of the MIDI link omits repeated status bytes of channel messages (running status, e.g. ALSA rawmidi drivers). Only a hint for the byte budget of \"--wire-baud\", the messages are always passed on complete; do not set it if the driver does not compress. Can be set per \"--output\"." )
+        ( "drift-file", po::value<std::string>( &_szDriftFile )->default_value( std::getenv( "HOME" ) ? std::string( std::getenv( "HOME" ) ) + "/.xmms2midimaster-drift" : "" ), "File to keep the learned drift between sound card and system clock in across runs. An empty string disables it." )
+        ( "metrics", po::value<int>( &_iMetricsInterval )->default_value( 0 ), "Print metrics (lookahead, lateness, ...) to stderr every given number of seconds. 0 disables." )
+
         ( "fps,f", po::value<std::string>()->default_value( "none" ), "Set frame rate. One of \n \"film\" (24 fps)\n \"pal\" (25 fps)\n \"ntscd\" (29.97 fps)\n \"ntsc\" (30 fps)\n\"none\" disables MIDI time code" )
         
         ( "map,m", po::value< std::vector<IdMapEntry> >()->composing(), "<XMMS2 ID>:<custom ID>\nMap a XMMS2 song ID onto a custom ID emitted when a song begins or ends" )
@@ -76,6 +161,15 @@ Config::Config( int argc, char* argv[] ) :
         ( "end-channel,C", po::value<int>()->default_value( 1 ), "Set the MIDI channel to send when a song ends. Between 1 and 16.")
         ( "begin-littleendian,e", "Use little endian for song ID encoding in song begin messages." )
         ( "end-littleendian,E", "Use little endian for song ID encoding in song end messages." )
+        ( "beat-clock", "Send MIDI beat clock (24 ticks per quarter note) with start/continue/stop and song position pointer. The tempo is taken from \"--tempo\" or the medialib property \"bpm\"; songs without tempo get no clock." )
+        ( "tempo", po::value< std::vector<TempoMapEntry> >()->composing(), "<XMMS2 ID>:<BPM>\nSet the tempo of a song for the beat clock (overrides the medialib)" )
+        ( "ltc", po::value<std::string>( &_szLtcFile ), "Also render the time code as SMPTE LTC audio (48 kHz, 16 bit mono) into the given file: WAV if it ends with \".wav\", raw little endian samples otherwise, \"-\" for stdout (e.g. a pipe into an audio player; all messages go to stderr then). Requires a frame rate (\"-f\")." )
+        ( "export", po::value<std::string>( &_szExportDir ), "Render the MIDI stream of XMMS2's active playlist (song notifications, time code, MMC) into Standard MIDI Files, one per song, in the given directory and exit. Requires a frame rate (\"-f\"), the beat clock is not supported." )
+        ( "export-songs", po::value<std::string>( &_szExportSongs ), "Take the songs to export from this file (lines of \"<song id> <duration in ms>\") instead of XMMS2's playlist and medialib." )
+        ( "mmc", po::value<int>( &_iMmcDevice )->implicit_value( 0x7F ), "Send MIDI Machine Control commands (play, stop, deferred play, locate) mirroring XMMS2's playback to the given device id (0-127, default 127 = all devices). Locate requires a frame rate (\"-f\")." )
+        ( "chase", po::value<PmDeviceID>( &_iChaseDevice )->implicit_value( Pm_GetDefaultInputDeviceID() ), "Chase mode: instead of sending time code, follow MIDI time code received from the given input device (default: the default input device) by seeking, starting and pausing XMMS2." )
+        ( "chase-offset", po::value<XTimePoint>( &_xChaseOffset )->default_value( 0 ), "Time code (ms) at which the current song starts in chase mode." )
+        ( "no-prediction", "Send song end/begin messages only after XMMS2 reported the song change. By default, they are sent at the end of the current song predicted from its duration, and corrected if another song follows." )
         
         ;
 
@@ -126,6 +220,10 @@ Config::Config( int argc, char* argv[] ) :
     
     po::notify( mpszgr );
 
+    // LTC samples on stdout must not be mixed with text, which goes to stderr then
+    if( _szLtcFile == "-" )
+        std::cout.rdbuf( std::cerr.rdbuf() );
+
     // read and verify passed options
     if( mpszgr.count( "help" ) )
     {
@@ -135,10 +233,19 @@ Config::Config( int argc, char* argv[] ) :
 
     if( mpszgr.count( "verbose" ) )
         _fVerbose = true;
+
+    if( mpszgr.count( "no-prediction" ) )
+        _fPredict = false;
+
+    if( mpszgr.count( "running-status" ) )
+        _fRunningStatus = true;
+
+    if( mpszgr.count( "beat-clock" ) )
+        _fBeatClock = true;
     
     if( mpszgr.count( "list" ) )
     {
-        // print all output devices
+        // print all output devices, then the input devices for chase mode
         int cl = Pm_CountDevices();
         for( int il = 0; il < cl; ++il )
         {
@@ -150,40 +257,72 @@ Config::Config( int argc, char* argv[] ) :
                 std::cout << "[" << il << "] " << pgrInfo->name << " (" << pgrInfo->interf << ")\n";
             }
         }
+        std::cout << "input devices (\"--chase\"):\n";
+        for( int il = 0; il < cl; ++il )
+        {
+            const PmDeviceInfo* pgrInfo;
+            pgrInfo = Pm_GetDeviceInfo( il );
+
+            if( pgrInfo->input )
+            {
+                std::cout << "[" << il << "] " << pgrInfo->name << " (" << pgrInfo->interf << ")\n";
+            }
+        }
         std::cout << std::endl;
         return;
     }
 
     if( mpszgr.count( "fps" ) )
     {
-        std::string szFps = mpszgr[ "fps" ].as<std::string>();
-        if( szFps == "none" )
-        {
-            _iFPS = EMTF_NONE;
-        } else
-        if( szFps == "film" )
-        {
-            _iFPS = EMTF_24;
-        } else
-        if( szFps == "pal" )
-        {
-            _iFPS = EMTF_25;
-        } else
-        if( szFps == "ntscd" )
+        if( !_parseFps( mpszgr[ "fps" ].as<std::string>(), _iFPS ) )
+            return;
+    }
+
+    if( mpszgr.count( "backend" ) )
+    {
+        std::string szBackend = mpszgr[ "backend" ].as<std::string>();
+        if( szBackend == "portmidi" )
         {
-            _iFPS = EMTF_2997;
+            _iMidiOut = MidiOut::EMO_PORTMIDI;
         } else
-        if( szFps == "ntsc" )
+        if( szBackend == "alsa" )
         {
-            _iFPS = EMTF_30;
+#ifdef HAVE_ALSA
+            _iMidiOut = MidiOut::EMO_ALSA;
+            if( _fVerbose )
+                std::cout << "select ALSA sequencer backend" << ( _szAlsaPort.size() ? ", port " : "" )
+                          << _szAlsaPort << '\n';
+#else
+            std::cerr << "Built without ALSA sequencer support." << std::endl;
+            return;
+#endif
         } else
         {
-            std::cerr << "Frame rate invalid." << std::endl;
+            std::cerr << "Backend invalid." << std::endl;
             return;
         }
     }
 
-    // verfiy MIDI port (must be an output device)
+    // verify chase input (must be an input device)
+    if( mpszgr.count( "chase" ) )
+    {
+        const PmDeviceInfo* pgrInfo;
+        if( ( _iChaseDevice < 0 ) || ( _iChaseDevice >= Pm_CountDevices() ) ||
+                ( !( pgrInfo = Pm_GetDeviceInfo( _iChaseDevice ) )->input ) )
+        {
+            std::cerr << "No valid MIDI input device selected.\n"
+                      << "Call \"" << argv[ 0 ] << " -l\" to get a list of valid device IDs."
+                      << std::endl;
+            return;
+        }
+
+        if( _fVerbose )
+            std::cout << "chase MIDI time code from device [" << _iChaseDevice << "] "
+                      << pgrInfo->name << " (" << pgrInfo->interf << "), song start at "
+                      << _xChaseOffset << " ms\n";
+    } else
+    // verfiy MIDI port (must be an output device), unless only files are written
+    if( _szExportDir.size() == 0 && _iMidiOut == MidiOut::EMO_PORTMIDI )
     {
         const PmDeviceInfo* pgrInfo;
         if( ( _iDevice >= Pm_CountDevices() ) ||
@@ -200,6 +339,152 @@ Config::Config( int argc, char* argv[] ) :
                       << " (" << pgrInfo->interf << ")\n";
     }
 
+    if( mpszgr.count( "engine" ) )
+    {
+        std::string szEngine = mpszgr[ "engine" ].as<std::string>();
+        if( szEngine == "threaded" )
+        {
+            _iEngine = EE_THREADED;
+        } else
+        if( szEngine == "epoll" )
+        {
+            _iEngine = EE_EPOLL;
+        } else
+        {
+            std::cerr << "Engine invalid." << std::endl;
+            return;
+        }
+    }
+
+    if( mpszgr.count( "estimator" ) )
+    {
+        std::string szEstimator = mpszgr[ "estimator" ].as<std::string>();
+        if( szEstimator == "regression" )
+        {
+            _iClockEstimator = ClockEstimator::ECE_REGRESSION;
+        } else
+        if( szEstimator == "twopoint" )
+        {
+            _iClockEstimator = ClockEstimator::ECE_TWOPOINT;
+        } else
+        {
+            std::cerr << "Estimator invalid." << std::endl;
+            return;
+        }
+    }
+
+    if( _iLookaheadMin < 0 || _iLookaheadMax < _iLookaheadMin )
+    {
+        std::cerr << "Lookahead bounds invalid." << std::endl;
+        return;
+    }
+    if( _fVerbose )
+        std::cout << "select lookahead " << _iLookaheadMin << "-" << _iLookaheadMax << " ms\n";
+
+    if( _iFreewheel < 0 )
+    {
+        std::cerr << "Freewheel window invalid." << std::endl;
+        return;
+    }
+
+    if( mpszgr.count( "midi-latency" ) )
+    {
+        double dfLatency = mpszgr[ "midi-latency" ].as<double>();
+        if( dfLatency < 0 )
+        {
+            std::cerr << "MIDI latency invalid." << std::endl;
+            return;
+        }
+        _lMidiLatency = static_cast<LTimePoint>( dfLatency * LTimeMs + 0.5 );
+    }
+
+    if( mpszgr.count( "audio-latency" ) )
+    {
+        std::string szLatency = mpszgr[ "audio-latency" ].as<std::string>();
+        if( szLatency == "auto" )
+        {
+            _fAudioLatencyAuto = true;
+        } else
+        {
+            char* pchEnd;
+            double dfLatency = std::strtod( szLatency.c_str(), &pchEnd );
+            if( *pchEnd || pchEnd == szLatency.c_str() || dfLatency < 0 )
+            {
+                std::cerr << "Audio latency invalid." << std::endl;
+                return;
+            }
+            _lAudioLatency = static_cast<LTimePoint>( dfLatency * LTimeMs + 0.5 );
+        }
+    }
+    if( _fVerbose )
+    {
+        std::cout << "select MIDI latency " << _lMidiLatency / 1000 << " us, audio latency ";
+        if( _fAudioLatencyAuto )
+            std::cout << "auto\n";
+        else
+            std::cout << _lAudioLatency / 1000 << " us\n";
+    }
+
+    if( _iMmcDevice < -1 || _iMmcDevice > 0x7F )
+    {
+        std::cerr << "MMC device id must be between 0 and 127." << std::endl;
+        return;
+    }
+    if( _fVerbose && _iMmcDevice >= 0 )
+        std::cout << "select MMC device " << _iMmcDevice << "\n";
+
+    if( _szExportDir.size() > 0 )
+    {
+        if( _iFPS == EMTF_NONE )
+        {
+            std::cerr << "Export requires a frame rate." << std::endl;
+            return;
+        }
+        if( _fBeatClock )
+        {
+            std::cerr << "Beat clock cannot be exported." << std::endl;
+            return;
+        }
+        if( _fVerbose )
+            std::cout << "export into \"" << _szExportDir << "\"\n";
+    }
+
+    if( _szLtcFile.size() > 0 )
+    {
+        if( _iFPS == EMTF_NONE )
+        {
+            std::cerr << "LTC requires a frame rate." << std::endl;
+            return;
+        }
+        if( _fVerbose )
+            std::cout << "render LTC into \"" << _szLtcFile << "\"\n";
+    }
+
+    if( _iWireBaud < 0 )
+    {
+        std::cerr << "Wire bit rate invalid." << std::endl;
+        return;
+    }
+    if( _fVerbose && _iWireBaud )
+        std::cout << "select wire bit rate " << _iWireBaud << " baud\n";
+
+    if( _fVerbose && _szDriftFile.size() > 0 )
+        std::cout << "select drift file \"" << _szDriftFile << "\"\n";
+
+    if( _iMetricsInterval < 0 )
+    {
+        std::cerr << "Metrics interval invalid." << std::endl;
+        return;
+    }
+
+    if( _iRtPriority < 0 || _iRtPriority > 99 )
+    {
+        std::cerr << "Real-time priority must be between 1 and 99." << std::endl;
+        return;
+    }
+    if( _fVerbose && _iRtPriority )
+        std::cout << "select real-time priority " << _iRtPriority << '\n';
+
     // print XMMS_PATH if requested
     if( _fVerbose )
     {
@@ -218,6 +503,15 @@ Config::Config( int argc, char* argv[] ) :
             _mpllId[ igr->first ] = igr->second;
     }
 
+    // build tempo map
+    if( mpszgr.count( "tempo" ) )
+    {
+        std::vector< TempoMapEntry > rggrMpdfTempo = mpszgr[ "tempo" ].as< std::vector< TempoMapEntry > >();
+        for( std::vector< TempoMapEntry >::const_iterator igr = rggrMpdfTempo.begin(),
+                igrMax = rggrMpdfTempo.end(); igr != igrMax; ++igr )
+            _mpdfTempo[ igr->first ] = igr->second;
+    }
+
     // parse SongIdNotifiers
     if( ! ( _parseSongIdNotifierOptions( mpszgr, "begin", _grIdNotifierBegin ) &&
             _parseSongIdNotifierOptions( mpszgr, "end", _grIdNotifierEnd ) ) )
@@ -236,9 +530,154 @@ Config::Config( int argc, char* argv[] ) :
         std::cout << std::flush;
     }
 
+    // parse additional outputs, they start from the settings of the main device
+    if( mpszgr.count( "output" ) )
+    {
+        if( mpszgr.count( "chase" ) || _szExportDir.size() > 0 )
+        {
+            std::cerr << "Additional outputs cannot be used in chase or export mode." << std::endl;
+            return;
+        }
+        std::vector<std::string> rgszOutput = mpszgr[ "output" ].as< std::vector<std::string> >();
+        for( std::vector<std::string>::const_iterator isz = rgszOutput.begin(),
+                iszMax = rgszOutput.end(); isz != iszMax; ++isz )
+        {
+            if( !_parseOutput( *isz ) )
+            {
+                std::cerr << "See \"" << argv[ 0 ] << " -h\" for details." << std::endl;
+                return;
+            }
+        }
+    }
+
     _fOk = true;
 }
 
+Config Config::forOutput( size_t i ) const
+{
+    const Output& grOutput = _rggrOutput[ i ];
+
+    Config config( *this );
+    config._iDevice = grOutput.iDevice;
+    config._iMidiOut = MidiOut::EMO_PORTMIDI;
+    config._iFPS = grOutput.iFPS;
+    config._lMidiLatency = grOutput.lMidiLatency;
+    config._iWireBaud = grOutput.iWireBaud;
+    config._fRunningStatus = grOutput.fRunningStatus;
+    config._grIdNotifierBegin = grOutput.grBegin;
+    config._grIdNotifierEnd = grOutput.grEnd;
+    config._szLtcFile.clear();
+    config._szExportDir.clear();
+    config._iChaseDevice = -1;
+    config._rggrOutput.clear();
+    config._iOutput = i + 1;
+    return config;
+}
+
+bool Config::_parseOutput( const std::string& szOutput )
+{
+    if( _rggrOutput.size() + 1 >= Metrics::cMaxDevices )
+    {
+        std::cerr << "At most " << Metrics::cMaxDevices - 1 << " additional outputs supported." << std::endl;
+        return false;
+    }
+
+    // split into device and options, options are parsed like command line options
+    boost::char_separator<char> rgchSep( "," );
+    boost::tokenizer< boost::char_separator<char> > grTok( szOutput, rgchSep );
+    std::vector<std::string> rgszArgs;
+    for( boost::tokenizer< boost::char_separator<char> >::const_iterator isz = grTok.begin();
+            isz != grTok.end(); ++isz )
+        rgszArgs.push_back( rgszArgs.empty() ? *isz : "--" + *isz );
+
+    PmDeviceID iDevice;
+    try {
+        if( rgszArgs.empty() )
+            throw boost::bad_lexical_cast();
+        iDevice = boost::lexical_cast<PmDeviceID>( rgszArgs[ 0 ] );
+    }
+    catch( boost::bad_lexical_cast& )
+    {
+        std::cerr << "Output \"" << szOutput << "\" does not start with a device ID." << std::endl;
+        return false;
+    }
+    rgszArgs.erase( rgszArgs.begin() );
+
+    po::options_description grDesc;
+    grDesc.add_options()
+        ( "fps", po::value<std::string>() )
+        ( "midi-latency", po::value<double>() )
+        ( "wire-baud", po::value<int>() )
+        ( "running-status", po::value<bool>()->implicit_value( true ) )
+        ( "begin-status", po::value<std::string>() )
+        ( "end-status", po::value<std::string>() )
+        ( "begin-channel", po::value<int>() )
+        ( "end-channel", po::value<int>() )
+        ( "begin-littleendian", "" )
+        ( "end-littleendian", "" )
+        ;
+
+    po::variables_map mpszgr;
+    try {
+        po::store( po::command_line_parser( rgszArgs ).options( grDesc ).run(), mpszgr );
+    }
+    catch( po::error& e )
+    {
+        std::cerr << "Output \"" << szOutput << "\": " << e.what() << std::endl;
+        return false;
+    }
+
+    const PmDeviceInfo* pgrInfo;
+    if( ( iDevice < 0 ) || ( iDevice >= Pm_CountDevices() ) ||
+            ( !( pgrInfo = Pm_GetDeviceInfo( iDevice ) )->output ) )
+    {
+        std::cerr << "Output \"" << szOutput << "\" is no valid MIDI output device." << std::endl;
+        return false;
+    }
+
+    Output grOutput = { iDevice, _iFPS, _lMidiLatency, _iWireBaud, _fRunningStatus,
+        _grIdNotifierBegin, _grIdNotifierEnd };
+
+    if( mpszgr.count( "fps" ) && !_parseFps( mpszgr[ "fps" ].as<std::string>(), grOutput.iFPS ) )
+        return false;
+
+    if( mpszgr.count( "midi-latency" ) )
+    {
+        double dfLatency = mpszgr[ "midi-latency" ].as<double>();
+        if( dfLatency < 0 )
+        {
+            std::cerr << "MIDI latency invalid." << std::endl;
+            return false;
+        }
+        grOutput.lMidiLatency = static_cast<LTimePoint>( dfLatency * LTimeMs + 0.5 );
+    }
+
+    // the links of the outputs differ (e.g. DIN MIDI vs. USB, drivers with running status)
+    if( mpszgr.count( "wire-baud" ) )
+    {
+        grOutput.iWireBaud = mpszgr[ "wire-baud" ].as<int>();
+        if( grOutput.iWireBaud < 0 )
+        {
+            std::cerr << "Wire bit rate invalid." << std::endl;
+            return false;
+        }
+    }
+    if( mpszgr.count( "running-status" ) )
+        grOutput.fRunningStatus = mpszgr[ "running-status" ].as<bool>();
+
+    if( ! ( _parseSongIdNotifierOptions( mpszgr, "begin", grOutput.grBegin ) &&
+            _parseSongIdNotifierOptions( mpszgr, "end", grOutput.grEnd ) ) )
+        return false;
+
+    if( _fVerbose )
+        std::cout << "add output " << _rggrOutput.size() + 1 << ": MIDI device [" << iDevice << "] "
+                  << pgrInfo->name << " (" << pgrInfo->interf << "), MIDI latency "
+                  << grOutput.lMidiLatency / 1000 << " us\n";
+
+    _rggrOutput.push_back( grOutput );
+    return true;
+}
+
 std::istream& std::operator>>( std::istream& in, IdMapEntry& empll )
 {
     namespace po = ::boost::program_options;
@@ -269,6 +708,31 @@ std::istream& std::operator>>( std::istream& in, IdMapEntry& empll )
     return in;
 }
 
+std::istream& std::operator>>( std::istream& in, TempoMapEntry& empdf )
+{
+    namespace po = ::boost::program_options;
+
+    // match a single tempo entry, fractions allowed
+    boost::regex entry( "(\\d+):(\\d+(\\.\\d*)?)" );
+
+    std::string sz;
+    in >> sz;
+
+    boost::smatch grMatch;
+    if( boost::regex_match( sz, grMatch, entry ) )
+    {
+        empdf.first = boost::lexical_cast<int>( grMatch[ 1 ] );
+        empdf.second = boost::lexical_cast<double>( grMatch[ 2 ] );
+        if( empdf.second <= 0 )
+            throw po::validation_error( po::validation_error::invalid_option_value );
+    } else
+    {
+        throw po::validation_error( po::validation_error::invalid_option_value );
+    }
+
+    return in;
+}
+
 bool _parseSongIdNotifierOptions( po::variables_map mpszgr, std::string szName, SongIdNotifier& gr )
 {
     if( mpszgr.count( szName + "-status" ) )
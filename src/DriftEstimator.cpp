@@ -0,0 +1,49 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <cstdio>
+
+#include "DriftEstimator.h"
+
+/**
+ * @brief   Drifts beyond this are considered corrupt files (ppm)
+ */
+static const double dfMaxPpm = 10000;
+
+bool DriftEstimator::load( const std::string& szFile )
+{
+    std::ifstream fl( szFile.c_str() );
+    double dfPpm;
+    if( !( fl >> dfPpm ) || std::fabs( dfPpm ) > dfMaxPpm )
+        return false;
+    setPrior( dfPpm );
+    return true;
+}
+
+bool DriftEstimator::save( const std::string& szFile, double dfPpm )
+{
+    // write a new file and rename it, so a crash never leaves a truncated estimate
+    std::string szTmp = szFile + ".tmp";
+    {
+        std::ofstream fl( szTmp.c_str() );
+        fl.precision( 9 );
+        if( !( fl << dfPpm << '\n' ) )
+            return false;
+    }
+    return std::rename( szTmp.c_str(), szFile.c_str() ) == 0;
+}
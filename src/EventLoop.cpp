@@ -0,0 +1,150 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "EventLoop.h"
+#include "Clock.h"
+
+EventLoop::EventLoop( xmmsc_connection_t* conn, MidiMaster& master ) :
+    Xmms::MainloopInterface( conn ), _master( master ), _fdEpoll( -1 ), _fdTimer( -1 ),
+    _fdXmms( xmmsc_io_fd_get( conn ) )
+{
+    if( ( _fdEpoll = epoll_create1( EPOLL_CLOEXEC ) ) < 0 ||
+            ( _fdTimer = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC ) ) < 0 )
+    {
+        std::string szErr = std::strerror( errno );
+        if( _fdEpoll >= 0 )
+            close( _fdEpoll );
+        throw std::runtime_error( std::string( "Unable to create event loop: " ) + szErr );
+    }
+
+    struct epoll_event grEv;
+    std::memset( &grEv, 0, sizeof( grEv ) );
+    grEv.events = EPOLLIN;
+    grEv.data.fd = _fdTimer;
+    int iRet = epoll_ctl( _fdEpoll, EPOLL_CTL_ADD, _fdTimer, &grEv );
+    if( iRet >= 0 )
+    {
+        grEv.data.fd = _fdXmms;
+        iRet = epoll_ctl( _fdEpoll, EPOLL_CTL_ADD, _fdXmms, &grEv );
+    }
+    if( iRet < 0 )
+    {
+        std::string szErr = std::strerror( errno );
+        close( _fdTimer );
+        close( _fdEpoll );
+        throw std::runtime_error( std::string( "Unable to watch event loop descriptors: " ) + szErr );
+    }
+
+    xmmsc_io_need_out_callback_set( conn_, &EventLoop::needOut, this );
+}
+
+EventLoop::~EventLoop()
+{
+    xmmsc_io_need_out_callback_set( conn_, nullptr, nullptr );
+    close( _fdTimer );
+    close( _fdEpoll );
+}
+
+void EventLoop::run()
+{
+    running_ = true;
+    watchConnection( xmmsc_io_want_out( conn_ ) );
+
+    struct epoll_event rggrEv[ 2 ];
+    while( running_ )
+    {
+        // let the master handle statuses received by the last callbacks and schedule frames
+        _master.poll();
+        if( !armTimer() )
+            break;
+
+        int cEv = epoll_wait( _fdEpoll, rggrEv, 2, -1 );
+        if( cEv < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            break;
+        }
+
+        for( int iEv = 0; iEv < cEv; ++iEv )
+        {
+            if( rggrEv[ iEv ].data.fd == _fdTimer )
+            {
+                uint64_t cExpired;
+                while( read( _fdTimer, &cExpired, sizeof( cExpired ) ) > 0 );
+                continue;
+            }
+
+            if( ( rggrEv[ iEv ].events & EPOLLOUT ) && xmmsc_io_want_out( conn_ ) )
+                xmmsc_io_out_handle( conn_ );
+            if( rggrEv[ iEv ].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) )
+                if( !xmmsc_io_in_handle( conn_ ) )
+                    running_ = false; // disconnected
+        }
+    }
+    running_ = false;
+}
+
+void EventLoop::needOut( int fNeedOut, void* pv )
+{
+    static_cast<EventLoop*>( pv )->watchConnection( fNeedOut );
+}
+
+void EventLoop::watchConnection( bool fOut )
+{
+    struct epoll_event grEv;
+    std::memset( &grEv, 0, sizeof( grEv ) );
+    grEv.events = fOut ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    grEv.data.fd = _fdXmms;
+    if( epoll_ctl( _fdEpoll, EPOLL_CTL_MOD, _fdXmms, &grEv ) < 0 )
+    {
+        // called back from the XMMS2 client library, so we cannot throw here
+        std::cerr << "Unable to watch XMMS2 connection: " << std::strerror( errno ) << std::endl;
+        running_ = false;
+    }
+}
+
+bool EventLoop::armTimer()
+{
+    struct itimerspec grTimer;
+    std::memset( &grTimer, 0, sizeof( grTimer ) );
+
+    LTimePoint lWakeup;
+    if( _master.nextWakeup( lWakeup ) )
+    {
+        grTimer.it_value = Clock::toMonotonic( lWakeup );
+        if( grTimer.it_value.tv_sec == 0 && grTimer.it_value.tv_nsec == 0 )
+            grTimer.it_value.tv_nsec = 1; // zero would disarm the timer
+    }
+    if( timerfd_settime( _fdTimer, TFD_TIMER_ABSTIME, &grTimer, nullptr ) < 0 )
+    {
+        std::cerr << "Unable to arm MIDI timer: " << std::strerror( errno ) << std::endl;
+        return false;
+    }
+    return true;
+}
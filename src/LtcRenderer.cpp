@@ -0,0 +1,91 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "LtcRenderer.h"
+
+/**
+ * @brief   Samples of one vector store (GCC vector extension, compiled to SIMD stores)
+ */
+typedef int16_t Lanes __attribute__(( vector_size( LtcRenderer::cLanes * sizeof( int16_t ) ) ));
+
+LtcRenderer::LtcRenderer( MidiByte bRate, int16_t sAmplitude ) :
+    _pgrRate( MtcEncoder::create( bRate ) ), _iPolarityBit( 27 ), _fDrop( false ),
+    _sAmplitude( sAmplitude )
+{
+    if( _pgrRate->rateBits() == FrameRate25::bRate )
+        _iPolarityBit = 59;
+    _fDrop = _pgrRate->rateBits() == FrameRate2997::bRate;
+    reset();
+}
+
+void LtcRenderer::reset()
+{
+    _cFrames = 0;
+    _fHigh = false;
+}
+
+uint64_t LtcRenderer::encode( const BSDTime& grBSD ) const
+{
+    int iHour = grBSD.hour & 0x1F;
+    uint64_t lBits = 0;
+    lBits |= static_cast<uint64_t>( grBSD.frame % 10 ) << 0;
+    lBits |= static_cast<uint64_t>( grBSD.frame / 10 ) << 8;
+    if( _fDrop )
+        lBits |= static_cast<uint64_t>( 1 ) << 10;
+    lBits |= static_cast<uint64_t>( grBSD.second % 10 ) << 16;
+    lBits |= static_cast<uint64_t>( grBSD.second / 10 ) << 24;
+    lBits |= static_cast<uint64_t>( grBSD.minute % 10 ) << 32;
+    lBits |= static_cast<uint64_t>( grBSD.minute / 10 ) << 40;
+    lBits |= static_cast<uint64_t>( iHour % 10 ) << 48;
+    lBits |= static_cast<uint64_t>( iHour / 10 ) << 56;
+    // even number of 1 bits including the sync word
+    if( ( __builtin_popcountll( lBits ) + __builtin_popcount( wSync ) ) & 1 )
+        lBits |= static_cast<uint64_t>( 1 ) << _iPolarityBit;
+    return lBits;
+}
+
+int LtcRenderer::nextFrameSamples() const
+{
+    // frame starts are exact to 1 us, so rounding gives the exact sample (29.97 fps: n * 1601.6)
+    int64_t lStart = ( _pgrRate->frameStartUs( _cFrames ) * cSampleRate + 500000 ) / 1000000;
+    int64_t lEnd = ( _pgrRate->frameStartUs( _cFrames + 1 ) * cSampleRate + 500000 ) / 1000000;
+    return static_cast<int>( lEnd - lStart );
+}
+
+int LtcRenderer::render( const BSDTime& grBSD, int16_t* rgs )
+{
+    int cSamples = nextFrameSamples();
+    uint64_t lBits = encode( grBSD );
+    Lanes vHigh = Lanes() + _sAmplitude;
+    Lanes vLow = Lanes() - _sAmplitude;
+
+    // half bit k starts at sample k * cSamples / (2 * cBits)
+    int iHalf = 0;
+    for( int iBit = 0; iBit < cBits; ++iBit, iHalf += 2 )
+    {
+        bool fOne = iBit < 64 ? ( lBits >> iBit ) & 1 : ( wSync >> ( iBit - 64 ) ) & 1;
+        _fHigh = !_fHigh;
+        std::memcpy( rgs + iHalf * cSamples / ( 2 * cBits ), _fHigh ? &vHigh : &vLow, sizeof( Lanes ) );
+        if( fOne )
+            _fHigh = !_fHigh;
+        std::memcpy( rgs + ( iHalf + 1 ) * cSamples / ( 2 * cBits ), _fHigh ? &vHigh : &vLow, sizeof( Lanes ) );
+    }
+    ++_cFrames;
+    return cSamples;
+}
@@ -0,0 +1,171 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+
+#include "LtcSink.h"
+
+/**
+ * @brief   Size of the WAV header
+ */
+static const long cbWavHeader = 44;
+
+LtcSink::LtcSink( const std::string& szPath, MidiByte bRate ) :
+    _pfOut( 0 ), _fWav( false ), _grRenderer( bRate ), _lOrigin( LTimePointInvalid ),
+    _cSamples( 0 ), _rgsRing( new int16_t[ cRing ] ), _iHead( 0 ), _iTail( 0 ), _cDropped( 0 ),
+    _cGap( 0 ), _fStop( false ), _cWritten( 0 )
+{
+    if( szPath == "-" )
+        _pfOut = stdout;
+    else
+    {
+        _pfOut = std::fopen( szPath.c_str(), "wb" );
+        if( !_pfOut )
+            throw std::runtime_error( std::string( "Unable to open LTC output file: " ) + std::strerror( errno ) );
+        _fWav = szPath.size() > 4 && szPath.compare( szPath.size() - 4, 4, ".wav" ) == 0;
+        if( _fWav )
+            writeHeader(); // completed by the destructor
+    }
+    _thWriter = std::thread( &LtcSink::drain, this );
+}
+
+LtcSink::~LtcSink()
+{
+    _fStop.store( true );
+    _thWriter.join();
+    if( _fWav && std::fseek( _pfOut, 0, SEEK_SET ) == 0 )
+        writeHeader();
+    if( _pfOut == stdout )
+        std::fflush( _pfOut );
+    else
+        std::fclose( _pfOut );
+}
+
+void LtcSink::frame( const BSDTime& grBSD, LTimePoint lStart )
+{
+    if( _lOrigin == LTimePointInvalid )
+        _lOrigin = lStart;
+    int64_t iSample = sampleAt( lStart );
+    if( iSample > _cSamples )
+    {
+        // the stream continues after a gap
+        silenceUntil( lStart );
+        _grRenderer.reset();
+    }
+    write( _rgs, _grRenderer.render( grBSD, _rgs ) );
+}
+
+void LtcSink::silenceUntil( LTimePoint lTime )
+{
+    if( _lOrigin == LTimePointInvalid )
+        return;
+    int64_t c = sampleAt( lTime ) - _cSamples;
+    if( c <= 0 )
+        return;
+    std::memset( _rgs, 0, sizeof( _rgs ) );
+    while( c > 0 )
+    {
+        int cBlock = c < cSilence ? static_cast<int>( c ) : cSilence;
+        if( cBlock > LtcRenderer::cMaxFrameSamples )
+            cBlock = LtcRenderer::cMaxFrameSamples;
+        write( _rgs, cBlock );
+        c -= cBlock;
+    }
+}
+
+int64_t LtcSink::sampleAt( LTimePoint lTime ) const
+{
+    return static_cast<int64_t>( static_cast<__int128>( lTime - _lOrigin ) * LtcRenderer::cSampleRate /
+            ( 1000 * LTimeMs ) );
+}
+
+void LtcSink::write( int16_t* rgs, int c )
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for( int i = 0; i < c; ++i )
+        rgs[ i ] = static_cast<int16_t>( __builtin_bswap16( static_cast<uint16_t>( rgs[ i ] ) ) );
+#endif
+    _cSamples += c;
+
+    // dropped samples are made up for by silence first, so later samples keep their time
+    uint64_t iHead = _iHead.load( std::memory_order_relaxed );
+    uint64_t cFree = cRing - ( iHead - _iTail.load( std::memory_order_acquire ) );
+    uint64_t cSilence = std::min<uint64_t>( _cGap, cFree );
+    for( uint64_t i = 0; i < cSilence; ++i )
+        _rgsRing[ ( iHead + i ) % cRing ] = 0;
+    iHead += cSilence;
+    cFree -= cSilence;
+    _cGap -= cSilence;
+
+    // a block that does not fit is dropped as a whole
+    if( _cGap > 0 || static_cast<uint64_t>( c ) > cFree )
+    {
+        _cGap += c;
+        _cDropped.fetch_add( c, std::memory_order_relaxed );
+    } else
+    {
+        for( int i = 0; i < c; ++i )
+            _rgsRing[ ( iHead + i ) % cRing ] = rgs[ i ];
+        iHead += c;
+    }
+    _iHead.store( iHead, std::memory_order_release );
+}
+
+void LtcSink::drain()
+{
+    uint64_t iTail = _iTail.load( std::memory_order_relaxed );
+    while( 1 )
+    {
+        // the stop flag is read first, so all samples written before it are seen
+        bool fStop = _fStop.load();
+        uint64_t iHead = _iHead.load( std::memory_order_acquire );
+        if( iHead == iTail )
+        {
+            if( fStop )
+                break;
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+            continue;
+        }
+        // write up to the end of the ring at once
+        uint64_t c = std::min<uint64_t>( iHead - iTail, cRing - iTail % cRing );
+        std::fwrite( &_rgsRing[ iTail % cRing ], sizeof( int16_t ), c, _pfOut );
+        _cWritten += c;
+        iTail += c;
+        _iTail.store( iTail, std::memory_order_release );
+    }
+}
+
+void LtcSink::writeHeader()
+{
+    // RIFF size fields are 32 bits
+    uint32_t cbData = static_cast<uint32_t>( _cWritten * 2 > 0xFFFFFFFF - cbWavHeader ?
+            0xFFFFFFFF - cbWavHeader : _cWritten * 2 );
+    uint32_t rgl[] = { static_cast<uint32_t>( cbData + cbWavHeader - 8 ), 16, 1 | ( 1 << 16 ), LtcRenderer::cSampleRate,
+        LtcRenderer::cSampleRate * 2, 2 | ( 16 << 16 ), cbData };
+    MidiByte rgb[ cbWavHeader ];
+    std::memcpy( rgb, "RIFF", 4 );
+    std::memcpy( rgb + 8, "WAVEfmt ", 8 );
+    std::memcpy( rgb + 36, "data", 4 );
+    int rgiOffset[] = { 4, 16, 20, 24, 28, 32, 40 };
+    for( int i = 0; i < 7; ++i )
+        for( int iByte = 0; iByte < 4; ++iByte )
+            rgb[ rgiOffset[ i ] + iByte ] = ( rgl[ i ] >> ( 8 * iByte ) ) & 0xFF;
+    std::fwrite( rgb, 1, cbWavHeader, _pfOut );
+}
@@ -0,0 +1,48 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Metrics.h"
+
+/**
+ * @brief   Names of the metrics, indexed by Metrics::EMetric
+ */
+static const char* const rgszName[ Metrics::EM_COUNT ] =
+{
+    "lookahead_ns",
+    "lateness_peak_ns",
+    "underruns",
+    "freewheels",
+    "freewheel_holds",
+    "relocates",
+    "drift_ppb",
+    "drift_span_ms",
+    "write_errors",
+    "wire_late",
+    "wire_deferred",
+    "wire_delay_peak_us",
+    "queue_depth",
+    "status_drops",
+    "pending_full",
+    "ltc_drops",
+};
+
+void Metrics::dump( std::ostream& os ) const
+{
+    for( int i = 0; i < EM_COUNT; ++i )
+        os << ( i ? " " : "" ) << rgszName[ i ] << '=' << value( static_cast<EMetric>( i ) );
+    os << std::endl;
+}
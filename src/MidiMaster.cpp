@@ -15,42 +15,65 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdlib>
+#include <algorithm>
+
 #include "MidiMaster.h"
+#include "RealTime.h"
+#include "Metrics.h"
+
+
+/**
+ * @brief   Margin to stop waiting for statuses before a deadline in real-time mode.
+ *          The remaining time is slept with an absolute timer.
+ */
+static const LTimePoint cWakeMargin = LTimeMs;
 
+/**
+ * @brief   Minimum time without statuses after which the master is freewheeling
+ */
+static const LTimePoint cStallMin = 250 * LTimeMs;
 
-MidiMaster::MidiMaster( const Config& config, Exchange<Status>& ex ) :
-    _config( config ), _grStatusExchange( ex )
+/**
+ * @brief   Playtime beyond the duration of a song after which a predicted song change is
+ *          considered wrong (xmms2 time)
+ */
+static const XTimePoint cPredictTolerance = 1000;
+
+MidiMaster::MidiMaster( const Config& config, StatusExchange& ex, const MidiMaster* pgrDriftSource ) :
+    _config( config ), _grMetrics( Metrics::get( config.getOutputIndex() ) ), _grStatusExchange( ex ),
+    _fRealTime( config.getRealtimePriority() > 0 ), _iPendingHead( 0 ), _iPendingTail( 0 ),
+    _grWire( config.getWireBaud(), config.useRunningStatus() ),
+    _grLookahead( config.getLookaheadMin() * LTimeMs, config.getLookaheadMax() * LTimeMs ),
+    _lPlannedEnqueue( 0 ), _fObserveLateness( false ),
+    _lFreewheel( config.getFreewheel() * LTimeMs ), _lLastStatus( 0 ), _lStatusInterval( cStallMin / 3 ),
+    _fFreewheel( false ), _fHold( false ), _ilAnnouncedId( XSongIdInvalid ),
+    _lMidiLatency( config.getMidiLatency() ), _fClock( false ),
+    _pgrEstimator( ClockEstimator::create( config.getClockEstimator() ) ),
+    _pgrDriftSource( pgrDriftSource ), _lDriftSlope( 0 )
 {
     _cStatusValid = 0;
     
-    _cScheduleTime = 150;
-    
-    if( config.getFPS() == Config::EMTF_NONE )
-    {
-        _FPS = 0;
-        _bFPS = 0;
-    } else
-    if( config.getFPS() == Config::EMTF_25 )
-    {
-        _FPS = 25;
-        _bFPS = 0x20;
-    }
-    else
-        throw std::runtime_error( std::string( "Sorry, only 25 FPS supported yet." ) );
-
-    if( _FPS )
-        _QXTimeT = ( 1000 / _FPS ) / 4;
+    if( config.getRateBits() >= 0 )
+        _pgrMtc = MtcEncoder::create( config.getRateBits() );
+    if( _pgrMtc && config.getLtcFile().size() > 0 )
+        _pgrLtc.reset( new LtcSink( config.getLtcFile(), _pgrMtc->rateBits() ) );
     _cFrame = 0;
     _lTimepoint = 0;
     
-    // start PortMidi
-    PmError iErr;
-    if( ( iErr = Pm_OpenOutput( &_hMidiOut, config.getMidiDevice(), 0, 100, 0, 0, 1 ) ) != pmNoError )
-        throw std::runtime_error( std::string( "Unable to open midi device: " ) + Pm_GetErrorText( iErr ) );
+    // open the output, in real-time mode messages are written at their deadline
+    _pgrOut = MidiOut::create( config.getMidiOut(), config.getMidiDevice(), config.getAlsaPort(), _fRealTime );
 
-    _lTimeInt_dL = 1;
-    _lTimeInt_dX = 1;
-    _lTimeInt_n = Now();
+    // start with the drift of the last run or real time speed (default slope)
+    if( !_pgrDriftSource && config.getDriftFile().size() > 0 && _grDrift.load( config.getDriftFile() ) )
+    {
+        if( config.beVerbose() )
+            std::cout << "loaded drift " << _grDrift.getPpm() << " ppm" << std::endl;
+        _lDriftSlope.store( _grDrift.getSlopeFixed(), std::memory_order_relaxed );
+    }
+    if( driftSlope() != 0 )
+        _grTimeModel.setSlopeFixed( driftSlope() );
+    _grTimeModel.setIntercept( TimePoint( 0, Now() ) );
 
     _iNextTimeSlot = Now();
 
@@ -60,103 +83,260 @@ void MidiMaster::run()
 {
     while( 1 )
     {
-        // read status packets
-        _grStatusOld = std::move( _grStatusNew );
-        _grStatusNew = _grStatusExchange.read();
-        _cStatusValid++;
-
-        // detect state transistion 
-        const Status::EPlaybackStatus& iStateOld = _grStatusOld.getPlaybackStatus(),
-            iStateNew = _grStatusNew.getPlaybackStatus();
-
-        if( iStateOld == Status::EPS_INVALID &&
-                ( iStateNew == Status::EPS_PLAYING || iStateNew == Status::EPS_PAUSED ) )
-        { // init
-            if( _config.beVerbose() )
-                std::cout << "send init" << std::endl;
-            
-            songStart();
-            updateTimeYIntercept();
-            // enqueueFrames();
-        } else
-        if( iStateOld == Status::EPS_PLAYING &&
-                iStateNew == Status::EPS_PAUSED )
-        { // play -> pause
+        Status grStatus;
+        LTimePoint lWakeup;
+        if( !nextWakeup( lWakeup ) )
+            // nothing to schedule, so wait for the next status
+            processStatus( _grStatusExchange.read() );
+        else
+        {
+            LTimePoint lWait = _fRealTime ? lWakeup - cWakeMargin : lWakeup;
+            std::chrono::steady_clock::time_point tWakeup = std::chrono::steady_clock::now() +
+                std::chrono::nanoseconds( lWait - Now() );
+            if( _grStatusExchange.readUntil( grStatus, tWakeup ) )
+                processStatus( grStatus );
+            else if( _fRealTime )
+                RealTime::sleepUntil( lWakeup ); // precise wakeup for the deadline
+        }
+
+        service();
+    }
+}
 
+void MidiMaster::poll()
+{
+    Status grStatus;
+    while( _grStatusExchange.readUntil( grStatus, std::chrono::steady_clock::time_point() ) )
+        processStatus( grStatus );
+    service();
+}
+
+bool MidiMaster::nextWakeup( LTimePoint& lTime )
+{
+    bool fWakeup = nextEnqueueTime( lTime );
+    if( _iPendingTail != _iPendingHead &&
+            ( !fWakeup || _rgPending[ _iPendingTail % cPending ].when < lTime ) )
+    {
+        lTime = _rgPending[ _iPendingTail % cPending ].when;
+        fWakeup = true;
+    }
+    return fWakeup;
+}
+
+void MidiMaster::service()
+{
+    // enqueue Q-frames if neccessary
+    if( _grStatusNew.getPlaybackStatus() == Status::EPS_PLAYING && !_fHold )
+    {
+        enqueueFrames();
+        if( !_pgrMtc )
+        {
+            // write a sixteenth note of ticks per wakeup
+            LTimePoint lHorizon = Now() + _grLookahead.get();
+            if( _fClock && freewheel( lHorizon ) )
+                enqueueClock( lHorizon + clockTime( _grBeatClock.tick() + BeatClock::cTicksPerSixteenth ) -
+                        clockTime( _grBeatClock.tick() ) );
+            predictSongChange( lHorizon );
+        }
+    }
+    if( _fRealTime )
+        emitPending();
+    checkWrite( _pgrOut->flush() );
+    if( _pgrLtc )
+    {
+        _pgrLtc->silenceUntil( Now() ); // keep the LTC stream going while no frames are sent
+        _grMetrics.set( Metrics::EM_LTC_DROPS, _pgrLtc->getDropped() );
+    }
+
+    _grMetrics.set( Metrics::EM_QUEUE_DEPTH, ( _iPendingHead - _iPendingTail ) + _grWire.deferred() );
+    _grMetrics.set( Metrics::EM_STATUS_DROPS, _grStatusExchange.getDropped() );
+}
+
+void MidiMaster::processStatus( const Status& grStatus )
+{
+    // read status packets
+    _grStatusOld = std::move( _grStatusNew );
+    _grStatusNew = grStatus;
+    _cStatusValid++;
+
+    // learn how often XMMS2 reports the playtime to detect dropouts; the time stamps are
+    // taken on reception, statuses drained together after a late wakeup would look too close
+    const TimePoint& tStatus = _grStatusNew.getTime();
+    if( _grStatusOld.getPlaybackStatus() == Status::EPS_PLAYING &&
+            _grStatusNew.getPlaybackStatus() == Status::EPS_PLAYING && !_fFreewheel &&
+            !( tStatus == TimePointInvalid ) && !( _grStatusOld.getTime() == TimePointInvalid ) )
+        _lStatusInterval += ( tStatus.ltime - _grStatusOld.getTime().ltime - _lStatusInterval ) / 8;
+    _lLastStatus = Now();
+
+    // detect state transistion
+    const Status::EPlaybackStatus& iStateOld = _grStatusOld.getPlaybackStatus(),
+        iStateNew = _grStatusNew.getPlaybackStatus();
+
+    if( iStateOld == Status::EPS_INVALID &&
+            ( iStateNew == Status::EPS_PLAYING || iStateNew == Status::EPS_PAUSED ) )
+    { // init
+        if( _config.beVerbose() )
+            std::cout << "send init" << std::endl;
+
+        songStart();
+        updateTimeYIntercept();
+    } else
+    if( iStateOld == Status::EPS_PLAYING &&
+            iStateNew == Status::EPS_PAUSED )
+    { // play -> pause
+        stopClock();
+        sendMmc( Mmc::EMMC_STOP, _iNextTimeSlot );
+        _grWire.endStream();
+        drainWire();
+    } else
+    if( iStateOld == Status::EPS_PAUSED &&
+            iStateNew == Status::EPS_PLAYING )
+    { // pause -> play
+        updateTimeYIntercept(); // xmms2 time was paused
+        sendMmcLocate( frameNrAt( _grStatusNew.getTime().xtime ), _iNextTimeSlot );
+        locateClock( _grStatusNew.getTime().xtime );
+    } else
+    if( ( iStateOld == Status::EPS_PLAYING || iStateOld == Status::EPS_PAUSED ) &&
+            iStateNew == Status::EPS_STOPPED )
+    { // play/pause -> stop
+        if( _config.beVerbose() )
+            std::cout << "play->stop" << std::endl;
+        stopClock();
+        _grWire.endStream();
+        drainWire();
+        announce( XSongIdInvalid, _iNextTimeSlot );
+        _cFrame = 0;
+        _cStatusValid = 0;
+        sendAbs( 0 );
+        sendMmc( Mmc::EMMC_STOP, _iNextTimeSlot );
+        sendMmcLocate( 0, _iNextTimeSlot, false );
+    } else
+    if( iStateOld == Status::EPS_STOPPED &&
+            iStateNew == Status::EPS_PLAYING )
+    { // stop -> play
+        if( _config.beVerbose() )
+            std::cout << "stop->play" << std::endl;
+        songStart();
+        updateTimeYIntercept(); // xmms2 was paused
+        _cStatusValid = 1;
+    } else
+    if( iStateNew == Status::EPS_PLAYING )
+    { // playing
+        int cFrame;
+        // song id changed?
+        if( _grStatusNew.getSongId() != _grStatusOld.getSongId() )
+        {
+            songStart(); // confirms or corrects a prediction
+            updateTimeYIntercept();
         } else
-        if( iStateOld == Status::EPS_PAUSED &&
-                iStateNew == Status::EPS_PLAYING )
-        { // pause -> play
-            updateTimeYIntercept(); // xmms2 time was paused
+        if( _fFreewheel && endFreewheel() )
+        { // relocated
         } else
-        if( ( iStateOld == Status::EPS_PLAYING || iStateOld == Status::EPS_PAUSED ) &&
-                iStateNew == Status::EPS_STOPPED )
-        { // play/pause -> stop
+        if( _ilAnnouncedId != XSongIdInvalid && _ilAnnouncedId != _grStatusNew.getSongId() )
+        { // predicted song change pending: the time code already follows the next song
+            if( _grStatusNew.getDuration() == XTimePointInvalid ||
+                    _grStatusNew.getTime().xtime <= _grStatusNew.getDuration() + cPredictTolerance )
+                return; // statuses of this song must not move the time model back
+            // the song is longer than its duration said: back to it
             if( _config.beVerbose() )
-                std::cout << "play->stop" << std::endl;
-            sendStopId( _grStatusOld.getSongId() );
-            _cFrame = 0;
-            _cStatusValid = 0;
-            sendAbs( 0 );
+                std::cout << "Predicted song change did not happen" << std::endl;
+            announce( _grStatusNew.getSongId(), _iNextTimeSlot );
+            _cFrame = frameNrAt( _grStatusNew.getTime().xtime );
+            sendAbs( _cFrame );
+            updateTimeYIntercept();
+            sendMmcLocate( _cFrame, _iNextTimeSlot );
+            locateClock( _grStatusNew.getTime().xtime );
+            _cStatusValid = 1;
         } else
-        if( iStateOld == Status::EPS_STOPPED &&
-                iStateNew == Status::EPS_PLAYING )
-        { // stop -> play
+        if( ( cFrame = frameNrAt( _grStatusNew.getTime().xtime ) ) > _cFrame ||
+                cFrame < frameNrAt( _grStatusOld.getTime().xtime ) ) // jump detection
+        {
             if( _config.beVerbose() )
-                std::cout << "stop->play" << std::endl;
-            songStart();
-            updateTimeYIntercept(); // xmms2 was paused
-            enqueueFrames();
-            _cStatusValid = 1;
+                std::cout << "Jump detected: " << _cFrame << "->" << cFrame << std::endl;
+            sendAbs( cFrame );
+            _cFrame = cFrame;
+            updateTimeYIntercept();
+            sendMmcLocate( cFrame, _iNextTimeSlot );
+            locateClock( _grStatusNew.getTime().xtime );
+            _cStatusValid = 1; // first valid package after jump received
+            // a predicted song change did not happen (e.g. seek back)
+            announce( _grStatusNew.getSongId(), _iNextTimeSlot );
         } else
-        if( iStateNew == Status::EPS_PLAYING )
-        { // playing
-            int cFrame;
-            // song id changed?
-            if( _grStatusNew.getSongId() != _grStatusOld.getSongId() )
-            {
-                sendStopId( _grStatusOld.getSongId() );
-                songStart();
-                updateTimeYIntercept();
-            } else
-            if( ( cFrame = frameNrAt( _grStatusNew.getTime().xtime ) ) > _cFrame ||
-                    cFrame < frameNrAt( _grStatusOld.getTime().xtime ) ) // jump detection
-            {
-                if( _config.beVerbose() )
-                    std::cout << "Jump detected: " << _cFrame << "->" << cFrame << std::endl;
-                sendAbs( cFrame );
-                _cFrame = cFrame;
-                updateTimeYIntercept();
-                _cStatusValid = 1; // first valid package after jump received
-            }
-
-            // update time extrapolation if enough valid packages have arrived
-            if( _cStatusValid > 1 )
-                updateTimeInt();
-            
-            // enqueue Q-frames if neccessary
-            enqueueFrames();
+        if( _config.sendBeatClock() && tempo() != _grBeatClock.getTempo() )
+        { // the tempo became known from the medialib
+            locateClock( _grStatusNew.getTime().xtime );
         }
+
+        // update time extrapolation if enough valid packages have arrived
+        if( _cStatusValid > 1 )
+            updateTimeInt();
     }
+}
 
+bool MidiMaster::nextEnqueueTime( LTimePoint& lTime )
+{
+    if( _grStatusNew.getPlaybackStatus() != Status::EPS_PLAYING || _fHold )
+        return false;
+    if( !_pgrMtc )
+    {
+        // no time code, but the beat clock may tick or a song change may have to be predicted
+        LTimePoint lPredict;
+        bool fWakeup = _fClock;
+        if( _fClock )
+            lTime = clockTime( _grBeatClock.tick() );
+        if( predictionTime( lPredict ) && ( !fWakeup || lPredict < lTime ) )
+        {
+            lTime = lPredict;
+            fWakeup = true;
+        }
+        lTime -= _grLookahead.get();
+        return fWakeup;
+    }
+    // start time of the next frame to enqueue minus the schedule time
+    lTime = outputTimeUs( _pgrMtc->frameStartUs( _cFrame ) ) - _grLookahead.get();
+    _lPlannedEnqueue = lTime;
+    return true;
 }
  
 void MidiMaster::updateTimeInt()
 {
-    const TimePoint& t1 = _grStatusOld.getTime();
     const TimePoint& t2 = _grStatusNew.getTime();
+    if( t2 == TimePointInvalid )
+        return;
 
-    if( t1 == TimePointInvalid && t2 == TimePointInvalid )
+    ClockEstimator::ESample iSample = _pgrEstimator->addSample( t2 );
+    if( iSample != ClockEstimator::ES_ACCEPTED )
+    {
+        // repeated statuses (e.g. around a song change) are expected, outliers are worth a note
+        if( _config.beVerbose() && iSample == ClockEstimator::ES_OUTLIER )
+            std::cout << "Status time rejected as outlier" << std::endl;
         return;
+    }
 
-    // only update if times a valid
-    if( t2.xtime <= t1.xtime )
+    ClockEstimator::Estimate grEstimate;
+    if( !_pgrEstimator->getEstimate( grEstimate ) )
         return;
+    if( !_pgrDriftSource )
+    {
+        _grDrift.update( grEstimate.grAnchor );
+        _lDriftSlope.store( _grDrift.isValid() ? _grDrift.getSlopeFixed() : 0, std::memory_order_relaxed );
+        _grMetrics.set( Metrics::EM_DRIFT_PPB, static_cast<int64_t>( _grDrift.getPpm() * 1000 ) );
+        _grMetrics.set( Metrics::EM_DRIFT_SPAN, _grDrift.getSpan() );
+    }
 
-    _lTimeInt_dL = t2.ltime - t1.ltime;
-    _lTimeInt_dX = t2.xtime - t1.xtime;
+    int64_t lSlope = grEstimate.lSlope;
+    int64_t lDriftSlope = driftSlope();
+    if( lDriftSlope != 0 )
+        // trust the segment's own estimate as far as it is certain
+        lSlope = static_cast<int64_t>( grEstimate.dfConfidence * lSlope +
+                ( 1 - grEstimate.dfConfidence ) * lDriftSlope );
+    _grTimeModel.setSlopeFixed( lSlope );
+    _grTimeModel.setIntercept( grEstimate.grAnchor );
+}
 
-    updateTimeYIntercept();
+int64_t MidiMaster::driftSlope() const
+{
+    return _pgrDriftSource ? _pgrDriftSource->getDriftSlope() : _lDriftSlope.load( std::memory_order_relaxed );
 }
 
 void MidiMaster::updateTimeYIntercept()
@@ -164,86 +344,178 @@ void MidiMaster::updateTimeYIntercept()
     const TimePoint& t2 = _grStatusNew.getTime();
     if( t2 == TimePointInvalid )
         return;
+    // the new segment starts with the long-term rate
+    int64_t lDriftSlope = driftSlope();
+    if( lDriftSlope != 0 )
+        _grTimeModel.setSlopeFixed( lDriftSlope );
+    if( !_pgrDriftSource )
+        _grDrift.beginSegment( t2 );
     // n = localtime + m * (-xmms2time)
-    _lTimeInt_n = t2.ltime - ( _lTimeInt_dL * t2.xtime + _lTimeInt_dX / 2 ) / _lTimeInt_dX;
+    _grTimeModel.setIntercept( t2 );
+    // the next enqueuing is not a planned wakeup
+    _fObserveLateness = false;
+    // the new segment is backed by a status
+    _fFreewheel = false;
+    _fHold = false;
+
+    // samples before the discontinuity do not belong to the new segment
+    _pgrEstimator->reset();
+    _pgrEstimator->addSample( t2 );
 }
 
 
 
 LTimePoint MidiMaster::timeInt( XTimePoint xtime )
 {
-    return _lTimeInt_n + ( _lTimeInt_dL * xtime + _lTimeInt_dX / 2 ) / _lTimeInt_dX;
+    return _grTimeModel.at( xtime );
+}
+
+LTimePoint MidiMaster::outputTime( XTimePoint xtime )
+{
+    return _grTimeModel.at( xtime ) - _lMidiLatency;
+}
+
+LTimePoint MidiMaster::outputTimeUs( int64_t xtimeUs )
+{
+    return _grTimeModel.atMicro( xtimeUs ) - _lMidiLatency;
 }
 
 int MidiMaster::frameNrAt( XTimePoint xtime )
 {
-    return ( xtime * _FPS ) / 1000; // xtime is in milliseconds
+    if( !_pgrMtc || xtime < 0 ) return 0;
+    return _pgrMtc->frameAt( xtime ); // xtime is in milliseconds
 }
 
 void MidiMaster::sendAbs( int iFrame )
 {
-    if( !_FPS ) return;
-    BSDTime grBSD = getBSDTime( iFrame );
-    MidiByte rgbMsg[] = { 0xF0, 0x7F, 0x7F, 0x01, 0x01, grBSD.hour,
-        grBSD.minute, grBSD.second, grBSD.frame, 0xF7, 0x00 };
+    if( !_pgrMtc ) return;
+    // relocate the time code counter
+    _pgrMtc->seek( iFrame );
+    MidiByte rgbMsg[ 11 ] = { 0 };
+    MtcEncoder::fullFrame( _pgrMtc->current(), rgbMsg );
     
-    Pm_WriteSysEx( _hMidiOut, _iNextTimeSlot, rgbMsg );
+    writeSysEx( _iNextTimeSlot, rgbMsg );
 }
 
-void MidiMaster::sendStopId( XSongId iXSongId )
+void MidiMaster::sendStopId( XSongId iXSongId, LTimePoint when )
 {
     if( _config.beVerbose() )
         std::cout << "send stop id of song #" << iXSongId << std::endl;
     MidiMsg rgb = _config.endNotifier().getMsg( iXSongId );
     if( rgb )
     {
-        Pm_WriteShort( _hMidiOut, _iNextTimeSlot, rgb );
+        writeShort( when, rgb );
     }
 }
 
-void MidiMaster::sendStartId( XSongId iXSongId )
+void MidiMaster::sendStartId( XSongId iXSongId, LTimePoint when )
 {
     if( _config.beVerbose() )
         std::cout << "send start id of song #" << iXSongId << std::endl;
     MidiMsg rgb = _config.beginNotifier().getMsg( iXSongId );
     if( rgb )
     {
-        Pm_WriteShort( _hMidiOut, _iNextTimeSlot, rgb );
+        writeShort( when, rgb );
     }
 }
 
+void MidiMaster::announce( XSongId iXSongId, LTimePoint when )
+{
+    if( iXSongId == _ilAnnouncedId )
+        return;
+    if( _ilAnnouncedId != XSongIdInvalid )
+        sendStopId( _ilAnnouncedId, when );
+    if( iXSongId != XSongIdInvalid )
+        sendStartId( iXSongId, when );
+    _ilAnnouncedId = iXSongId;
+}
+
+bool MidiMaster::predictionTime( LTimePoint& lTime )
+{
+    XSongId iXNext = _grStatusNew.getNextSongId();
+    XTimePoint lDuration = _grStatusNew.getDuration();
+    if( !_config.predictSongChanges() || iXNext == XSongIdInvalid || lDuration == XTimePointInvalid ||
+            _ilAnnouncedId != _grStatusNew.getSongId() || iXNext == _ilAnnouncedId )
+        return false; // nothing known, already predicted or indistinguishable (repeated song)
+    lTime = outputTime( lDuration );
+    return true;
+}
+
+bool MidiMaster::predictSongChange( LTimePoint lHorizon )
+{
+    LTimePoint when;
+    if( !predictionTime( when ) || when > lHorizon )
+        return false;
+    if( _config.beVerbose() )
+        std::cout << "predict song change to #" << _grStatusNew.getNextSongId() << std::endl;
+    // keep time stamps non-decreasing
+    when = std::max( when, _iNextTimeSlot );
+    announce( _grStatusNew.getNextSongId(), when );
+    _iNextTimeSlot = when;
+    stopClock();
+    // the next song starts at 0, its time code follows right away instead of running on past
+    // the end of this song until XMMS2 reports the change
+    _grTimeModel.setIntercept( TimePoint( 0, when + _lMidiLatency ) );
+    _cFrame = 0;
+    sendAbs( 0 );
+    sendMmcLocate( 0, when );
+    return true;
+}
+
 void MidiMaster::enqueueFrames()
 {
-    if( !_FPS ) return;
+    if( !_pgrMtc ) return;
     while( 1 )
     {
         // enqueue a complete timestamp = 8 quaterframes = 2 frames
 
-        // start time of this frame
-        XTimePoint xtime = ( _cFrame * 1000 + _FPS / 2 ) / _FPS;
-        if( timeInt( xtime ) -  Now() > _cScheduleTime )
+        // start time of this frame and of the frame after the next one
+        LTimePoint lStart = outputTimeUs( _pgrMtc->frameStartUs( _cFrame ) );
+        LTimePoint lEnd = outputTimeUs( _pgrMtc->frameStartUs( _cFrame + 2 ) );
+        LTimePoint lNow = Now();
+        if( lStart - lNow > _grLookahead.get() )
+        {
             // there is still enough time to schedule the frames later
+            _fObserveLateness = true;
             return;
-        // ensure non-decreasing times (neccessary for jumps) ???
-        while( timeInt( xtime ) < _iNextTimeSlot ) ++xtime;
-
-        BSDTime grBSD = getBSDTime( _cFrame );
-        // quater frames: data pieces
-        MidiByte rgbMsg[] = { 0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70 };
-        rgbMsg[ 0 ] |= grBSD.frame & 0x0F;
-        rgbMsg[ 1 ] |= grBSD.frame >> 4;
-        rgbMsg[ 2 ] |= grBSD.second & 0x0F;
-        rgbMsg[ 3 ] |= grBSD.second >> 4;
-        rgbMsg[ 4 ] |= grBSD.minute & 0x0F;
-        rgbMsg[ 5 ] |= grBSD.minute >> 4;
-        rgbMsg[ 6 ] |= grBSD.hour & 0x0F;
-        rgbMsg[ 7 ] |= ( grBSD.hour >> 4 & 0x01 ) | ( _bFPS >> 4 );
-
-        PtTimestamp when;
-        for( unsigned int i = 0; i < 8; ++i, xtime += _QXTimeT )
+        }
+        if( !freewheel( lStart ) )
+            return; // no statuses for too long
+        if( _fObserveLateness )
+        {
+            observeLateness( lNow, lStart - lNow );
+            _fObserveLateness = false;
+        }
+        // song signals predicted before these frames go first, the frames follow the next song
+        if( predictSongChange( lStart ) )
+            continue;
+        // ensure non-decreasing times (neccessary for jumps)
+        if( lStart < _iNextTimeSlot )
         {
-            when = timeInt( xtime );
-            Pm_WriteShort( _hMidiOut, when, 0xF1 | ( rgbMsg[ i ] << 8 ) );
+            lEnd += _iNextTimeSlot - lStart;
+            lStart = _iNextTimeSlot;
+        }
+
+        // quater frames: data pieces (the counter follows sendAbs(), so this is a safety net)
+        if( _pgrMtc->frame() != _cFrame )
+            _pgrMtc->seek( _cFrame );
+        if( _pgrLtc )
+        {
+            // labels from the counter, before it moves on
+            BSDTime grBSD = _pgrMtc->current();
+            _pgrLtc->frame( grBSD, lStart );
+            _pgrLtc->frame( _pgrMtc->successor( grBSD ), lStart + ( lEnd - lStart ) / 2 );
+        }
+        MidiByte rgbMsg[ 8 ];
+        _pgrMtc->nextQuarterFrames( rgbMsg );
+
+        // quarter frames are evenly spread over the two frames
+        LTimePoint when;
+        for( unsigned int i = 0; i < 8; ++i )
+        {
+            when = lStart + ( lEnd - lStart ) * i / 8;
+            enqueueClock( when );
+            writeShort( when, 0xF1 | ( rgbMsg[ i ] << 8 ) );
         }
 
         // increase frame counter
@@ -253,29 +525,262 @@ void MidiMaster::enqueueFrames()
     }
 }
 
+LTimePoint MidiMaster::stallTime() const
+{
+    return std::max( cStallMin, 3 * _lStatusInterval );
+}
+
+bool MidiMaster::freewheel( LTimePoint lDeadline )
+{
+    if( lDeadline <= _lLastStatus + stallTime() )
+        return true;
+    if( !_fFreewheel )
+    {
+        _fFreewheel = true;
+        _grMetrics.add( Metrics::EM_FREEWHEELS );
+        if( _config.beVerbose() )
+            std::cout << "No status from XMMS2, freewheeling" << std::endl;
+    }
+    if( lDeadline <= _lLastStatus + stallTime() + _lFreewheel )
+        return true;
+    if( !_fHold )
+    {
+        _fHold = true;
+        _grMetrics.add( Metrics::EM_FREEWHEEL_HOLDS );
+        stopClock();
+        _grWire.endStream();
+        drainWire();
+        if( _config.beVerbose() )
+            std::cout << "Freewheel window exceeded, holding time code" << std::endl;
+    }
+    return false;
+}
+
+bool MidiMaster::endFreewheel()
+{
+    const TimePoint& t = _grStatusNew.getTime();
+    LTimePoint lErr = t.ltime - timeInt( t.xtime );
+    _fFreewheel = false;
+    if( !_pgrMtc || ( !_fHold && std::abs( lErr ) <= _pgrMtc->frameStartUs( 1 ) * 1000 ) )
+    {
+        // less than a frame off: move the model, the quarter frames follow smoothly
+        _grTimeModel.setIntercept( t );
+        if( _fHold )
+        {
+            // no time code: only the beat clock was held
+            _fHold = false;
+            locateClock( t.xtime );
+        }
+        return false;
+    }
+
+    // time code stopped or is too far off: send a full frame
+    int cFrame = frameNrAt( t.xtime );
+    if( _config.beVerbose() )
+        std::cout << "Resync after freewheeling: " << _cFrame << "->" << cFrame << std::endl;
+    _cFrame = cFrame;
+    sendAbs( cFrame );
+    updateTimeYIntercept();
+    sendMmcLocate( cFrame, _iNextTimeSlot );
+    locateClock( t.xtime );
+    _cStatusValid = 1;
+    announce( _grStatusNew.getSongId(), _iNextTimeSlot );
+    _grMetrics.add( Metrics::EM_RELOCATES );
+    return true;
+}
+
+void MidiMaster::observeLateness( LTimePoint lNow, LTimePoint lQueued )
+{
+    if( lQueued < 0 )
+        _grMetrics.add( Metrics::EM_UNDERRUNS );
+    _grLookahead.observe( std::max<LTimePoint>( 0, lNow - _lPlannedEnqueue ), lQueued );
+    _grMetrics.set( Metrics::EM_LOOKAHEAD, _grLookahead.get() );
+    _grMetrics.set( Metrics::EM_LATENESS_PEAK, _grLookahead.getPeak() );
+}
+
+void MidiMaster::writeShort( LTimePoint when, MidiMsg msg )
+{
+    WireMsg grMsg;
+    grMsg.when = when;
+    grMsg.msg = msg;
+    _grWire.submit( grMsg );
+    drainWire();
+}
+
+void MidiMaster::writeSysEx( LTimePoint when, const MidiByte* rgbMsg )
+{
+    WireMsg grMsg;
+    grMsg.when = when;
+    grMsg.msg = 0;
+    unsigned int ib = 0;
+    do
+        grMsg.rgbSysEx[ ib ] = rgbMsg[ ib ];
+    while( rgbMsg[ ib++ ] != 0xF7 && ib < sizeof( grMsg.rgbSysEx ) );
+    _grWire.submit( grMsg );
+    drainWire();
+}
+
+void MidiMaster::drainWire()
+{
+    WireMsg grMsg;
+    LTimePoint lDelay;
+    while( _grWire.pop( grMsg, lDelay ) )
+    {
+        if( lDelay > 0 )
+        {
+            _grMetrics.add( WireScheduler::isUrgent( grMsg ) ? Metrics::EM_WIRE_LATE : Metrics::EM_WIRE_DEFERRED );
+            _grMetrics.max( Metrics::EM_WIRE_DELAY_PEAK, lDelay / 1000 );
+            if( _config.beVerbose() )
+                std::cout << "MIDI message 0x" << std::hex << ( grMsg.msg ? grMsg.msg : grMsg.rgbSysEx[ 0 ] )
+                    << std::dec << " moved back by " << lDelay / 1000 << " us on the wire" << std::endl;
+        }
+        emit( grMsg );
+    }
+}
+
+void MidiMaster::emit( const WireMsg& grMsg )
+{
+    if( _fRealTime )
+    {
+        // the output ignores time stamps in real-time mode, so a full ring must not send
+        // early: wait until the oldest message is due and make room
+        if( _iPendingHead - _iPendingTail == cPending )
+        {
+            _grMetrics.add( Metrics::EM_PENDING_FULL );
+            RealTime::sleepUntil( _rgPending[ _iPendingTail % cPending ].when );
+            emitPending();
+        }
+        _rgPending[ _iPendingHead++ % cPending ] = grMsg;
+        return;
+    }
+    if( grMsg.msg )
+        checkWrite( _pgrOut->writeShort( grMsg.when, grMsg.msg ) );
+    else
+        checkWrite( _pgrOut->writeSysEx( grMsg.when, grMsg.rgbSysEx ) );
+}
+
+void MidiMaster::emitPending()
+{
+    LTimePoint lNow = Now();
+    while( _iPendingTail != _iPendingHead )
+    {
+        WireMsg& grMsg = _rgPending[ _iPendingTail % cPending ];
+        if( grMsg.when > lNow )
+            break;
+        if( grMsg.msg )
+            checkWrite( _pgrOut->writeShort( grMsg.when, grMsg.msg ) );
+        else
+            checkWrite( _pgrOut->writeSysEx( grMsg.when, grMsg.rgbSysEx ) );
+        ++_iPendingTail;
+    }
+    checkWrite( _pgrOut->flush() );
+}
+
+void MidiMaster::checkWrite( bool fOk )
+{
+    if( fOk )
+        return;
+    _grMetrics.add( Metrics::EM_WRITE_ERRORS );
+    if( _config.beVerbose() )
+        std::cerr << "MIDI write failed: " << _pgrOut->getError() << std::endl;
+}
+
 void MidiMaster::songStart()
 {
-    sendStartId( _grStatusNew.getSongId() );
-    _cFrame = ( _grStatusNew.getTime().xtime * _FPS ) / 1000;
-    //_cFrame = 0;
-    sendAbs( _cFrame );
+    const TimePoint& t = _grStatusNew.getTime();
+    // a confirmed prediction has already located the time code and the slaves, unless the
+    // song started more than a frame off the predicted time
+    bool fLocated = _ilAnnouncedId == _grStatusNew.getSongId() && ( !_pgrMtc ||
+            ( !( t == TimePointInvalid ) &&
+              std::abs( t.ltime - timeInt( t.xtime ) ) <= _pgrMtc->frameStartUs( 1 ) * 1000 ) );
+    announce( _grStatusNew.getSongId(), _iNextTimeSlot );
+    if( !fLocated )
+    {
+        _cFrame = frameNrAt( t.xtime );
+        sendAbs( _cFrame );
+        sendMmcLocate( _cFrame, _iNextTimeSlot, _grStatusNew.getPlaybackStatus() == Status::EPS_PLAYING );
+    }
+    locateClock( t.xtime );
+}
+
+void MidiMaster::sendMmc( Mmc::ECommand iCommand, LTimePoint when )
+{
+    if( _config.getMmcDevice() < 0 )
+        return;
+    MidiByte rgbMsg[ Mmc::cbCommand ];
+    Mmc::command( _config.getMmcDevice(), iCommand, rgbMsg );
+    writeSysEx( when, rgbMsg );
+}
+
+void MidiMaster::sendMmcLocate( int iFrame, LTimePoint when, bool fPlay )
+{
+    if( _config.getMmcDevice() < 0 )
+        return;
+    if( _pgrMtc )
+    {
+        MidiByte rgbMsg[ Mmc::cbLocate ];
+        Mmc::locate( _config.getMmcDevice(), _pgrMtc->bsdTime( iFrame ), rgbMsg );
+        writeSysEx( when, rgbMsg );
+    }
+    if( fPlay )
+        sendMmc( Mmc::EMMC_DEFERRED_PLAY, when );
 }
 
+double MidiMaster::tempo() const
+{
+    double dfBpm = _config.getTempo( _grStatusNew.getSongId() );
+    return dfBpm > 0 ? dfBpm : _grStatusNew.getBpm();
+}
 
+LTimePoint MidiMaster::clockTime( int64_t cTick )
+{
+    return outputTimeUs( _grBeatClock.tickUs( cTick ) );
+}
 
-MidiMaster::BSDTime MidiMaster::getBSDTime( int iFrame ) const
+void MidiMaster::locateClock( XTimePoint xtime )
 {
-    BSDTime grBSD;
-    grBSD.frame = iFrame % _FPS;
-    grBSD.second = iFrame / _FPS;
-    grBSD.minute = grBSD.second / 60;
-    grBSD.second %= 60;
-    grBSD.hour = grBSD.minute / 60;
-    grBSD.minute %= 60;
-    grBSD.hour %= 24;
-    grBSD.hour |= _bFPS; // add frame rate information
+    if( !_config.sendBeatClock() )
+        return;
+    stopClock();
+    _grBeatClock.setTempo( tempo() );
+    if( !_grBeatClock.isValid() )
+        return;
+    int iSixteenth = _grBeatClock.sixteenthAt( xtime );
+    _grBeatClock.locate( iSixteenth );
+    if( _config.beVerbose() )
+        std::cout << "beat clock at " << _grBeatClock.getTempo() << " BPM, position " << iSixteenth << std::endl;
+    // the song position may only be sent while the clock is stopped
+    writeShort( _iNextTimeSlot, BeatClock::songPosition( iSixteenth ) );
+    if( _grStatusNew.getPlaybackStatus() != Status::EPS_PLAYING )
+        return;
+    // the first tick after start/continue is played at the position
+    writeShort( _iNextTimeSlot, iSixteenth ? 0xFB : 0xFA );
+    _fClock = true;
+}
 
-    return grBSD;
+void MidiMaster::stopClock()
+{
+    if( !_fClock )
+        return;
+    writeShort( _iNextTimeSlot, 0xFC );
+    _fClock = false;
 }
 
+void MidiMaster::enqueueClock( LTimePoint lUntil )
+{
+    if( !_fClock )
+        return;
+    LTimePoint when;
+    while( ( when = clockTime( _grBeatClock.tick() ) ) < lUntil )
+    {
+        // song signals predicted before this tick go first, the clock stops there
+        if( predictSongChange( when ) )
+            return;
+        // ensure non-decreasing times
+        when = std::max( when, _iNextTimeSlot );
+        writeShort( when, 0xF8 );
+        _iNextTimeSlot = when;
+        _grBeatClock.advance();
+    }
+}
 
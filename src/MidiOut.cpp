@@ -0,0 +1,271 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include "MidiOut.h"
+#include "Clock.h"
+
+std::unique_ptr<MidiOut> MidiOut::create( EMidiOut iType, PmDeviceID iDevice,
+        const std::string& szPort, bool fImmediate )
+{
+#ifdef HAVE_ALSA
+    if( iType == EMO_ALSA )
+        return std::unique_ptr<MidiOut>( new AlsaSeqOut( szPort, fImmediate ) );
+#else
+    if( iType == EMO_ALSA )
+        throw std::runtime_error( "Built without ALSA sequencer support" );
+#endif
+    return std::unique_ptr<MidiOut>( new PortMidiOut( iDevice, fImmediate ) );
+}
+
+bool BatchedMidiOut::writeShort( LTimePoint when, MidiMsg msg )
+{
+    bool fOk = _cEvent < cBatch || flush();
+    // PortMidi ignores the time stamp if opened without latency
+    _rgEvent[ _cEvent ].message = msg;
+    _rgEvent[ _cEvent ].timestamp = Clock::toPm( when );
+    ++_cEvent;
+    return fOk;
+}
+
+bool BatchedMidiOut::writeSysEx( LTimePoint when, const MidiByte* rgbMsg )
+{
+    // SysEx messages are not batched, so the batch goes first to keep the order
+    bool fOk = flush();
+    return submitSysEx( when, rgbMsg ) && fOk;
+}
+
+bool BatchedMidiOut::flush()
+{
+    if( !_cEvent )
+        return true;
+    int cEvent = _cEvent;
+    _cEvent = 0; // a failed batch is dropped
+    return submit( _rgEvent, cEvent );
+}
+
+PortMidiOut::PortMidiOut( PmDeviceID iDevice, bool fImmediate ) :
+    _hMidiOut( 0 ), _iErr( pmNoError )
+{
+    PmError iErr;
+    // immediate output is written at its deadline, so PortMidi must not delay it
+    if( ( iErr = Pm_OpenOutput( &_hMidiOut, iDevice, 0, 100, &Clock::pmTimeProc, 0,
+                    fImmediate ? 0 : 1 ) ) != pmNoError )
+        throw std::runtime_error( std::string( "Unable to open midi device: " ) + Pm_GetErrorText( iErr ) );
+}
+
+PortMidiOut::~PortMidiOut()
+{
+    Pm_Close( _hMidiOut );
+}
+
+bool PortMidiOut::submit( PmEvent* rgEvent, int cEvent )
+{
+    PmError iErr = Pm_Write( _hMidiOut, rgEvent, cEvent );
+    if( iErr < pmNoError )
+    {
+        _iErr = iErr;
+        return false;
+    }
+    return true;
+}
+
+bool PortMidiOut::submitSysEx( LTimePoint when, const MidiByte* rgbMsg )
+{
+    PmError iErr = Pm_WriteSysEx( _hMidiOut, Clock::toPm( when ), const_cast<MidiByte*>( rgbMsg ) );
+    if( iErr < pmNoError )
+    {
+        _iErr = iErr;
+        return false;
+    }
+    return true;
+}
+
+const char* PortMidiOut::getError() const
+{
+    return Pm_GetErrorText( _iErr );
+}
+
+#ifdef HAVE_ALSA
+AlsaSeqOut::AlsaSeqOut( const std::string& szPort, bool fImmediate ) :
+    _hSeq( 0 ), _hEncoder( 0 ), _iPort( -1 ), _iQueue( -1 ), _fImmediate( fImmediate ),
+    _lOrigin( 0 ), _lSynced( 0 ), _iErr( 0 )
+{
+    int iErr;
+    if( ( iErr = snd_seq_open( &_hSeq, "default", SND_SEQ_OPEN_OUTPUT, 0 ) ) < 0 )
+        fatal( "Unable to open ALSA sequencer", iErr );
+    snd_seq_set_client_name( _hSeq, "Xmms2MidiMaster" );
+
+    if( ( _iPort = snd_seq_create_simple_port( _hSeq, "MIDI out",
+                    SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+                    SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION ) ) < 0 )
+        fatal( "Unable to create ALSA sequencer port", _iPort );
+
+    // without a port, other clients subscribe themselves (e.g. with aconnect)
+    if( szPort.size() > 0 )
+    {
+        snd_seq_addr_t grAddr;
+        if( ( iErr = snd_seq_parse_address( _hSeq, &grAddr, szPort.c_str() ) ) < 0 ||
+                ( iErr = snd_seq_connect_to( _hSeq, _iPort, grAddr.client, grAddr.port ) ) < 0 )
+            fatal( "Unable to connect to ALSA sequencer port " + szPort, iErr );
+    }
+
+    if( ( iErr = snd_midi_event_new( cMaxSysEx, &_hEncoder ) ) < 0 )
+        fatal( "Unable to create MIDI event encoder", iErr );
+    snd_midi_event_no_status( _hEncoder, 1 );
+
+    if( fImmediate )
+        return; // events are sent directly, no queue needed
+
+    if( ( _iQueue = snd_seq_alloc_named_queue( _hSeq, "Xmms2MidiMaster" ) ) < 0 )
+        fatal( "Unable to allocate ALSA sequencer queue", _iQueue );
+
+    // prefer the high resolution timer, the system timer ticks with HZ only
+    snd_seq_queue_timer_t* pgrTimer;
+    snd_seq_queue_timer_alloca( &pgrTimer );
+    snd_timer_id_t* pgrId;
+    snd_timer_id_alloca( &pgrId );
+    snd_timer_id_set_class( pgrId, SND_TIMER_CLASS_GLOBAL );
+    snd_timer_id_set_sclass( pgrId, SND_TIMER_SCLASS_NONE );
+    snd_timer_id_set_card( pgrId, -1 );
+    snd_timer_id_set_device( pgrId, SND_TIMER_GLOBAL_HRTIMER );
+    snd_timer_id_set_subdevice( pgrId, 0 );
+    if( snd_seq_get_queue_timer( _hSeq, _iQueue, pgrTimer ) >= 0 )
+    {
+        snd_seq_queue_timer_set_type( pgrTimer, SND_SEQ_TIMER_ALSA );
+        snd_seq_queue_timer_set_id( pgrTimer, pgrId );
+        snd_seq_set_queue_timer( _hSeq, _iQueue, pgrTimer ); // keeps the system timer on failure
+    }
+
+    if( ( iErr = snd_seq_start_queue( _hSeq, _iQueue, 0 ) ) < 0 ||
+            ( iErr = snd_seq_drain_output( _hSeq ) ) < 0 )
+        fatal( "Unable to start ALSA sequencer queue", iErr );
+    if( !sync() )
+        fatal( "Unable to read ALSA sequencer queue", _iErr );
+}
+
+AlsaSeqOut::~AlsaSeqOut()
+{
+    if( _hEncoder )
+        snd_midi_event_free( _hEncoder );
+    if( _hSeq )
+        snd_seq_close( _hSeq ); // also frees the queue and port
+}
+
+void AlsaSeqOut::fatal( const std::string& szWhat, int iErr )
+{
+    if( _hEncoder )
+        snd_midi_event_free( _hEncoder );
+    _hEncoder = 0;
+    if( _hSeq )
+        snd_seq_close( _hSeq );
+    _hSeq = 0;
+    throw std::runtime_error( szWhat + ": " + snd_strerror( iErr ) );
+}
+
+bool AlsaSeqOut::sync()
+{
+    snd_seq_queue_status_t* pgrStatus;
+    snd_seq_queue_status_alloca( &pgrStatus );
+
+    // the queue time is read between two readings of the local clock
+    LTimePoint lBefore = Now();
+    int iErr = snd_seq_get_queue_status( _hSeq, _iQueue, pgrStatus );
+    LTimePoint lAfter = Now();
+    if( iErr < 0 )
+        return fail( iErr );
+
+    const snd_seq_real_time_t* pgrTime = snd_seq_queue_status_get_real_time( pgrStatus );
+    _lOrigin = lBefore + ( lAfter - lBefore ) / 2 -
+        ( static_cast<LTimePoint>( pgrTime->tv_sec ) * 1000000000 + pgrTime->tv_nsec );
+    _lSynced = lAfter;
+    return true;
+}
+
+bool AlsaSeqOut::writeShort( LTimePoint when, MidiMsg msg )
+{
+    snd_seq_event_t grEvent;
+    snd_seq_ev_clear( &grEvent );
+    snd_midi_event_reset_encode( _hEncoder );
+    // feed status and data bytes until the encoder completes the event
+    for( int ib = 0; ib < 3; ++ib )
+    {
+        int iRet = snd_midi_event_encode_byte( _hEncoder, ( msg >> ( 8 * ib ) ) & 0xFF, &grEvent );
+        if( iRet < 0 )
+            return fail( iRet );
+        if( iRet > 0 )
+            return output( grEvent, when );
+    }
+    return fail( -EINVAL );
+}
+
+bool AlsaSeqOut::writeSysEx( LTimePoint when, const MidiByte* rgbMsg )
+{
+    long cb = 0;
+    while( cb < cMaxSysEx && rgbMsg[ cb++ ] != 0xF7 )
+        ;
+
+    snd_seq_event_t grEvent;
+    snd_seq_ev_clear( &grEvent );
+    snd_midi_event_reset_encode( _hEncoder );
+    long iRet = snd_midi_event_encode( _hEncoder, rgbMsg, cb, &grEvent );
+    if( iRet < 0 )
+        return fail( iRet );
+    if( grEvent.type == SND_SEQ_EVENT_NONE )
+        return fail( -EINVAL );
+    return output( grEvent, when ); // copies the data out of the encoder's buffer
+}
+
+bool AlsaSeqOut::output( snd_seq_event_t& grEvent, LTimePoint when )
+{
+    snd_seq_ev_set_source( &grEvent, _iPort );
+    snd_seq_ev_set_subs( &grEvent );
+    if( _fImmediate )
+        snd_seq_ev_set_direct( &grEvent );
+    else
+    {
+        LTimePoint lQueue = std::max<LTimePoint>( 0, when - _lOrigin );
+        snd_seq_real_time_t grTime;
+        grTime.tv_sec = lQueue / 1000000000;
+        grTime.tv_nsec = lQueue % 1000000000;
+        snd_seq_ev_schedule_real( &grEvent, _iQueue, 0, &grTime );
+    }
+
+    // drains the output buffer by itself when it is full
+    int iErr = snd_seq_event_output( _hSeq, &grEvent );
+    return iErr < 0 ? fail( iErr ) : true;
+}
+
+bool AlsaSeqOut::flush()
+{
+    // a failed refresh is reported, the events are sent with the previous mapping anyway
+    bool fOk = _fImmediate || Now() - _lSynced <= cSyncInterval || sync();
+    int iErr = snd_seq_drain_output( _hSeq );
+    return iErr < 0 ? fail( iErr ) : fOk;
+}
+
+const char* AlsaSeqOut::getError() const
+{
+    return snd_strerror( _iErr );
+}
+#endif // ifdef HAVE_ALSA
@@ -0,0 +1,124 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MtcDecoder.h"
+
+MtcDecoder::MtcDecoder() :
+    _pgrRate( MtcEncoder::create( FrameRate25::bRate ) )
+{
+    reset();
+}
+
+void MtcDecoder::reset()
+{
+    _iNext = -1;
+    _cPieces = 0;
+    _iFrame = 0;
+    _fLocked = false;
+    _fLocate = true;
+}
+
+bool MtcDecoder::quarterFrame( MidiByte bData, LTimePoint ltime, Position& grPos )
+{
+    int iPiece = ( bData >> 4 ) & 0x07;
+    if( iPiece != _iNext && !( _iNext < 0 && iPiece == 0 ) )
+    {
+        // out of order (dropped message or reverse direction): wait for the next piece 0
+        if( _fLocked )
+            reset();
+        _iNext = iPiece == 0 ? 0 : -1;
+        if( _iNext < 0 )
+            return false;
+    }
+    _rgbPiece[ iPiece ] = bData & 0x0F;
+    _iNext = ( iPiece + 1 ) & 0x07;
+    if( iPiece == 0 )
+    {
+        _cPieces = 0;
+        if( _fLocked )
+            _iFrame += 2; // continues the previous sequence
+    }
+    ++_cPieces;
+
+    if( iPiece == 7 && _cPieces == 8 )
+    {
+        // complete sequence: check the label
+        MidiByte bHour = _rgbPiece[ 6 ] | ( _rgbPiece[ 7 ] << 4 );
+        if( ( bHour & 0x60 ) != _pgrRate->rateBits() )
+            setRate( bHour & 0x60 );
+        BSDTime grBSD;
+        grBSD.frame = _rgbPiece[ 0 ] | ( _rgbPiece[ 1 ] << 4 );
+        grBSD.second = _rgbPiece[ 2 ] | ( _rgbPiece[ 3 ] << 4 );
+        grBSD.minute = _rgbPiece[ 4 ] | ( _rgbPiece[ 5 ] << 4 );
+        grBSD.hour = bHour;
+        int iFrame = _pgrRate->frameOf( grBSD );
+        if( !_fLocked || iFrame != _iFrame )
+        {
+            _fLocate = true;
+            _iFrame = iFrame;
+        }
+        _fLocked = true;
+    }
+    if( !_fLocked )
+        return false;
+
+    grPos.lUs = quarterUs( _iFrame, iPiece );
+    grPos.ltime = ltime;
+    grPos.fLocate = _fLocate;
+    _fLocate = false;
+    return true;
+}
+
+bool MtcDecoder::sysEx( const MidiByte* rgbMsg, unsigned int cb, LTimePoint ltime, Position& grPos )
+{
+    // F0 7F <device> 01 01 hr mn sc fr F7
+    if( cb < 10 || rgbMsg[ 0 ] != 0xF0 || rgbMsg[ 1 ] != 0x7F || rgbMsg[ 3 ] != 0x01 ||
+            rgbMsg[ 4 ] != 0x01 )
+        return false;
+    if( ( rgbMsg[ 5 ] & 0x60 ) != _pgrRate->rateBits() )
+        setRate( rgbMsg[ 5 ] & 0x60 );
+    BSDTime grBSD;
+    grBSD.hour = rgbMsg[ 5 ];
+    grBSD.minute = rgbMsg[ 6 ];
+    grBSD.second = rgbMsg[ 7 ];
+    grBSD.frame = rgbMsg[ 8 ];
+    int iFrame = _pgrRate->frameOf( grBSD );
+
+    // quarter frames continue with piece 0 of this frame
+    reset();
+    _iFrame = iFrame - 2;
+    _fLocked = true;
+    _iNext = 0;
+
+    grPos.lUs = _pgrRate->frameStartUs( iFrame );
+    grPos.ltime = ltime;
+    grPos.fLocate = true;
+    _fLocate = false;
+    return true;
+}
+
+int64_t MtcDecoder::quarterUs( int iFrame, int iPiece ) const
+{
+    int64_t lStart = _pgrRate->frameStartUs( iFrame );
+    return lStart + ( _pgrRate->frameStartUs( iFrame + 2 ) - lStart ) * iPiece / 8;
+}
+
+void MtcDecoder::setRate( MidiByte bRate )
+{
+    _pgrRate = MtcEncoder::create( bRate );
+    _fLocate = true;
+}
@@ -0,0 +1,158 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+
+#include "MtcSlave.h"
+#include "Clock.h"
+
+MtcSlave::MtcSlave( const Config& config, StatusExchange& ex ) :
+    _client( "XmmsMidiMasterChase" ), _grStatusExchange( ex ), _hMidiIn( 0 ),
+    _fVerbose( config.beVerbose() ), _grChaser( config.getChaseOffset() ), _cbSysEx( 0 ),
+    _fSysEx( false )
+{
+    if( config.getXmmsPath().size() == 0 )
+        _client.connect();
+    else
+        _client.connect( config.getXmmsPath().c_str() );
+
+    PmError iErr;
+    if( ( iErr = Pm_OpenInput( &_hMidiIn, config.getChaseDevice(), 0, 256, &Clock::pmTimeProc, 0 ) )
+            != pmNoError )
+        throw std::runtime_error( std::string( "Unable to open midi input device: " ) + Pm_GetErrorText( iErr ) );
+    // only time code is of interest, active sensing and beat clock would fill the buffer
+    Pm_SetFilter( _hMidiIn, PM_FILT_ACTIVE | PM_FILT_CLOCK );
+}
+
+void MtcSlave::run()
+{
+    while( 1 )
+    {
+        // the millisecond of input polling is spent waiting for statuses
+        Status grStatus;
+        if( _grStatusExchange.readUntil( grStatus,
+                    std::chrono::steady_clock::now() + std::chrono::milliseconds( 1 ) ) )
+        {
+            _grChaser.slave( grStatus );
+            while( _grStatusExchange.readUntil( grStatus, std::chrono::steady_clock::time_point() ) )
+                _grChaser.slave( grStatus );
+        }
+
+        readInput();
+
+        XTimePoint xSeek;
+        Chaser::EAction iAction = _grChaser.decide( Now(), xSeek );
+        if( iAction != Chaser::ECA_NONE )
+            execute( iAction, xSeek );
+    }
+}
+
+void MtcSlave::readInput()
+{
+    int c;
+    while( Pm_Poll( _hMidiIn ) == pmGotData && ( c = Pm_Read( _hMidiIn, _rgEvent, cRead ) ) > 0 )
+    {
+        for( int i = 0; i < c; ++i )
+        {
+            PmMessage msg = _rgEvent[ i ].message;
+            LTimePoint ltime = Clock::fromPm( _rgEvent[ i ].timestamp );
+            MidiByte bStatus = Pm_MessageStatus( msg );
+            if( bStatus >= 0xF8 )
+                continue; // real-time messages are events of their own, even inside SysEx
+            if( bStatus & 0x80 && bStatus != 0xF7 )
+                _fSysEx = false; // any other status starts a new message
+            if( _fSysEx || bStatus == 0xF0 )
+            {
+                // SysEx arrives in chunks of 4 bytes
+                for( int iByte = 0; iByte < 4 && ( _fSysEx || iByte == 0 ); ++iByte )
+                    sysExByte( ( msg >> ( 8 * iByte ) ) & 0xFF, ltime );
+                continue;
+            }
+
+            MtcDecoder::Position grPos;
+            if( bStatus == 0xF1 && _grDecoder.quarterFrame( Pm_MessageData1( msg ), ltime, grPos ) )
+                position( grPos );
+        }
+    }
+}
+
+void MtcSlave::sysExByte( MidiByte b, LTimePoint ltime )
+{
+    if( b >= 0xF8 )
+        return; // real-time message inside SysEx
+    if( b & 0x80 && b != 0xF0 && b != 0xF7 )
+    {
+        // another status ends the message
+        _fSysEx = false;
+        return;
+    }
+    if( b == 0xF0 )
+    {
+        _fSysEx = true;
+        _cbSysEx = 0;
+    }
+    if( _cbSysEx < cMaxSysEx )
+        _rgbSysEx[ _cbSysEx++ ] = b;
+    if( b == 0xF7 )
+    {
+        _fSysEx = false;
+        MtcDecoder::Position grPos;
+        if( _cbSysEx < cMaxSysEx && _grDecoder.sysEx( _rgbSysEx, _cbSysEx, ltime, grPos ) )
+            position( grPos );
+    }
+}
+
+void MtcSlave::position( const MtcDecoder::Position& grPos )
+{
+    if( _fVerbose && grPos.fLocate )
+        std::cout << "chase: time code locate to " << grPos.lUs / 1000 << " ms" << std::endl;
+    _grChaser.master( grPos.lUs, grPos.ltime, grPos.fLocate );
+}
+
+void MtcSlave::execute( Chaser::EAction iAction, XTimePoint xSeek )
+{
+    // synchronous, so the next decision sees the command done
+    try {
+        switch( iAction )
+        {
+            case Chaser::ECA_PLAY:
+                _client.playback.start()();
+                break;
+            case Chaser::ECA_PAUSE:
+                _client.playback.pause()();
+                break;
+            case Chaser::ECA_SEEK:
+                _client.playback.seekMs( xSeek )();
+                break;
+            default:
+                return;
+        }
+    }
+    catch( Xmms::result_error& err )
+    {
+        std::cerr << "chase: XMMS2 command failed: " << err.what() << std::endl;
+        return;
+    }
+    if( _fVerbose )
+    {
+        static const char* rgszAction[] = { "none", "play", "pause", "seek" };
+        std::cout << "chase: " << rgszAction[ iAction ];
+        if( iAction == Chaser::ECA_SEEK )
+            std::cout << " to " << xSeek << " ms (lead " << _grChaser.getSeekBias() << " ms)";
+        std::cout << std::endl;
+    }
+}
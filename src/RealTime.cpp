@@ -0,0 +1,69 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "RealTime.h"
+#include "Clock.h"
+
+/**
+ * @brief   Stack size to touch in advance so page faults do not occur on the real-time path
+ */
+static const size_t cbPrefaultStack = 256 * 1024;
+
+bool RealTime::lockMemory()
+{
+    if( mlockall( MCL_CURRENT | MCL_FUTURE ) != 0 )
+    {
+        std::cerr << "Unable to lock memory: " << std::strerror( errno ) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RealTime::enterRealtime( int iPriority )
+{
+    // touch the stack once, so later calls do not have to fault pages in
+    volatile unsigned char rgb[ cbPrefaultStack ];
+    for( size_t ib = 0; ib < cbPrefaultStack; ib += 4096 )
+        rgb[ ib ] = 0;
+    (void)rgb[ 0 ];
+
+    struct sched_param grParam;
+    std::memset( &grParam, 0, sizeof( grParam ) );
+    grParam.sched_priority = iPriority;
+    int iErr = pthread_setschedparam( pthread_self(), SCHED_FIFO, &grParam );
+    if( iErr != 0 )
+    {
+        std::cerr << "Unable to switch to real-time scheduling: " << std::strerror( iErr ) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void RealTime::sleepUntil( LTimePoint lTime )
+{
+    struct timespec ts = Clock::toMonotonic( lTime );
+    while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr ) == EINTR );
+}
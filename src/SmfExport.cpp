@@ -0,0 +1,271 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdio>
+#include <algorithm>
+
+#include <xmmsclient/xmmsclient++.h>
+
+#include "SmfExport.h"
+#include "RunningStatus.h"
+#include "Mmc.h"
+
+/**
+ * @brief   Track chunk under construction
+ */
+struct SmfTrack
+{
+    std::string sz;                 ///< events
+    int64_t lTick;                  ///< tick of the last event
+};
+
+/**
+ * @brief   Append a variable length quantity
+ */
+static void appendVarLen( std::string& sz, uint32_t l )
+{
+    char rgch[ 5 ];
+    int cch = 0;
+    rgch[ cch++ ] = l & 0x7F;
+    while( l >>= 7 )
+        rgch[ cch++ ] = ( l & 0x7F ) | 0x80;
+    while( cch > 0 )
+        sz += rgch[ --cch ];
+}
+
+/**
+ * @brief   Append an event with its delta time
+ */
+static void appendEvent( SmfTrack& grTrack, int64_t lTick, const MidiByte* rgb, unsigned int cb )
+{
+    appendVarLen( grTrack.sz, static_cast<uint32_t>( lTick - grTrack.lTick ) );
+    grTrack.lTick = lTick;
+    grTrack.sz.append( reinterpret_cast<const char*>( rgb ), cb );
+}
+
+/**
+ * @brief   Append a short message (without running status, as sent)
+ */
+static void appendShort( SmfTrack& grTrack, int64_t lTick, MidiMsg msg )
+{
+    MidiByte rgb[] = { static_cast<MidiByte>( msg & 0xFF ), static_cast<MidiByte>( ( msg >> 8 ) & 0xFF ),
+        static_cast<MidiByte>( ( msg >> 16 ) & 0xFF ) };
+    appendEvent( grTrack, lTick, rgb, RunningStatus::length( msg ) );
+}
+
+/**
+ * @brief   Append a SysEx message (F0 <length> <bytes after F0>)
+ */
+static void appendSysEx( SmfTrack& grTrack, int64_t lTick, const MidiByte* rgbMsg, unsigned int cb )
+{
+    appendVarLen( grTrack.sz, static_cast<uint32_t>( lTick - grTrack.lTick ) );
+    grTrack.lTick = lTick;
+    grTrack.sz += static_cast<char>( 0xF0 );
+    appendVarLen( grTrack.sz, cb - 1 );
+    grTrack.sz.append( reinterpret_cast<const char*>( rgbMsg + 1 ), cb - 1 );
+}
+
+/**
+ * @brief   Append a chunk to a file
+ */
+static void appendChunk( std::string& sz, const char* szId, const std::string& szData )
+{
+    sz.append( szId, 4 );
+    uint32_t cb = szData.size();
+    for( int i = 3; i >= 0; --i )
+        sz += static_cast<char>( ( cb >> ( 8 * i ) ) & 0xFF );
+    sz += szData;
+}
+
+SmfExport::SmfExport( MidiByte bRate, const SongIdNotifier& grBegin, const SongIdNotifier& grEnd,
+        int iMmcDevice ) :
+    _bRate( bRate ), _pgrRate( MtcEncoder::create( bRate ) ), _grBegin( grBegin ), _grEnd( grEnd ),
+    _iMmcDevice( iMmcDevice )
+{
+}
+
+std::string SmfExport::render( const Song& grSong ) const
+{
+    // streaming state of this song only, so songs can be rendered concurrently
+    std::unique_ptr<MtcEncoder> pgrMtc = MtcEncoder::create( _bRate );
+    SmfTrack grTrack = { std::string(), 0 };
+    grTrack.sz.reserve( 256 + grSong.lDuration / 10 * 3 );
+
+    MidiMsg msg = _grBegin.getMsg( grSong.ilSongId );
+    if( msg )
+        appendShort( grTrack, 0, msg );
+    if( _iMmcDevice >= 0 )
+    {
+        MidiByte rgbLocate[ Mmc::cbLocate ];
+        Mmc::locate( _iMmcDevice, pgrMtc->bsdTime( 0 ), rgbLocate );
+        appendSysEx( grTrack, 0, rgbLocate, Mmc::cbLocate );
+        MidiByte rgbPlay[ Mmc::cbCommand ];
+        Mmc::command( _iMmcDevice, Mmc::EMMC_DEFERRED_PLAY, rgbPlay );
+        appendSysEx( grTrack, 0, rgbPlay, Mmc::cbCommand );
+    }
+    pgrMtc->seek( 0 );
+    MidiByte rgbFull[ 10 ];
+    MtcEncoder::fullFrame( pgrMtc->current(), rgbFull );
+    appendSysEx( grTrack, 0, rgbFull, sizeof( rgbFull ) );
+
+    // the song end goes before quarter frames at the same time
+    MidiMsg msgEnd = _grEnd.getMsg( grSong.ilSongId );
+    int64_t lEnd = tickAt( grSong.lDuration );
+    bool fEnd = !msgEnd;
+    int64_t lDurationUs = static_cast<int64_t>( grSong.lDuration ) * 1000;
+    for( int iFrame = 0; pgrMtc->frameStartUs( iFrame ) < lDurationUs; iFrame += 2 )
+    {
+        MidiByte rgb[ 8 ];
+        pgrMtc->nextQuarterFrames( rgb );
+        for( int i = 0; i < 8; ++i )
+        {
+            int64_t lTick = static_cast<int64_t>( iFrame ) * cTicksPerFrame + i * cTicksPerFrame / 4;
+            if( !fEnd && lEnd <= lTick )
+            {
+                appendShort( grTrack, lEnd, msgEnd );
+                fEnd = true;
+            }
+            MidiByte rgbQuarter[] = { 0xF1, rgb[ i ] };
+            appendEvent( grTrack, lTick, rgbQuarter, 2 );
+        }
+    }
+    if( !fEnd )
+        appendShort( grTrack, lEnd, msgEnd );
+    const MidiByte rgbEndOfTrack[] = { 0xFF, 0x2F, 0x00 };
+    appendEvent( grTrack, grTrack.lTick, rgbEndOfTrack, 3 );
+
+    // conductor track: name only, the SMPTE division fixes the timing
+    SmfTrack grConductor = { std::string(), 0 };
+    std::ostringstream ssName;
+    ssName << "x2mm song #" << grSong.ilSongId;
+    MidiByte rgbName[] = { 0xFF, 0x03 };
+    appendEvent( grConductor, 0, rgbName, 2 );
+    appendVarLen( grConductor.sz, ssName.str().size() );
+    grConductor.sz += ssName.str();
+    appendEvent( grConductor, 0, rgbEndOfTrack, 3 );
+
+    // format 1, 2 tracks, negative frame rate (29 for 29.97 drop frame) and ticks per frame
+    int cFps = _pgrRate->rateBits() == FrameRate24::bRate ? 24 :
+        _pgrRate->rateBits() == FrameRate25::bRate ? 25 :
+        _pgrRate->rateBits() == FrameRate2997::bRate ? 29 : 30;
+    const char rgchHeader[] = { 0, 1, 0, 2, static_cast<char>( -cFps ), cTicksPerFrame };
+    std::string szFile;
+    szFile.reserve( grTrack.sz.size() + grConductor.sz.size() + 64 );
+    appendChunk( szFile, "MThd", std::string( rgchHeader, sizeof( rgchHeader ) ) );
+    appendChunk( szFile, "MTrk", grConductor.sz );
+    appendChunk( szFile, "MTrk", grTrack.sz );
+    return szFile;
+}
+
+void SmfExport::write( const std::vector<Song>& rggrSongs, const std::string& szDir,
+        unsigned int cThreads ) const
+{
+    if( cThreads == 0 )
+        cThreads = std::max( 1u, std::thread::hardware_concurrency() );
+    if( cThreads > rggrSongs.size() )
+        cThreads = rggrSongs.size();
+
+    std::atomic<size_t> iNext( 0 );
+    std::mutex mtxError;
+    std::string szError;
+    auto worker = [&] ( )
+        {
+            size_t i;
+            while( ( i = iNext++ ) < rggrSongs.size() )
+            {
+                std::string szData = render( rggrSongs[ i ] );
+                char szName[ 32 ];
+                std::snprintf( szName, sizeof( szName ), "/%04u-%d.mid", static_cast<unsigned int>( i + 1 ),
+                        rggrSongs[ i ].ilSongId );
+                std::ofstream fl( ( szDir + szName ).c_str(), std::ios::binary );
+                if( !fl.write( szData.data(), szData.size() ) )
+                {
+                    std::lock_guard<std::mutex> grLock( mtxError );
+                    szError = "Unable to write " + szDir + szName;
+                    iNext = rggrSongs.size(); // stop all workers
+                }
+            }
+        };
+    std::vector<std::thread> rgth;
+    for( unsigned int i = 1; i < cThreads; ++i )
+        rgth.push_back( std::thread( worker ) );
+    worker();
+    for( size_t i = 0; i < rgth.size(); ++i )
+        rgth[ i ].join();
+    if( szError.size() > 0 )
+        throw std::runtime_error( szError );
+}
+
+void SmfExport::loadSongs( const std::string& szFile, std::vector<Song>& rggrSongs )
+{
+    std::ifstream fl( szFile.c_str() );
+    if( !fl )
+        throw std::runtime_error( "Unable to open song list " + szFile );
+    std::string szLine;
+    for( int iLine = 1; std::getline( fl, szLine ); ++iLine )
+    {
+        std::istringstream ss( szLine.substr( 0, szLine.find( '#' ) ) );
+        Song grSong;
+        std::string szRest;
+        if( !( ss >> grSong.ilSongId ) )
+            continue; // empty or comment
+        if( !( ss >> grSong.lDuration ) || grSong.lDuration < 0 || ( ss >> szRest ) )
+        {
+            std::ostringstream ssError;
+            ssError << szFile << ":" << iLine << ": expected \"<song id> <duration in ms>\"";
+            throw std::runtime_error( ssError.str() );
+        }
+        rggrSongs.push_back( grSong );
+    }
+}
+
+void SmfExport::loadPlaylist( const Config& config, std::vector<Song>& rggrSongs )
+{
+    Xmms::Client client( "XmmsMidiMasterExport" );
+    if( config.getXmmsPath().size() == 0 )
+        client.connect();
+    else
+        client.connect( config.getXmmsPath().c_str() );
+
+    Xmms::List<int> rgilIds = client.playlist.listEntries()();
+    for( Xmms::List<int>::const_iterator iil = rgilIds.begin(); iil != rgilIds.end(); ++iil )
+    {
+        Xmms::PropDict grInfo = client.medialib.getInfo( *iil )();
+        if( !grInfo.contains( "duration" ) )
+        {
+            std::ostringstream ssError;
+            ssError << "Duration of song #" << *iil << " unknown";
+            throw std::runtime_error( ssError.str() );
+        }
+        Song grSong = { *iil, boost::get<int>( grInfo[ "duration" ] ) };
+        rggrSongs.push_back( grSong );
+    }
+}
+
+int64_t SmfExport::tickAt( XTimePoint xtime ) const
+{
+    int iFrame = _pgrRate->frameAt( xtime );
+    int64_t lStart = _pgrRate->frameStartUs( iFrame );
+    int64_t lLength = _pgrRate->frameStartUs( iFrame + 1 ) - lStart;
+    return static_cast<int64_t>( iFrame ) * cTicksPerFrame +
+        ( static_cast<int64_t>( xtime ) * 1000 - lStart ) * cTicksPerFrame / lLength;
+}
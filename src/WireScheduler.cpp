@@ -0,0 +1,150 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "WireScheduler.h"
+
+WireScheduler::WireScheduler( int iBaud, bool fRunningStatus ) :
+    _lByte( iBaud > 0 ? 1000000000LL * cBitsPerByte / iBaud : 0 ),
+    _lBusy( LTimePointInvalid ),
+    _lLastUrgent( LTimePointInvalid ),
+    _cbLastUrgent( 0 ),
+    _lPeriod( 0 ),
+    _grRunningStatus( fRunningStatus ),
+    _iDeferredHead( 0 ),
+    _iDeferredTail( 0 ),
+    _iOut( 0 ),
+    _cOut( 0 )
+{
+}
+
+unsigned int WireScheduler::sizeSysEx( const MidiByte* rgbMsg )
+{
+    unsigned int cb = 0;
+    while( cb < sizeof( WireMsg::rgbSysEx ) && rgbMsg[ cb++ ] != 0xF7 )
+        ;
+    return cb;
+}
+
+bool WireScheduler::isUrgent( const WireMsg& grMsg )
+{
+    if( grMsg.msg )
+        // quarter frames and real-time messages (beat clock)
+        return ( grMsg.msg & 0xFF ) == 0xF1 || ( grMsg.msg & 0xFF ) >= 0xF8;
+    const MidiByte* rgb = grMsg.rgbSysEx;
+    // universal real time SysEx, MTC full message
+    return rgb[ 0 ] == 0xF0 && rgb[ 1 ] == 0x7F && rgb[ 3 ] == 0x01 && rgb[ 4 ] == 0x01;
+}
+
+void WireScheduler::submit( const WireMsg& grMsg )
+{
+    if( !isLimited() )
+    {
+        place( grMsg, grMsg.when );
+        return;
+    }
+    unsigned int cb = size( grMsg );
+
+    if( isUrgent( grMsg ) )
+    {
+        // deferred messages which are off the wire in time go first
+        release( grMsg.when - _lByte );
+
+        // messages of the same size in short succession form a stream (quarter frames);
+        // single byte real-time messages fit in anywhere
+        if( cb > 1 )
+        {
+            LTimePoint lSpacing = grMsg.when - _lLastUrgent;
+            _lPeriod = ( cb == _cbLastUrgent && lSpacing > 0 && lSpacing <= cMaxPeriod ) ? lSpacing : 0;
+            _lLastUrgent = grMsg.when;
+            _cbLastUrgent = cb;
+        }
+
+        place( grMsg, std::max( grMsg.when, _lBusy ) );
+
+        // fill the gap up to the next stream message
+        release( _lPeriod ? _lLastUrgent + _lPeriod - _lByte : LTimePointInvalid );
+        return;
+    }
+
+    // other messages keep their order
+    LTimePoint lStart = std::max( grMsg.when, _lBusy );
+    if( _iDeferredHead == _iDeferredTail &&
+            ( !_lPeriod || lStart + duration( cb ) <= _lLastUrgent + _lPeriod - _lByte ) )
+    {
+        place( grMsg, lStart );
+        return;
+    }
+    if( _iDeferredHead - _iDeferredTail >= cDeferred )
+    {
+        // no more room: the oldest one goes out, even at the cost of the stream
+        const WireMsg& grOldest = _rgDeferred[ _iDeferredTail++ % cDeferred ];
+        place( grOldest, std::max( grOldest.when, _lBusy ) );
+    }
+    _rgDeferred[ _iDeferredHead++ % cDeferred ] = grMsg;
+}
+
+bool WireScheduler::pop( WireMsg& grMsg, LTimePoint& lDelay )
+{
+    if( _iOut == _cOut )
+    {
+        _iOut = _cOut = 0;
+        return false;
+    }
+    grMsg = _rgOut[ _iOut ].grMsg;
+    lDelay = _rgOut[ _iOut ].lDelay;
+    ++_iOut;
+    return true;
+}
+
+void WireScheduler::endStream()
+{
+    _lPeriod = 0;
+    _cbLastUrgent = 0;
+    release( LTimePointInvalid );
+}
+
+void WireScheduler::place( const WireMsg& grMsg, LTimePoint lStart )
+{
+    unsigned int cb;
+    if( grMsg.msg )
+        cb = _grRunningStatus.advance( grMsg.msg );
+    else
+    {
+        cb = sizeSysEx( grMsg.rgbSysEx );
+        _grRunningStatus.reset();
+    }
+    Placed& grPlaced = _rgOut[ _cOut++ ];
+    grPlaced.grMsg = grMsg;
+    grPlaced.grMsg.when = lStart;
+    grPlaced.lDelay = lStart - grMsg.when;
+    _lBusy = lStart + duration( cb );
+}
+
+void WireScheduler::release( LTimePoint lLimit )
+{
+    while( _iDeferredTail != _iDeferredHead )
+    {
+        const WireMsg& grMsg = _rgDeferred[ _iDeferredTail % cDeferred ];
+        LTimePoint lStart = std::max( grMsg.when, _lBusy );
+        if( lLimit != LTimePointInvalid && lStart + duration( size( grMsg ) ) > lLimit )
+            return;
+        place( grMsg, lStart );
+        ++_iDeferredTail;
+    }
+}
@@ -15,11 +15,14 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdlib>
+
 #include "XmmsClient.h"
 
 
-XmmsClient::XmmsClient( const Config& config, Exchange<Status>& ex ) 
-    : _client( "XmmsMidiMaster" ), _config( config ), _grStatusExchange( ex )
+XmmsClient::XmmsClient( const Config& config, StatusExchange& ex ) 
+    : _client( "XmmsMidiMaster" ), _config( config ), _grStatusExchange( ex ), _iPlaylistPos( -1 ),
+      _lAudioLatency( config.getAudioLatency() ), _cbOutputBuffer( 0 )
 {
     // connect to xmms2
     if( config.getXmmsPath().size() == 0 )
@@ -43,6 +46,12 @@ void XmmsClient::run()
     _client.playback.currentID()( Xmms::bind( &XmmsClient::broadcastId, this ) );
     _client.playback.broadcastStatus()( Xmms::bind( &XmmsClient::broadcastStatus, this ) );
     _client.playback.getStatus()( Xmms::bind( &XmmsClient::broadcastStatus, this ) );
+    if( _config.isAudioLatencyAuto() )
+        _client.config.valueGet( "output.buffersize" )( Xmms::bind( &XmmsClient::outputBufferSize, this ) );
+    _client.playlist.broadcastCurrentPos()( Xmms::bind( &XmmsClient::playlistPos, this ) );
+    _client.playlist.currentPos()( Xmms::bind( &XmmsClient::playlistPos, this ) );
+    _client.playlist.broadcastChanged()( Xmms::bind( &XmmsClient::playlistChanged, this ) );
+    _client.playlist.listEntries()( Xmms::bind( &XmmsClient::playlistEntries, this ) );
 
     if( _config.beVerbose() )
         std::cout << "enter XMMS2 main loop" << std::endl;
@@ -58,10 +67,11 @@ bool XmmsClient::signalPlaytime( const int& lTime )
     // get localtime
     LTimePoint ltp = Now();
 
-    _grStatus.setTime( lTime, ltp );
+    // the sample at lTime is heard after the audio latency
+    _grStatus.setTime( lTime, ltp + _lAudioLatency );
 
     // send status update
-    _grStatusExchange.write( _grStatus );
+    sendStatus();
 
     return true;
 }
@@ -69,6 +79,16 @@ bool XmmsClient::signalPlaytime( const int& lTime )
 bool XmmsClient::broadcastId( const int& ilSongId )
 {
     _grStatus.setSongId( ilSongId );
+    const SongInfo* pgrInfo = songInfo( ilSongId );
+    if( pgrInfo )
+        applySongInfo( *pgrInfo );
+    else
+    {
+        // follow from the medialib
+        _grStatus.setDuration( XTimePointInvalid );
+        _grStatus.setBpm( 0 );
+    }
+    updateNextSongId();
 
     // send status update
     //_grStatusExchange.write( _grStatus );
@@ -105,11 +125,124 @@ bool XmmsClient::broadcastStatus( const Xmms::Playback::Status& iState )
     if( iStatusOld != Status::EPS_STOPPED )
         // after a stop, first the playback state, then the song id and finally the time broadcast is sent
         // => we cannot write the status now as long as the id and time are unknown
-        _grStatusExchange.write( _grStatus );
+        sendStatus();
+
+    return true;
+}
+
+void XmmsClient::sendStatus()
+{
+    unsigned long cDropped = _grStatusExchange.getDropped();
+    _grStatusExchange.write( _grStatus );
+    if( _grStatusExchange.getDropped() != cDropped )
+        std::cerr << "Status queue overflow, " << _grStatusExchange.getDropped()
+                  << " status updates dropped so far" << std::endl;
+
+    // drops of additional outputs are counted in their metrics
+    for( std::vector<StatusExchange*>::const_iterator ipgr = _rgpgrFanOut.begin(),
+            ipgrMax = _rgpgrFanOut.end(); ipgr != ipgrMax; ++ipgr )
+        ( *ipgr )->write( _grStatus );
+}
+
+bool XmmsClient::mediaInfo( const Xmms::PropDict& grInfo )
+{
+    if( !grInfo.contains( "id" ) )
+        return false;
+    XSongId ilSongId = boost::get<int>( grInfo[ "id" ] );
+    SongInfo& grSong = _mpgrSongInfo[ ilSongId ];
+    // cached without duration as well (e.g. streams), so the medialib is asked only once
+    grSong.lDuration = grInfo.contains( "duration" ) ? boost::get<int>( grInfo[ "duration" ] ) : XTimePointInvalid;
+    // XMMS2 outputs 16 bit samples unless configured otherwise; assume CD format if unknown
+    long lRate = grInfo.contains( "samplerate" ) ? boost::get<int>( grInfo[ "samplerate" ] ) : 44100;
+    long cChannels = grInfo.contains( "channels" ) ? boost::get<int>( grInfo[ "channels" ] ) : 2;
+    grSong.cbPerSecond = lRate * cChannels * 2;
+    // the tempo is an integer or a string depending on the tag it was read from
+    grSong.dfBpm = 0;
+    if( grInfo.contains( "bpm" ) )
+    {
+        Xmms::Dict::Variant grBpm = grInfo[ "bpm" ];
+        if( const int* piBpm = boost::get<int>( &grBpm ) )
+            grSong.dfBpm = *piBpm;
+        else if( const std::string* pszBpm = boost::get<std::string>( &grBpm ) )
+            grSong.dfBpm = std::strtod( pszBpm->c_str(), 0 );
+    }
+
+    // sent with the next playtime signal
+    if( ilSongId == _grStatus.getSongId() )
+        applySongInfo( grSong );
+
+    if( _config.beVerbose() )
+        std::cout << "duration of song #" << ilSongId << ": " << grSong.lDuration << " ms" << std::endl;
+
+    return false;
+}
+
+bool XmmsClient::outputBufferSize( const std::string& szValue )
+{
+    _cbOutputBuffer = std::strtol( szValue.c_str(), 0, 10 );
+    if( _config.beVerbose() )
+        std::cout << "XMMS2 output buffer: " << _cbOutputBuffer << " bytes" << std::endl;
+    return false;
+}
+
+void XmmsClient::applySongInfo( const SongInfo& grSong )
+{
+    _grStatus.setDuration( grSong.lDuration );
+    _grStatus.setBpm( grSong.dfBpm );
+    if( !_config.isAudioLatencyAuto() || !_cbOutputBuffer || grSong.cbPerSecond <= 0 )
+        return;
+    _lAudioLatency = static_cast<LTimePoint>( _cbOutputBuffer ) * 1000 * LTimeMs / grSong.cbPerSecond;
+    if( _config.beVerbose() )
+        std::cout << "audio latency: " << _lAudioLatency / 1000 << " us" << std::endl;
+}
+
+bool XmmsClient::playlistPos( const Xmms::Dict& grPos )
+{
+    _iPlaylistPos = grPos.contains( "position" ) ? boost::get<int>( grPos[ "position" ] ) : -1;
+    updateNextSongId();
+    return true;
+}
 
+bool XmmsClient::playlistChanged( const Xmms::Dict& /* grChange */ )
+{
+    _client.playlist.listEntries()( Xmms::bind( &XmmsClient::playlistEntries, this ) );
     return true;
 }
 
+bool XmmsClient::playlistEntries( const Xmms::List<int>& rgilIds )
+{
+    _rgilPlaylist.clear();
+    for( Xmms::List<int>::const_iterator iil = rgilIds.begin(); iil != rgilIds.end(); ++iil )
+        _rgilPlaylist.push_back( *iil );
+    updateNextSongId();
+    return false;
+}
+
+const XmmsClient::SongInfo* XmmsClient::songInfo( XSongId ilSongId )
+{
+    std::map<XSongId, SongInfo>::const_iterator igr = _mpgrSongInfo.find( ilSongId );
+    if( igr != _mpgrSongInfo.end() )
+        return &igr->second;
+    if( ilSongId != XSongIdInvalid )
+        _client.medialib.getInfo( ilSongId )( Xmms::bind( &XmmsClient::mediaInfo, this ) );
+    return 0;
+}
+
+void XmmsClient::updateNextSongId()
+{
+    // position and id broadcasts arrive in any order, so only trust matching ones
+    XSongId ilNext = XSongIdInvalid;
+    if( _iPlaylistPos >= 0 && _iPlaylistPos + 1 < static_cast<int>( _rgilPlaylist.size() ) &&
+            _rgilPlaylist[ _iPlaylistPos ] == _grStatus.getSongId() )
+    {
+        ilNext = _rgilPlaylist[ _iPlaylistPos + 1 ];
+        songInfo( ilNext ); // prefetch, it is needed at the song change
+    }
+    // sent with the next playtime signal (statuses must not be sent between a stop and the
+    // playtime of the new song)
+    _grStatus.setNextSongId( ilNext );
+}
+
 bool XmmsClient::errorHandler( const std::string& szMsg )
 {
     std::cerr << "XMMS2 Error: " << szMsg << std::endl;
@@ -19,6 +19,9 @@
 #include <stdexcept>
 
 #include <thread>
+#include <chrono>
+#include <vector>
+#include <memory>
 
 #include <portmidi.h>
 
@@ -27,27 +30,193 @@
 #include "Status.h"
 #include "XmmsClient.h"
 #include "MidiMaster.h"
+#include "MtcSlave.h"
+#include "SmfExport.h"
+#include "RealTime.h"
+#include "EventLoop.h"
+#include "Metrics.h"
+#include "DriftEstimator.h"
+
+/**
+ * @brief   Persist the drift estimate published by the MIDI master learning it, if it is valid
+ * @param   szFile
+ *              Path of the drift file
+ * @param   iDevice
+ *              Output index of the master learning the drift
+ */
+static void saveDrift( const std::string& szFile, unsigned int iDevice )
+{
+    const Metrics& grMetrics = Metrics::get( iDevice );
+    if( grMetrics.value( Metrics::EM_DRIFT_SPAN ) >= DriftEstimator::cMinSpan )
+        DriftEstimator::save( szFile, grMetrics.value( Metrics::EM_DRIFT_PPB ) / 1000.0 );
+}
+
+/**
+ * @brief   Render the MIDI stream of the playlist into Standard MIDI Files
+ * @param   config
+ *              Config object
+ * @return  Return code of the program
+ */
+static int exportFiles( const Config& config )
+{
+    try {
+        std::vector<SmfExport::Song> rggrSongs;
+        if( config.getExportSongs().size() > 0 )
+            SmfExport::loadSongs( config.getExportSongs(), rggrSongs );
+        else
+            SmfExport::loadPlaylist( config, rggrSongs );
+        SmfExport grExport( config.getRateBits(), config.beginNotifier(), config.endNotifier(),
+                config.getMmcDevice() );
+        grExport.write( rggrSongs, config.getExportDir() );
+        if( config.beVerbose() )
+            std::cout << "exported " << rggrSongs.size() << " songs" << std::endl;
+    }
+    catch( std::runtime_error& err )
+    {
+        std::cerr << err.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
 
 int main( int argc, char* argv[] )
 {
     // PortMidi warm up
     Pm_Initialize();
-    std::cout << argv[ 0 ] << " Copyright (C) 2014 Maximilian Stein"
-              << "\nVersion: " << VERSION << std::endl;
     
     int lRet = 0; // return code
     try {
         Config config( argc, argv );
+        // after parsing, as the configuration decides where text goes
+        std::cout << argv[ 0 ] << " Copyright (C) 2014 Maximilian Stein"
+                  << "\nVersion: " << VERSION << std::endl;
         if( !config )
             throw 1;
 
-        Exchange<Status> grStatusExchange;
+        if( config.getExportDir().size() > 0 )
+            throw exportFiles( config ); // offline, no XMMS2 client or MIDI device
+
+        // additional outputs: each has its own configuration, exchange and master thread
+        std::vector<Config> rgconfigOutput;
+        for( size_t i = 0; i < config.getOutputCount(); ++i )
+            rgconfigOutput.push_back( config.forOutput( i ) );
+        std::vector< std::unique_ptr<StatusExchange> > rgpgrOutputExchange;
+        std::vector< std::unique_ptr<MidiMaster> > rgpgrOutputMaster;
+
+        StatusExchange grStatusExchange;
         try {
             XmmsClient client( config, grStatusExchange );
-            MidiMaster master( config, grStatusExchange );
-            std::thread thMaster( &MidiMaster::run, std::ref( master ) );
-            thMaster.detach();
+            std::unique_ptr<MidiMaster> pgrMaster;
+            std::unique_ptr<MtcSlave> pgrSlave;
+            int iRtPriority = config.getRealtimePriority();
+            if( config.getChaseDevice() >= 0 )
+                pgrSlave.reset( new MtcSlave( config, grStatusExchange ) );
+            else
+                pgrMaster.reset( new MidiMaster( config, grStatusExchange ) );
+            // a single master learns the drift of the XMMS2 clock, the others follow it
+            const MidiMaster* pgrDriftSource = pgrMaster.get();
+            unsigned int iDriftDevice = 0;
+            for( std::vector<Config>::const_iterator iconfig = rgconfigOutput.begin(),
+                    iconfigMax = rgconfigOutput.end(); iconfig != iconfigMax; ++iconfig )
+            {
+                rgpgrOutputExchange.emplace_back( new StatusExchange );
+                rgpgrOutputMaster.emplace_back( new MidiMaster( *iconfig, *rgpgrOutputExchange.back(),
+                            pgrDriftSource ) );
+                client.fanOut( *rgpgrOutputExchange.back() );
+                if( !pgrDriftSource )
+                {
+                    // chasing: the first additional output learns
+                    pgrDriftSource = rgpgrOutputMaster.back().get();
+                    iDriftDevice = iconfig->getOutputIndex();
+                }
+            }
+            if( iRtPriority )
+                RealTime::lockMemory();
+
+            // additional outputs always run in threads of their own, so a blocked interface
+            // only delays itself
+            for( std::vector< std::unique_ptr<MidiMaster> >::const_iterator ipgr = rgpgrOutputMaster.begin(),
+                    ipgrMax = rgpgrOutputMaster.end(); ipgr != ipgrMax; ++ipgr )
+            {
+                MidiMaster& master = **ipgr;
+                std::thread thMaster( [&master, iRtPriority] ( )
+                        {
+                            if( iRtPriority )
+                                RealTime::enterRealtime( iRtPriority );
+                            master.run();
+                        }
+                    );
+                thMaster.detach();
+            }
+
+            if( pgrSlave )
+            {
+                // chase mode: XMMS2 follows incoming time code, reception times matter most
+                MtcSlave& slave = *pgrSlave;
+                std::thread thSlave( [&slave, iRtPriority] ( )
+                        {
+                            if( iRtPriority )
+                                RealTime::enterRealtime( iRtPriority );
+                            slave.run();
+                        }
+                    );
+                thSlave.detach();
+            } else
+            if( config.getEngine() == Config::EE_EPOLL )
+            {
+                // XMMS2 and MIDI share this thread
+                client.setMainloop( new EventLoop( client.getConnection(), *pgrMaster ) );
+                if( iRtPriority )
+                    RealTime::enterRealtime( iRtPriority );
+            } else
+            {
+                MidiMaster& master = *pgrMaster;
+                std::thread thMaster( [&master, iRtPriority] ( )
+                        {
+                            if( iRtPriority )
+                                RealTime::enterRealtime( iRtPriority );
+                            master.run();
+                        }
+                    );
+                thMaster.detach();
+            }
+            if( int iInterval = config.getMetricsInterval() )
+            {
+                // printing must not delay the MIDI thread, so it gets its own one
+                unsigned int cOutput = rgconfigOutput.size();
+                std::thread thMetrics( [iInterval, cOutput] ( )
+                        {
+                            while( 1 )
+                            {
+                                std::this_thread::sleep_for( std::chrono::seconds( iInterval ) );
+                                Metrics::get().dump( std::cerr );
+                                for( unsigned int i = 1; i <= cOutput; ++i )
+                                {
+                                    std::cerr << "output " << i << ": ";
+                                    Metrics::get( i ).dump( std::cerr );
+                                }
+                            }
+                        }
+                    );
+                thMetrics.detach();
+            }
+            const std::string& szDriftFile = config.getDriftFile();
+            if( szDriftFile.size() > 0 )
+            {
+                std::thread thDrift( [szDriftFile, iDriftDevice] ( )
+                        {
+                            while( 1 )
+                            {
+                                std::this_thread::sleep_for( std::chrono::minutes( 1 ) );
+                                saveDrift( szDriftFile, iDriftDevice );
+                            }
+                        }
+                    );
+                thDrift.detach();
+            }
             client.run(); // blocking
+            if( szDriftFile.size() > 0 )
+                saveDrift( szDriftFile, iDriftDevice );
         }
         catch( std::runtime_error& err )
         {
@@ -0,0 +1,76 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for class BeatClock
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include "BeatClock.h"
+
+SUITE(BeatClockTest)
+{
+    TEST(TickTime)
+    {
+        BeatClock target;
+        target.setTempo( 120 );
+        CHECK( target.isValid() );
+        // 48 ticks per second
+        CHECK_EQUAL( 0, target.tickUs( 0 ) );
+        CHECK_EQUAL( 20833, target.tickUs( 1 ) );
+        CHECK_EQUAL( 1000000, target.tickUs( 48 ) );
+        CHECK_EQUAL( 3600000000LL, target.tickUs( 48 * 3600 ) );
+    }
+
+    TEST(FractionalTempo)
+    {
+        BeatClock target;
+        target.setTempo( 93.5 );
+        CHECK_EQUAL( 641711, target.tickUs( 24 ) );
+    }
+
+    TEST(SixteenthAt)
+    {
+        BeatClock target;
+        target.setTempo( 120 );
+        // a sixteenth note lasts 125 ms
+        CHECK_EQUAL( 0, target.sixteenthAt( 0 ) );
+        CHECK_EQUAL( 1, target.sixteenthAt( 1 ) );
+        CHECK_EQUAL( 1, target.sixteenthAt( 125 ) );
+        CHECK_EQUAL( 2, target.sixteenthAt( 126 ) );
+        CHECK_EQUAL( 0, target.sixteenthAt( -40 ) );
+    }
+
+    TEST(Locate)
+    {
+        BeatClock target;
+        target.setTempo( 120 );
+        target.locate( 3 );
+        CHECK_EQUAL( 18, target.tick() );
+        CHECK_EQUAL( 375000, target.tickUs( target.tick() ) );
+        target.advance();
+        CHECK_EQUAL( 19, target.tick() );
+    }
+
+    TEST(SongPosition)
+    {
+        CHECK_EQUAL( 0x0000F2u, BeatClock::songPosition( 0 ) );
+        CHECK_EQUAL( 0x017FF2u, BeatClock::songPosition( 255 ) );
+        CHECK_EQUAL( 0x7F7FF2u, BeatClock::songPosition( 100000 ) );
+    }
+}
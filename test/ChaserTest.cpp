@@ -0,0 +1,171 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for the decisions of the time code chaser
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include "Chaser.h"
+
+SUITE(ChaserTest)
+{
+    // master at song position xStart (ms) at local time 1 s, running at nominal speed;
+    // XMMS2 lands cLag ms behind every seek target (but not before the song start)
+    struct Fixture
+    {
+        static const XTimePoint cLag = 50;
+
+        Chaser target;
+        LTimePoint lNow;
+        XTimePoint xStart;
+        bool fMaster;
+        Status grSlave;
+        TimePoint tSeek;
+
+        Fixture() : lNow( 1000 * LTimeMs ), xStart( 10000 ), fMaster( true ), tSeek( 0, lNow )
+        {
+            grSlave.setPlaybackStatus( Status::EPS_PAUSED );
+            grSlave.setTime( 0, lNow );
+        }
+
+        XTimePoint masterPos() const
+        {
+            return xStart + static_cast<XTimePoint>( ( lNow - 1000 * LTimeMs ) / LTimeMs );
+        }
+
+        // advance 10 ms: one time code position, one status, one decision
+        Chaser::EAction step()
+        {
+            lNow += 10 * LTimeMs;
+            if( fMaster )
+                target.master( masterPos() * 1000LL, lNow, false );
+            if( grSlave.getPlaybackStatus() == Status::EPS_PLAYING )
+                grSlave.setTime( tSeek.xtime + static_cast<XTimePoint>( ( lNow - tSeek.ltime ) / LTimeMs ), lNow );
+            target.slave( grSlave );
+
+            XTimePoint xSeek;
+            Chaser::EAction iAction = target.decide( lNow, xSeek );
+            switch( iAction )
+            {
+                case Chaser::ECA_PLAY:
+                    grSlave.setPlaybackStatus( Status::EPS_PLAYING );
+                    break;
+                case Chaser::ECA_PAUSE:
+                    grSlave.setPlaybackStatus( Status::EPS_PAUSED );
+                    break;
+                case Chaser::ECA_SEEK:
+                    tSeek = TimePoint( xSeek > cLag ? xSeek - cLag : 0, lNow );
+                    grSlave.setTime( tSeek.xtime, lNow );
+                    break;
+                default:
+                    break;
+            }
+            return iAction;
+        }
+
+        int count( Chaser::EAction iAction, int cSteps )
+        {
+            int c = 0;
+            for( int i = 0; i < cSteps; ++i )
+                if( step() == iAction )
+                    ++c;
+            return c;
+        }
+    };
+
+    TEST_FIXTURE( Fixture, Idle )
+    {
+        fMaster = false;
+        CHECK_EQUAL( count( Chaser::ECA_NONE, 10 ), 10 );
+        grSlave.setPlaybackStatus( Status::EPS_PLAYING );
+        CHECK_EQUAL( step(), Chaser::ECA_PAUSE );
+    }
+
+    TEST_FIXTURE( Fixture, StartAndLearnLag )
+    {
+        step();
+        CHECK_EQUAL( step(), Chaser::ECA_SEEK );
+        CHECK_CLOSE( grSlave.getTime().xtime + cLag, masterPos(), 2 );
+        CHECK_EQUAL( step(), Chaser::ECA_PLAY );
+        CHECK( !target.isLocked() );
+
+        // the lag is learned from the first settled status, then corrected by another seek
+        CHECK_EQUAL( count( Chaser::ECA_SEEK, 100 ), 1 );
+        CHECK_CLOSE( target.getSeekBias(), cLag, 2 );
+        CHECK( target.isLocked() );
+        CHECK_CLOSE( grSlave.getTime().xtime, masterPos(), 2 );
+    }
+
+    TEST_FIXTURE( Fixture, Hysteresis )
+    {
+        count( Chaser::ECA_NONE, 100 );
+        CHECK( target.isLocked() );
+
+        // small slips are tolerated
+        tSeek.xtime -= Chaser::cUnlock - 20;
+        CHECK_EQUAL( count( Chaser::ECA_SEEK, 100 ), 0 );
+        CHECK( target.isLocked() );
+
+        tSeek.xtime -= 40;
+        CHECK_EQUAL( count( Chaser::ECA_SEEK, 100 ), 1 );
+        CHECK( target.isLocked() );
+        CHECK_CLOSE( grSlave.getTime().xtime, masterPos(), 2 );
+    }
+
+    TEST_FIXTURE( Fixture, SeekHoldoff )
+    {
+        // a slave that never gets close must not be flooded with seeks
+        count( Chaser::ECA_NONE, 100 );
+        CHECK_EQUAL( count( Chaser::ECA_SEEK, 100 ), 0 );
+        int c = 0;
+        for( int i = 0; i < 100; ++i )
+        {
+            tSeek.xtime -= 1000;
+            if( step() == Chaser::ECA_SEEK )
+                ++c;
+        }
+        CHECK( c <= static_cast<int>( 100 * 10 * LTimeMs / Chaser::cSeekHoldoff ) + 1 );
+    }
+
+    TEST_FIXTURE( Fixture, MasterStopsAndLocates )
+    {
+        count( Chaser::ECA_NONE, 100 );
+        fMaster = false;
+        CHECK_EQUAL( count( Chaser::ECA_PAUSE, 100 ), 1 );
+        CHECK( !target.isLocked() );
+
+        // cueing while stopped
+        target.master( 42000000, lNow, true );
+        CHECK_EQUAL( step(), Chaser::ECA_SEEK );
+        CHECK_EQUAL( grSlave.getTime().xtime + cLag, 42000 );
+        CHECK_EQUAL( count( Chaser::ECA_NONE, 10 ), 10 );
+    }
+
+    TEST_FIXTURE( Fixture, BeforeSongStart )
+    {
+        xStart = -2000;
+        grSlave.setTime( 5000, lNow );
+        step();
+        CHECK_EQUAL( step(), Chaser::ECA_SEEK );
+        CHECK_EQUAL( grSlave.getTime().xtime, 0 );
+        CHECK_EQUAL( count( Chaser::ECA_PLAY, 150 ), 0 );
+        // starts once the master reaches the song
+        CHECK_EQUAL( count( Chaser::ECA_PLAY, 100 ), 1 );
+    }
+}
@@ -0,0 +1,137 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for the ClockEstimator implementations
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include <cstdlib>
+#include <algorithm>
+
+#include "ClockEstimator.h"
+#include "TimeModel.h"
+
+SUITE(ClockEstimatorTest)
+{
+    // 1.0001 local ms per xmms2 ms, starting at local time 5 s
+    static LTimePoint ideal( XTimePoint xtime )
+    {
+        return 5000 * LTimeMs + static_cast<LTimePoint>( xtime ) * 1000100;
+    }
+
+    static LTimePoint predict( const ClockEstimator::Estimate& grEstimate, XTimePoint xtime )
+    {
+        TimeModel grModel;
+        grModel.setSlopeFixed( grEstimate.lSlope );
+        grModel.setIntercept( grEstimate.grAnchor );
+        return grModel.at( xtime );
+    }
+
+    TEST( TwoPoint )
+    {
+        TwoPointEstimator target;
+        ClockEstimator::Estimate grEstimate;
+        CHECK_EQUAL( ClockEstimator::ES_ACCEPTED, target.addSample( TimePoint( 0, ideal( 0 ) ) ) );
+        CHECK( !target.getEstimate( grEstimate ) );
+        CHECK_EQUAL( ClockEstimator::ES_ACCEPTED, target.addSample( TimePoint( 100, ideal( 100 ) ) ) );
+        CHECK_EQUAL( ClockEstimator::ES_STALE, target.addSample( TimePoint( 100, ideal( 100 ) ) ) );
+        CHECK( target.getEstimate( grEstimate ) );
+        CHECK( grEstimate.grAnchor == TimePoint( 100, ideal( 100 ) ) );
+        CHECK_EQUAL( predict( grEstimate, 1000 ), ideal( 1000 ) );
+    }
+
+    TEST( RegressionExact )
+    {
+        RegressionEstimator target;
+        ClockEstimator::Estimate grEstimate;
+        // long enough to rebase many times
+        for( XTimePoint x = 0; x < 24 * 3600 * 1000; x += 100 * 1000 )
+            CHECK_EQUAL( ClockEstimator::ES_ACCEPTED, target.addSample( TimePoint( x, ideal( x ) ) ) );
+        CHECK( target.getEstimate( grEstimate ) );
+        CHECK_EQUAL( grEstimate.lSlope, TimeModel().getSlopeFixed() + ( 100LL << TimeModel::cFracBits ) );
+        CHECK_CLOSE( predict( grEstimate, 24 * 3600 * 1000 ), ideal( 24 * 3600 * 1000 ), 2 );
+        CHECK_CLOSE( grEstimate.dfConfidence, 1.0, 1e-9 );
+    }
+
+    TEST( RegressionJitter )
+    {
+        // statuses are delivered up to 3 ms late
+        RegressionEstimator target;
+        TwoPointEstimator grTwoPoint;
+        std::srand( 42 );
+        LTimePoint lErr = 0, lErrTwoPoint = 0;
+        for( XTimePoint x = 0; x < 60000; x += 100 )
+        {
+            TimePoint t( x, ideal( x ) + std::rand() % ( 3 * LTimeMs ) );
+            target.addSample( t );
+            grTwoPoint.addSample( t );
+            ClockEstimator::Estimate grEstimate;
+            if( x < 10000 )
+                continue;
+            // error of the extrapolation to the next status
+            CHECK( target.getEstimate( grEstimate ) );
+            lErr = std::max( lErr, std::abs( predict( grEstimate, x + 100 ) - ideal( x + 100 ) ) );
+            CHECK( grTwoPoint.getEstimate( grEstimate ) );
+            lErrTwoPoint = std::max( lErrTwoPoint,
+                    std::abs( predict( grEstimate, x + 100 ) - ideal( x + 100 ) ) );
+        }
+        CHECK( lErr < 3 * LTimeMs );
+        CHECK( lErr < lErrTwoPoint );
+    }
+
+    TEST( RegressionOutlier )
+    {
+        RegressionEstimator target;
+        ClockEstimator::Estimate grEstimate;
+        for( XTimePoint x = 0; x < 2000; x += 100 )
+            target.addSample( TimePoint( x, ideal( x ) ) );
+        // status delayed by 20 ms
+        CHECK_EQUAL( ClockEstimator::ES_OUTLIER, target.addSample( TimePoint( 2000, ideal( 2000 ) + 20 * LTimeMs ) ) );
+        CHECK( target.getEstimate( grEstimate ) );
+        CHECK_CLOSE( predict( grEstimate, 3000 ), ideal( 3000 ), 2 );
+        CHECK_EQUAL( ClockEstimator::ES_ACCEPTED, target.addSample( TimePoint( 2100, ideal( 2100 ) ) ) );
+    }
+
+    TEST( RegressionRestart )
+    {
+        RegressionEstimator target;
+        ClockEstimator::Estimate grEstimate;
+        for( XTimePoint x = 0; x < 2000; x += 100 )
+            target.addSample( TimePoint( x, ideal( x ) ) );
+        // local clock stepped by 50 ms: the fit is restarted after some rejections
+        bool fAccepted = false;
+        for( XTimePoint x = 2000; x < 3000; x += 100 )
+            fAccepted = target.addSample( TimePoint( x, ideal( x ) + 50 * LTimeMs ) ) == ClockEstimator::ES_ACCEPTED;
+        CHECK( fAccepted );
+        CHECK( target.getEstimate( grEstimate ) );
+        CHECK_CLOSE( predict( grEstimate, 4000 ), ideal( 4000 ) + 50 * LTimeMs, 2 );
+    }
+
+    TEST( RegressionReset )
+    {
+        RegressionEstimator target;
+        ClockEstimator::Estimate grEstimate;
+        target.addSample( TimePoint( 0, ideal( 0 ) ) );
+        target.addSample( TimePoint( 100, ideal( 100 ) ) );
+        CHECK( target.getEstimate( grEstimate ) );
+        target.reset();
+        CHECK( !target.getEstimate( grEstimate ) );
+        CHECK_EQUAL( ClockEstimator::ES_ACCEPTED, target.addSample( TimePoint( 0, ideal( 0 ) ) ) );
+    }
+}
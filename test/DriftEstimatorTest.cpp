@@ -0,0 +1,106 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for class DriftEstimator
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "DriftEstimator.h"
+
+SUITE(DriftEstimatorTest)
+{
+    // sound card 50 ppm slower than the host clock
+    static const LTimePoint lRate = LTimeMs + 50;
+
+    TEST( Invalid )
+    {
+        DriftEstimator target;
+        CHECK( !target.isValid() );
+        CHECK_EQUAL( target.getPpm(), 0 );
+        CHECK_EQUAL( target.getSlopeFixed(), TimeModel().getSlopeFixed() );
+    }
+
+    TEST( AcrossSegments )
+    {
+        DriftEstimator target;
+        LTimePoint lOffset = 0;
+        // songs of 20 s with a pause of 3 s in between
+        for( int iSong = 0; iSong < 3; ++iSong )
+        {
+            target.beginSegment( TimePoint( 0, lOffset ) );
+            for( XTimePoint x = 100; x <= 20000; x += 100 )
+                target.update( TimePoint( x, lOffset + x * lRate ) );
+            lOffset += 20000 * lRate + 3000 * LTimeMs;
+            // the second song completes the required span
+            CHECK_EQUAL( target.isValid(), iSong > 0 );
+        }
+        CHECK_CLOSE( target.getPpm(), 50.0, 1e-6 );
+        CHECK_EQUAL( target.getSpan(), 60000 );
+    }
+
+    TEST( ShortSegmentsIgnored )
+    {
+        DriftEstimator target;
+        for( int i = 0; i < 100; ++i )
+        {
+            target.beginSegment( TimePoint( 0, 0 ) );
+            // 1 s with 2 ms jitter
+            target.update( TimePoint( 1000, 1000 * LTimeMs + 2 * LTimeMs ) );
+        }
+        CHECK( !target.isValid() );
+    }
+
+    TEST( Horizon )
+    {
+        DriftEstimator target;
+        // a long time at +100 ppm, then long enough at +50 ppm to dominate
+        target.beginSegment( TimePoint( 0, 0 ) );
+        target.update( TimePoint( 12 * 3600 * 1000, 12LL * 3600 * 1000 * ( LTimeMs + 100 ) ) );
+        target.beginSegment( TimePoint( 0, 0 ) );
+        target.update( TimePoint( 6 * 3600 * 1000, 6LL * 3600 * 1000 * lRate ) );
+        target.beginSegment( TimePoint( 0, 0 ) );
+        CHECK_CLOSE( target.getPpm(), 75.0, 1e-6 );
+    }
+
+    TEST( Persist )
+    {
+        char szFile[] = "/tmp/DriftEstimatorTestXXXXXX";
+        int fd = mkstemp( szFile );
+        CHECK( fd >= 0 );
+        close( fd );
+        CHECK( DriftEstimator::save( szFile, 12.5 ) );
+
+        DriftEstimator target;
+        CHECK( target.load( szFile ) );
+        CHECK( target.isValid() );
+        CHECK_CLOSE( target.getPpm(), 12.5, 1e-6 );
+
+        // the prior is outweighed by new playback
+        target.beginSegment( TimePoint( 0, 0 ) );
+        target.update( TimePoint( 5400000, 5400000LL * lRate ) );
+        CHECK_CLOSE( target.getPpm(), 50 - 37.5 / 10, 1e-6 );
+
+        std::remove( szFile );
+        CHECK( !target.load( szFile ) );
+    }
+}
@@ -22,11 +22,92 @@
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <unittest++/UnitTest++.h>
 
 #include "Exchange.h"
 
+/**
+ * @brief   Checks shared by all exchange policies
+ *
+ * Target is the Exchange under test, make( x ) builds a message whose member x is x.
+ */
+namespace ExchangeChecks
+{
+    template<class Target, class Make>
+    void constructorReady( Make make )
+    {
+        Target target( make( 42 ) );
+
+        // state should be ready => no lock
+        CHECK_EQUAL( target.read().x, 42 );
+    }
+
+    template<class Target, class Make>
+    void constructorNotReady( Make make )
+    {
+        Target target( make( 43 ), false );
+        // now we should block, so create a thread to unblock
+        std::thread thread( [&] ( )
+                {
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+                    target.write( make( 44 ) );
+                }
+            );
+
+        CHECK_EQUAL( target.read().x, 44 ); // if we get 43 we got something old
+        thread.join();
+    }
+
+    template<class Target, class Make>
+    void writeReadyFlag( Make make )
+    {
+        Target target;
+        CHECK_EQUAL( target.write( make( 0 ) ), false );
+        CHECK_EQUAL( target.write( make( 0 ) ), true );
+        target.read();
+        CHECK_EQUAL( target.write( make( 0 ) ), false );
+    }
+
+    template<class Target, class Make>
+    void readNonblockingRepeats( Make make )
+    {
+        Target target;
+        // must not block, but return the last message again
+        target.write( make( 1 ) );
+        target.read();
+        CHECK_EQUAL( target.read( false ).x, 1 );
+    }
+
+    template<class Target, class Make>
+    void readUntil( Make make )
+    {
+        Target target;
+        auto data = make( 0 );
+
+        // nothing written => timeout
+        std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+        CHECK( !target.readUntil( data, t + std::chrono::milliseconds( 10 ) ) );
+        CHECK( std::chrono::steady_clock::now() - t >= std::chrono::milliseconds( 10 ) );
+        CHECK_EQUAL( data.x, 0 );
+
+        // deadline passed already => do not block
+        CHECK( !target.readUntil( data, t ) );
+
+        // a message written meanwhile is returned before the deadline
+        std::thread thread( [&] ( )
+                {
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+                    target.write( make( 5 ) );
+                }
+            );
+        CHECK( target.readUntil( data, std::chrono::steady_clock::now() + std::chrono::seconds( 1 ) ) );
+        CHECK_EQUAL( data.x, 5 );
+        thread.join();
+    }
+}
+
 SUITE(ExchangeTest)
 {
     class A
@@ -152,7 +233,217 @@ SUITE(ExchangeTest)
         thread2.join();
     }
 
+    A makeA( int x )
+    {
+        return A{ x };
+    }
+
+    TEST(ReadUntil)
+    {
+        UNITTEST_TIME_CONSTRAINT(100);
+        ExchangeChecks::readUntil< Exchange<A> >( makeA );
+    }
+
+
+}
+
+SUITE(SeqLockExchangeTest)
+{
+    struct C
+    {
+        int x;
+        int y;
+    };
+
+    typedef Exchange<C, SeqLockExchangePolicy> Target;
+
+    struct Fixture
+    {
+        Target target;
+    };
+
+    C makeC( int x )
+    {
+        return C{ x, 0 };
+    }
+
+    TEST(ExplicitContructor1)
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        ExchangeChecks::constructorReady<Target>( makeC );
+    }
+
+    TEST(ExplicitContructor2)
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        ExchangeChecks::constructorNotReady<Target>( makeC );
+    }
+
+    TEST(WriteReadyFlag) // test return value of write
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        ExchangeChecks::writeReadyFlag<Target>( makeC );
+    }
+
+    TEST(ReadNonblocking)
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        ExchangeChecks::readNonblockingRepeats<Target>( makeC );
+    }
+
+    TEST(ReadUntil)
+    {
+        UNITTEST_TIME_CONSTRAINT(100);
+        ExchangeChecks::readUntil<Target>( makeC );
+    }
+
+    TEST_FIXTURE( Fixture, NoTornReads )
+    {
+        UNITTEST_TIME_CONSTRAINT(500);
+        const int cMsg = 100000;
+        std::thread thread( [&] ( )
+                {
+                    for( int i = 1; i <= cMsg; ++i )
+                        target.write( C{ i, -i } );
+                }
+            );
+
+        // messages may be skipped, but must never be torn or go back in time
+        int xLast = 0;
+        while( xLast < cMsg )
+        {
+            C c = target.read();
+            CHECK_EQUAL( c.x, -c.y );
+            CHECK( c.x > xLast );
+            xLast = c.x;
+        }
+        thread.join();
+    }
+}
 
+SUITE(QueueExchangeTest)
+{
+    struct D
+    {
+        int iKind; // messages of same kind may be merged
+        int x;
+    };
 }
 
+template<>
+struct ExchangeTraits<SuiteQueueExchangeTest::D>
+{
+    static const unsigned int                   cQueue = 4;
+
+    static bool coalesce( const SuiteQueueExchangeTest::D& older, const SuiteQueueExchangeTest::D& newer )
+    {
+        return older.iKind == newer.iKind;
+    }
+};
 
+SUITE(QueueExchangeTest)
+{
+    typedef Exchange<D, QueueExchangePolicy> Target;
+
+    struct Fixture
+    {
+        Target target;
+    };
+
+    D makeD( int x )
+    {
+        return D{ 0, x };
+    }
+
+    TEST(ExplicitContructor1)
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        ExchangeChecks::constructorReady<Target>( makeD );
+    }
+
+    TEST(ExplicitContructor2)
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        ExchangeChecks::constructorNotReady<Target>( makeD );
+    }
+
+    TEST(WriteReadyFlag) // test return value of write
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        ExchangeChecks::writeReadyFlag<Target>( makeD );
+    }
+
+    TEST(ReadNonblocking)
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        ExchangeChecks::readNonblockingRepeats<Target>( makeD );
+    }
+
+    TEST(ReadUntil)
+    {
+        UNITTEST_TIME_CONSTRAINT(100);
+        ExchangeChecks::readUntil<Target>( makeD );
+    }
+
+    TEST_FIXTURE( Fixture, Coalesce )
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        target.write( D{ 0, 1 } );
+        target.write( D{ 0, 2 } ); // merged
+        target.write( D{ 1, 3 } );
+        target.write( D{ 0, 4 } );
+        target.write( D{ 0, 5 } ); // merged
+
+        CHECK_EQUAL( target.read().x, 2 );
+        CHECK_EQUAL( target.read().x, 3 );
+        CHECK_EQUAL( target.read().x, 5 );
+        CHECK_EQUAL( target.read( false ).x, 5 ); // queue empty
+        CHECK_EQUAL( target.getCoalesced(), 2UL );
+        CHECK_EQUAL( target.getDropped(), 0UL );
+    }
+
+    TEST_FIXTURE( Fixture, Overflow )
+    {
+        UNITTEST_TIME_CONSTRAINT(50);
+        for( int i = 0; i < 6; ++i )
+            target.write( D{ i, i } );
+
+        // the newest message replaces the last queued one if the queue is full
+        CHECK_EQUAL( target.getDropped(), 2UL );
+        CHECK_EQUAL( target.read().x, 0 );
+        CHECK_EQUAL( target.read().x, 1 );
+        CHECK_EQUAL( target.read().x, 2 );
+        CHECK_EQUAL( target.read().x, 5 );
+    }
+
+    TEST_FIXTURE( Fixture, InOrderConcurrent )
+    {
+        UNITTEST_TIME_CONSTRAINT(500);
+        const int cMsg = 100000;
+        std::atomic<int> iKindRead( 0 );
+        std::thread thread( [&] ( )
+                {
+                    for( int i = 1; i <= cMsg; ++i )
+                    {
+                        // kind changes every 10 messages; never queue more kinds than slots
+                        while( i / 10 - iKindRead.load() > 2 )
+                            std::this_thread::yield();
+                        target.write( D{ i / 10, i } );
+                    }
+                }
+            );
+
+        // messages of one kind may be merged, but no kind must be lost
+        int xLast = 0;
+        while( xLast < cMsg )
+        {
+            D d = target.read();
+            CHECK( d.x > xLast );
+            CHECK( d.iKind == iKindRead.load() || d.iKind == iKindRead.load() + 1 );
+            xLast = d.x;
+            iKindRead.store( d.iKind );
+        }
+        CHECK_EQUAL( target.getDropped(), 0UL );
+        thread.join();
+    }
+}
@@ -0,0 +1,80 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for class Lookahead
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include "Lookahead.h"
+
+SUITE(LookaheadTest)
+{
+    struct Fixture
+    {
+        Fixture() : target( 20 * LTimeMs, 150 * LTimeMs ) {}
+
+        // planned wakeup observed with the given lateness
+        void observe( LTimePoint lLateness )
+        {
+            target.observe( lLateness, target.get() - lLateness );
+        }
+
+        Lookahead target;
+    };
+
+    TEST_FIXTURE( Fixture, StartAtMax )
+    {
+        CHECK_EQUAL( target.get(), 150 * LTimeMs );
+    }
+
+    TEST_FIXTURE( Fixture, DecayToMin )
+    {
+        for( int i = 0; i < 1000; ++i )
+            observe( LTimeMs / 2 );
+        CHECK_EQUAL( target.get(), 20 * LTimeMs );
+    }
+
+    TEST_FIXTURE( Fixture, Attack )
+    {
+        for( int i = 0; i < 1000; ++i )
+            observe( 0 );
+        // a single late wakeup raises the lookahead at once
+        observe( 30 * LTimeMs );
+        CHECK_EQUAL( target.get(), Lookahead::cHeadroom * 30 * LTimeMs + Lookahead::cMargin );
+        // and it decays slowly
+        observe( 0 );
+        CHECK( target.get() > 60 * LTimeMs );
+    }
+
+    TEST_FIXTURE( Fixture, Underrun )
+    {
+        for( int i = 0; i < 1000; ++i )
+            observe( 0 );
+        // queue ran dry although the wakeup was on time
+        target.observe( 0, -80 * LTimeMs );
+        CHECK_EQUAL( target.get(), 150 * LTimeMs );
+    }
+
+    TEST( Bounds )
+    {
+        Lookahead target( 50 * LTimeMs, 10 * LTimeMs );
+        target.observe( 0, 0 );
+        CHECK_EQUAL( target.get(), 50 * LTimeMs );
+    }
+}
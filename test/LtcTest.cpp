@@ -0,0 +1,362 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for the LTC renderer, by decoding the rendered samples
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "LtcRenderer.h"
+#include "LtcSink.h"
+#include "Config.h"
+
+SUITE(LtcTest)
+{
+    // bi-phase mark decoder: level changes one half bit apart make a 1, a full bit a 0;
+    // silence separates streams
+    struct Decoder
+    {
+        int cHalf; // nominal half bit length in samples
+        int cRun;
+        int iLevel; // -1, 0 (silence), 1
+        bool fHalf; // first half of a 1 seen
+        uint64_t lWindow; // 64 bits before the last 16
+        uint16_t wSyncWindow; // last 16 bits
+        int cBitsSinceSync;
+        std::vector<BSDTime> rgFrames;
+
+        Decoder( int cFrameSamples ) : cHalf( cFrameSamples / 160 ), cRun( 0 ), iLevel( 0 ),
+            fHalf( false ), lWindow( 0 ), wSyncWindow( 0 ), cBitsSinceSync( 0 ) {}
+
+        void bit( bool f )
+        {
+            // bits enter at the top, so the oldest one ends up in the least significant position
+            lWindow = ( lWindow >> 1 ) | ( static_cast<uint64_t>( wSyncWindow & 1 ) << 63 );
+            wSyncWindow = ( wSyncWindow >> 1 ) | ( f ? 0x8000 : 0 );
+            ++cBitsSinceSync;
+            if( wSyncWindow == LtcRenderer::wSync && cBitsSinceSync >= 80 )
+            {
+                BSDTime grBSD;
+                grBSD.frame = ( lWindow & 0x0F ) + 10 * ( ( lWindow >> 8 ) & 0x03 );
+                grBSD.second = ( ( lWindow >> 16 ) & 0x0F ) + 10 * ( ( lWindow >> 24 ) & 0x07 );
+                grBSD.minute = ( ( lWindow >> 32 ) & 0x0F ) + 10 * ( ( lWindow >> 40 ) & 0x07 );
+                grBSD.hour = ( ( lWindow >> 48 ) & 0x0F ) + 10 * ( ( lWindow >> 56 ) & 0x03 );
+                rgFrames.push_back( grBSD );
+                cBitsSinceSync = 0;
+            }
+        }
+
+        // a run of one level ended with an edge
+        void run()
+        {
+            if( cRun < cHalf * 3 / 2 )
+            {
+                if( fHalf )
+                    bit( true );
+                fHalf = !fHalf;
+            } else
+            {
+                fHalf = false;
+                bit( false );
+            }
+        }
+
+        void feed( const int16_t* rgs, int c )
+        {
+            for( int i = 0; i < c; ++i )
+            {
+                int iSample = rgs[ i ] > 0 ? 1 : ( rgs[ i ] < 0 ? -1 : 0 );
+                if( iSample == iLevel )
+                {
+                    ++cRun;
+                    continue;
+                }
+                if( iLevel != 0 )
+                    run();
+                if( iSample == 0 )
+                {
+                    fHalf = false;
+                    cBitsSinceSync = 0;
+                }
+                iLevel = iSample;
+                cRun = 1;
+            }
+        }
+
+        // the end of the samples completes the last bit
+        void flush()
+        {
+            if( iLevel != 0 )
+                run();
+            iLevel = 0;
+        }
+    };
+
+    static BSDTime bsd( int h, int m, int s, int f )
+    {
+        BSDTime grBSD;
+        grBSD.hour = h;
+        grBSD.minute = m;
+        grBSD.second = s;
+        grBSD.frame = f;
+        return grBSD;
+    }
+
+    static void checkLabel( const BSDTime& grActual, const BSDTime& grExpected )
+    {
+        CHECK_EQUAL( (int)grActual.hour, grExpected.hour & 0x1F );
+        CHECK_EQUAL( (int)grActual.minute, (int)grExpected.minute );
+        CHECK_EQUAL( (int)grActual.second, (int)grExpected.second );
+        CHECK_EQUAL( (int)grActual.frame, (int)grExpected.frame );
+    }
+
+    TEST( RoundTrip )
+    {
+        LtcRenderer target( FrameRate25::bRate );
+        MtcEncoderT<FrameRate25> grFrames;
+        Decoder grDecoder( 1920 );
+        int16_t rgs[ LtcRenderer::cMaxFrameSamples + LtcRenderer::cLanes ];
+        int iFirst = 25 * ( 3600 * 12 + 60 * 34 + 56 ) + 20;
+        for( int i = 0; i < 10; ++i )
+        {
+            int c = target.render( grFrames.bsdTime( iFirst + i ), rgs );
+            CHECK_EQUAL( c, 1920 );
+            // every frame starts with a rising edge
+            CHECK( rgs[ 0 ] > 0 );
+            grDecoder.feed( rgs, c );
+        }
+        grDecoder.flush();
+        CHECK_EQUAL( static_cast<int>( grDecoder.rgFrames.size() ), 10 );
+        for( unsigned int i = 0; i < grDecoder.rgFrames.size(); ++i )
+            checkLabel( grDecoder.rgFrames[ i ], grFrames.bsdTime( iFirst + i ) );
+    }
+
+    TEST( Flags )
+    {
+        LtcRenderer target25( FrameRate25::bRate );
+        LtcRenderer target2997( FrameRate2997::bRate );
+        for( int f = 0; f < 25; ++f )
+        {
+            BSDTime grBSD = bsd( 1, 2, 3, f );
+            uint64_t l = target25.encode( grBSD );
+            CHECK_EQUAL( ( __builtin_popcountll( l ) + __builtin_popcount( LtcRenderer::wSync ) ) % 2, 0 );
+            CHECK( !( l & ( 1ULL << 10 ) ) );
+            CHECK( !( l & ( 1ULL << 27 ) ) );
+            l = target2997.encode( grBSD );
+            CHECK_EQUAL( ( __builtin_popcountll( l ) + __builtin_popcount( LtcRenderer::wSync ) ) % 2, 0 );
+            CHECK( l & ( 1ULL << 10 ) );
+            CHECK( !( l & ( 1ULL << 59 ) ) );
+        }
+    }
+
+    TEST( FractionalRate )
+    {
+        // 29.97 fps: 1601.6 samples per frame on average
+        LtcRenderer target( FrameRate2997::bRate );
+        int16_t rgs[ LtcRenderer::cMaxFrameSamples + LtcRenderer::cLanes ];
+        int c = 0;
+        for( int i = 0; i < 5; ++i )
+        {
+            int cFrame = target.render( bsd( 0, 0, 0, i ), rgs );
+            CHECK( cFrame == 1601 || cFrame == 1602 );
+            c += cFrame;
+        }
+        CHECK_EQUAL( c, 8008 );
+    }
+
+    TEST( HourOffline )
+    {
+        UNITTEST_TIME_CONSTRAINT( 2000 );
+        LtcRenderer target( FrameRate30::bRate );
+        MtcEncoderT<FrameRate30> grFrames;
+        std::vector<int16_t> rgs( 64 * LtcRenderer::cMaxFrameSamples + LtcRenderer::cLanes );
+        int64_t c = 0;
+        int iFrame = 0;
+        // one hour rendered in blocks of 64 frames
+        while( iFrame < 30 * 3600 )
+        {
+            int cBlock = 0;
+            for( int i = 0; i < 64 && iFrame < 30 * 3600; ++i )
+                cBlock += target.render( grFrames.bsdTime( iFrame++ ), &rgs[ cBlock ] );
+            c += cBlock;
+            if( iFrame == 30 * 3600 )
+            {
+                Decoder grDecoder( 1600 );
+                grDecoder.feed( &rgs[ 0 ], cBlock );
+                grDecoder.flush();
+                CHECK_EQUAL( static_cast<int>( grDecoder.rgFrames.size() ), 30 * 3600 % 64 );
+                checkLabel( grDecoder.rgFrames.back(), grFrames.bsdTime( iFrame - 1 ) );
+            }
+        }
+        CHECK_EQUAL( c, 3600LL * LtcRenderer::cSampleRate );
+    }
+
+    TEST( SinkPlacesFrames )
+    {
+        char szPath[] = "/tmp/ltctestXXXXXX";
+        int fd = mkstemp( szPath );
+        CHECK( fd >= 0 );
+        close( fd );
+        {
+            LtcSink target( szPath, FrameRate25::bRate );
+            target.frame( bsd( 0, 0, 1, 0 ), 1000 * LTimeMs );
+            target.frame( bsd( 0, 0, 1, 1 ), 1040 * LTimeMs );
+            // paused for 100 ms
+            target.silenceUntil( 1180 * LTimeMs );
+            target.frame( bsd( 0, 0, 1, 5 ), 1200 * LTimeMs );
+            CHECK_EQUAL( target.getSamples(), 200 * 48 + 1920 );
+            CHECK_EQUAL( target.getDropped(), 0 );
+        }
+        FILE* pf = std::fopen( szPath, "rb" );
+        std::vector<int16_t> rgs( 200 * 48 + 1920 );
+        CHECK_EQUAL( std::fread( &rgs[ 0 ], 2, rgs.size(), pf ), rgs.size() );
+        std::fclose( pf );
+        std::remove( szPath );
+        for( int i = 80 * 48; i < 200 * 48; ++i )
+            CHECK_EQUAL( rgs[ i ], 0 );
+
+        Decoder grDecoder( 1920 );
+        grDecoder.feed( &rgs[ 0 ], rgs.size() );
+        grDecoder.flush();
+        CHECK_EQUAL( static_cast<int>( grDecoder.rgFrames.size() ), 3 );
+        checkLabel( grDecoder.rgFrames[ 2 ], bsd( 0, 0, 1, 5 ) );
+    }
+
+    TEST( SinkWav )
+    {
+        char szPath[] = "/tmp/ltctestXXXXXX.wav";
+        int fd = mkstemps( szPath, 4 );
+        CHECK( fd >= 0 );
+        close( fd );
+        {
+            LtcSink target( szPath, FrameRate24::bRate );
+            target.frame( bsd( 0, 0, 0, 0 ), 1000 * LTimeMs );
+        }
+        FILE* pf = std::fopen( szPath, "rb" );
+        unsigned char rgb[ 44 ];
+        CHECK_EQUAL( std::fread( rgb, 1, 44, pf ), 44u );
+        std::fseek( pf, 0, SEEK_END );
+        long cb = std::ftell( pf );
+        std::fclose( pf );
+        std::remove( szPath );
+        CHECK_EQUAL( cb, 44 + 2000 * 2 );
+        CHECK( std::equal( rgb, rgb + 4, "RIFF" ) );
+        CHECK_EQUAL( rgb[ 40 ] | ( rgb[ 41 ] << 8 ), 4000 );
+        CHECK_EQUAL( rgb[ 24 ] | ( rgb[ 25 ] << 8 ) | ( rgb[ 26 ] << 16 ), 48000 );
+    }
+
+    TEST( SinkDropKeepsTime )
+    {
+        // nobody reads the pipe at first, so the writer thread blocks and the ring overflows
+        int rgfd[ 2 ];
+        CHECK_EQUAL( pipe( rgfd ), 0 );
+        std::vector<int16_t> rgs;
+        std::thread thReader;
+        {
+            LtcSink target( "/dev/fd/" + std::to_string( rgfd[ 1 ] ), FrameRate25::bRate );
+            for( int i = 0; i < 200; ++i )
+                target.frame( bsd( 0, 0, i / 25, i % 25 ), ( 1000 + 40 * i ) * LTimeMs );
+            CHECK( target.getDropped() > 0 );
+
+            thReader = std::thread( [&] ( )
+                    {
+                        int16_t rgsBuf[ 4096 ];
+                        ssize_t cb;
+                        while( ( cb = read( rgfd[ 0 ], rgsBuf, sizeof( rgsBuf ) ) ) > 0 )
+                            rgs.insert( rgs.end(), rgsBuf, rgsBuf + cb / 2 );
+                    }
+                );
+            std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+            // the ring has room again: the dropped blocks become silence first
+            for( int i = 200; i < 210; ++i )
+                target.frame( bsd( 0, 0, i / 25, i % 25 ), ( 1000 + 40 * i ) * LTimeMs );
+        }
+        close( rgfd[ 1 ] );
+        thReader.join();
+        close( rgfd[ 0 ] );
+
+        CHECK_EQUAL( rgs.size(), 210u * 1920 );
+        if( rgs.size() != 210u * 1920 )
+            return;
+        Decoder grDecoder( 1920 );
+        grDecoder.feed( &rgs[ 200 * 1920 ], 10 * 1920 );
+        grDecoder.flush();
+        CHECK_EQUAL( static_cast<int>( grDecoder.rgFrames.size() ), 10 );
+        if( grDecoder.rgFrames.size() == 10 )
+            checkLabel( grDecoder.rgFrames[ 0 ], bsd( 0, 0, 8, 0 ) );
+    }
+
+    TEST( SinkStdout )
+    {
+        // a child process shares its stdout between messages and samples like the program
+        char szPath[] = "/tmp/ltctestXXXXXX";
+        int fd = mkstemp( szPath );
+        CHECK( fd >= 0 );
+        std::cout.flush();
+        std::fflush( stdout );
+        pid_t pid = fork();
+        CHECK( pid >= 0 );
+        if( pid == 0 )
+        {
+            dup2( fd, STDOUT_FILENO );
+            int fdNull = open( "/dev/null", O_WRONLY );
+            dup2( fdNull, STDERR_FILENO );
+            const char* rgszArg[] = { "x2mm", "-v", "-d", "0", "-f", "pal", "--ltc", "-" };
+            Config config( 8, const_cast<char**>( rgszArg ) );
+            std::cout << "Version: x" << std::endl;
+            {
+                LtcSink target( "-", FrameRate25::bRate );
+                target.frame( bsd( 0, 0, 1, 0 ), 1000 * LTimeMs );
+                std::cout << "Stop." << std::endl;
+                target.frame( bsd( 0, 0, 1, 1 ), 1040 * LTimeMs );
+            }
+            std::cout.flush();
+            std::fflush( stdout );
+            _exit( 0 );
+        }
+        close( fd );
+        int iStatus = -1;
+        CHECK_EQUAL( waitpid( pid, &iStatus, 0 ), pid );
+        CHECK( WIFEXITED( iStatus ) && WEXITSTATUS( iStatus ) == 0 );
+
+        FILE* pf = std::fopen( szPath, "rb" );
+        std::vector<int16_t> rgs( 2 * 1920 + 1 );
+        CHECK_EQUAL( std::fread( &rgs[ 0 ], 2, rgs.size(), pf ), 2u * 1920 );
+        std::fclose( pf );
+        std::remove( szPath );
+        rgs.pop_back();
+
+        Decoder grDecoder( 1920 );
+        grDecoder.feed( &rgs[ 0 ], rgs.size() );
+        grDecoder.flush();
+        CHECK_EQUAL( static_cast<int>( grDecoder.rgFrames.size() ), 2 );
+        if( grDecoder.rgFrames.size() == 2 )
+            checkLabel( grDecoder.rgFrames[ 1 ], bsd( 0, 0, 1, 1 ) );
+    }
+}
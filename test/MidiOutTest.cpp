@@ -0,0 +1,239 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for the MIDI output backends: batching of short messages, and the ALSA
+ *          sequencer backend against a local sequencer client if there is a sequencer
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include "MidiOut.h"
+
+SUITE(MidiOutTest)
+{
+    // records the submitted messages in order, a SysEx message as 0xF0
+    class FakeOut : public BatchedMidiOut
+    {
+        public:
+            std::vector<int> rgcBatch; // size of each submission, 0 for SysEx
+            std::vector<MidiMsg> rgMsg;
+            bool fFail;
+
+            FakeOut() : fFail( false ) {}
+
+            virtual const char* getError() const
+            {
+                return "failed";
+            }
+
+        protected:
+            virtual bool submit( PmEvent* rgEvent, int cEvent )
+            {
+                rgcBatch.push_back( cEvent );
+                for( int i = 0; i < cEvent; ++i )
+                    rgMsg.push_back( rgEvent[ i ].message );
+                return !fFail;
+            }
+
+            virtual bool submitSysEx( LTimePoint when, const MidiByte* rgbMsg )
+            {
+                rgcBatch.push_back( 0 );
+                rgMsg.push_back( rgbMsg[ 0 ] );
+                return true;
+            }
+    };
+
+    const MidiByte rgbSysEx[] = { 0xF0, 0x7F, 0x7F, 0x06, 0x01, 0xF7 };
+
+    TEST(BatchUntilFlush)
+    {
+        FakeOut grOut;
+        for( int i = 0; i < 10; ++i )
+            CHECK( grOut.writeShort( 0, 0xF8 + i ) );
+        CHECK( grOut.rgcBatch.empty() );
+        CHECK( grOut.flush() );
+        CHECK_EQUAL( 1u, grOut.rgcBatch.size() );
+        CHECK_EQUAL( 10, grOut.rgcBatch[ 0 ] );
+        for( int i = 0; i < 10; ++i )
+            CHECK_EQUAL( static_cast<MidiMsg>( 0xF8 + i ), grOut.rgMsg[ i ] );
+        // nothing left to submit
+        CHECK( grOut.flush() );
+        CHECK_EQUAL( 1u, grOut.rgcBatch.size() );
+    }
+
+    TEST(FullBatch)
+    {
+        FakeOut grOut;
+        for( int i = 0; i < BatchedMidiOut::cBatch; ++i )
+            grOut.writeShort( 0, 0xF8 );
+        CHECK( grOut.rgcBatch.empty() );
+        grOut.writeShort( 0, 0xFA );
+        CHECK_EQUAL( 1u, grOut.rgcBatch.size() );
+        CHECK_EQUAL( BatchedMidiOut::cBatch, grOut.rgcBatch[ 0 ] );
+        grOut.flush();
+        CHECK_EQUAL( 2u, grOut.rgcBatch.size() );
+        CHECK_EQUAL( 1, grOut.rgcBatch[ 1 ] );
+        CHECK_EQUAL( static_cast<MidiMsg>( 0xFA ), grOut.rgMsg.back() );
+    }
+
+    TEST(SysExAfterBatch)
+    {
+        FakeOut grOut;
+        grOut.writeShort( 0, 0xF8 );
+        grOut.writeShort( 0, 0xF8 );
+        CHECK( grOut.writeSysEx( 0, rgbSysEx ) );
+        grOut.writeShort( 0, 0xFC );
+        grOut.flush();
+        const int rgcExpected[] = { 2, 0, 1 };
+        CHECK_EQUAL( 3u, grOut.rgcBatch.size() );
+        CHECK_ARRAY_EQUAL( rgcExpected, grOut.rgcBatch, 3 );
+        const MidiMsg rgExpected[] = { 0xF8, 0xF8, 0xF0, 0xFC };
+        CHECK_ARRAY_EQUAL( rgExpected, grOut.rgMsg, 4 );
+    }
+
+    TEST(Errors)
+    {
+        FakeOut grOut;
+        grOut.fFail = true;
+        for( int i = 0; i < BatchedMidiOut::cBatch; ++i )
+            CHECK( grOut.writeShort( 0, 0xF8 ) );
+        // the failure of the full batch is reported by the write starting the next one
+        CHECK( !grOut.writeShort( 0, 0xF8 ) );
+        CHECK( !grOut.flush() );
+        CHECK( grOut.flush() ); // the failed batch is not submitted again
+        grOut.writeShort( 0, 0xF8 );
+        CHECK( !grOut.writeSysEx( 0, rgbSysEx ) );
+        CHECK_EQUAL( 0, grOut.rgcBatch.back() ); // sent anyway
+    }
+
+#ifdef HAVE_ALSA
+    // local sequencer client receiving the output of the backend
+    struct AlsaReceiver
+    {
+        snd_seq_t* hSeq;
+        int iPort;
+
+        AlsaReceiver() : hSeq( 0 ), iPort( -1 )
+        {
+            if( snd_seq_open( &hSeq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK ) < 0 )
+            {
+                hSeq = 0;
+                return;
+            }
+            iPort = snd_seq_create_simple_port( hSeq, "x2mm test",
+                    SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+                    SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION );
+        }
+
+        ~AlsaReceiver()
+        {
+            if( hSeq )
+                snd_seq_close( hSeq );
+        }
+
+        // sequencer address of the port
+        std::string address() const
+        {
+            std::ostringstream ss;
+            ss << snd_seq_client_id( hSeq ) << ":" << iPort;
+            return ss.str();
+        }
+
+        // wait up to a second for the next event, returns null on timeout
+        snd_seq_event_t* receive( LTimePoint& lReceived )
+        {
+            LTimePoint lTimeout = Now() + 1000 * LTimeMs;
+            snd_seq_event_t* pgrEvent = 0;
+            while( snd_seq_event_input( hSeq, &pgrEvent ) == -EAGAIN )
+            {
+                if( Now() > lTimeout )
+                    return 0;
+                std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+            }
+            lReceived = Now();
+            return pgrEvent;
+        }
+    };
+
+    static void checkEvents( AlsaReceiver& grReceiver, LTimePoint lEarliest, LTimePoint lLatest )
+    {
+        LTimePoint lReceived = 0;
+        snd_seq_event_t* pgrEvent = grReceiver.receive( lReceived );
+        CHECK( pgrEvent );
+        if( !pgrEvent )
+            return;
+        CHECK_EQUAL( SND_SEQ_EVENT_NOTEON, pgrEvent->type );
+        CHECK_EQUAL( 0, pgrEvent->data.note.channel );
+        CHECK_EQUAL( 0x3C, pgrEvent->data.note.note );
+        CHECK_EQUAL( 0x40, pgrEvent->data.note.velocity );
+        CHECK( lReceived >= lEarliest );
+        CHECK( lReceived <= lLatest );
+
+        pgrEvent = grReceiver.receive( lReceived );
+        CHECK( pgrEvent );
+        if( !pgrEvent )
+            return;
+        CHECK_EQUAL( SND_SEQ_EVENT_SYSEX, pgrEvent->type );
+        CHECK_EQUAL( sizeof( rgbSysEx ), pgrEvent->data.ext.len );
+        CHECK_ARRAY_EQUAL( rgbSysEx, static_cast<const MidiByte*>( pgrEvent->data.ext.ptr ),
+                static_cast<int>( sizeof( rgbSysEx ) ) );
+    }
+
+    TEST(AlsaScheduled)
+    {
+        AlsaReceiver grReceiver;
+        if( !grReceiver.hSeq )
+            return; // no sequencer (e.g. snd-seq not loaded), skipped
+        CHECK( grReceiver.iPort >= 0 );
+
+        std::unique_ptr<MidiOut> pgrOut = MidiOut::create( MidiOut::EMO_ALSA, 0, grReceiver.address(), false );
+        // the queue sends the events at their time, not at the flush
+        LTimePoint lSend = Now() + 50 * LTimeMs;
+        CHECK( pgrOut->writeShort( lSend, 0x403C90 ) );
+        CHECK( pgrOut->writeSysEx( lSend, rgbSysEx ) );
+        CHECK( pgrOut->flush() );
+        // the queue time is mapped onto the local time with some jitter
+        checkEvents( grReceiver, lSend - 2 * LTimeMs, lSend + 100 * LTimeMs );
+    }
+
+    TEST(AlsaImmediate)
+    {
+        AlsaReceiver grReceiver;
+        if( !grReceiver.hSeq )
+            return; // no sequencer, skipped
+
+        std::unique_ptr<MidiOut> pgrOut = MidiOut::create( MidiOut::EMO_ALSA, 0, grReceiver.address(), true );
+        // time stamps are ignored in real-time mode
+        LTimePoint lStart = Now();
+        CHECK( pgrOut->writeShort( lStart + 10000 * LTimeMs, 0x403C90 ) );
+        CHECK( pgrOut->writeSysEx( lStart + 10000 * LTimeMs, rgbSysEx ) );
+        CHECK( pgrOut->flush() );
+        checkEvents( grReceiver, lStart, lStart + 100 * LTimeMs );
+    }
+#endif // ifdef HAVE_ALSA
+}
@@ -0,0 +1,72 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for class Mmc
+ */
+
+#include <memory>
+
+#include <unittest++/UnitTest++.h>
+
+#include "Mmc.h"
+#include "Timecode.h"
+
+SUITE(MmcTest)
+{
+    TEST(Command)
+    {
+        const MidiByte rgbExpected[] = { 0xF0, 0x7F, 0x7F, 0x06, 0x01, 0xF7 };
+        MidiByte rgbMsg[ Mmc::cbCommand ];
+        Mmc::command( 0x7F, Mmc::EMMC_STOP, rgbMsg );
+        CHECK_ARRAY_EQUAL( rgbExpected, rgbMsg, static_cast<int>( Mmc::cbCommand ) );
+    }
+
+    TEST(CommandDevice)
+    {
+        MidiByte rgbMsg[ Mmc::cbCommand ];
+        Mmc::command( 0x12, Mmc::EMMC_DEFERRED_PLAY, rgbMsg );
+        CHECK_EQUAL( 0x12, rgbMsg[ 2 ] );
+        CHECK_EQUAL( 0x03, rgbMsg[ 4 ] );
+        Mmc::command( 0x12, Mmc::EMMC_PLAY, rgbMsg );
+        CHECK_EQUAL( 0x02, rgbMsg[ 4 ] );
+    }
+
+    TEST(Locate)
+    {
+        // 25 fps: rate bits 01 in the hour byte
+        BSDTime grBSD = { 0x20 | 1, 2, 3, 4 };
+        const MidiByte rgbExpected[] = { 0xF0, 0x7F, 0x7F, 0x06, 0x44, 0x06, 0x01,
+            0x21, 0x02, 0x03, 0x04, 0x00, 0xF7 };
+        MidiByte rgbMsg[ Mmc::cbLocate ];
+        Mmc::locate( 0x7F, grBSD, rgbMsg );
+        CHECK_ARRAY_EQUAL( rgbExpected, rgbMsg, static_cast<int>( Mmc::cbLocate ) );
+    }
+
+    TEST(LocateMatchesFullFrame)
+    {
+        // the locate target carries the same label as a full frame of the encoder
+        std::unique_ptr<MtcEncoder> pgrMtc = MtcEncoder::create( FrameRate2997::bRate );
+        BSDTime grBSD = pgrMtc->bsdTime( 107892 ); // 1 h of drop-frame time code
+        MidiByte rgbFull[ 10 ];
+        MtcEncoder::fullFrame( grBSD, rgbFull );
+        MidiByte rgbMsg[ Mmc::cbLocate ];
+        Mmc::locate( 0x7F, grBSD, rgbMsg );
+        CHECK_ARRAY_EQUAL( rgbFull + 5, rgbMsg + 7, 4 );
+        CHECK_EQUAL( 0xF7, rgbMsg[ Mmc::cbLocate - 1 ] );
+    }
+}
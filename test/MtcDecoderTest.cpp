@@ -0,0 +1,130 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for the MIDI time code decoder
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include "MtcDecoder.h"
+
+SUITE(MtcDecoderTest)
+{
+    struct Fixture
+    {
+        MtcDecoder target;
+        MtcDecoder::Position grPos;
+        int cPositions;
+
+        Fixture() : cPositions( 0 ) {}
+
+        // feed 8 quarter frames, return the number of decoded positions
+        int feed( MtcEncoder& encoder )
+        {
+            MidiByte rgb[ 8 ];
+            encoder.nextQuarterFrames( rgb );
+            int c = 0;
+            for( int i = 0; i < 8; ++i )
+                if( target.quarterFrame( rgb[ i ], i * LTimeMs, grPos ) )
+                    ++c;
+            return c;
+        }
+    };
+
+    TEST_FIXTURE( Fixture, LockAfterSequence )
+    {
+        MtcEncoderT<FrameRate25> encoder;
+        encoder.seek( 25 * 61 + 4 );
+        CHECK_EQUAL( feed( encoder ), 1 );
+        CHECK( target.isLocked() );
+        CHECK( grPos.fLocate );
+        // piece 7 is sent 7 quarters (10 ms each) after frame 25*61+4 started
+        CHECK_EQUAL( grPos.lUs, ( 25 * 61 + 4 ) * 40000LL + 7 * 10000 );
+
+        CHECK_EQUAL( feed( encoder ), 8 );
+        CHECK( !grPos.fLocate );
+        CHECK_EQUAL( grPos.lUs, ( 25 * 61 + 6 ) * 40000LL + 7 * 10000 );
+    }
+
+    TEST_FIXTURE( Fixture, QuarterResolution )
+    {
+        MtcEncoderT<FrameRate25> encoder;
+        feed( encoder );
+        MidiByte rgb[ 8 ];
+        encoder.nextQuarterFrames( rgb );
+        for( int i = 0; i < 8; ++i )
+        {
+            CHECK( target.quarterFrame( rgb[ i ], 0, grPos ) );
+            CHECK_EQUAL( grPos.lUs, 80000LL + i * 10000 );
+        }
+    }
+
+    TEST_FIXTURE( Fixture, DroppedPiece )
+    {
+        MtcEncoderT<FrameRate25> encoder;
+        feed( encoder );
+        MidiByte rgb[ 8 ];
+        encoder.nextQuarterFrames( rgb );
+        CHECK( target.quarterFrame( rgb[ 0 ], 0, grPos ) );
+        CHECK( !target.quarterFrame( rgb[ 2 ], 0, grPos ) );
+        CHECK( !target.isLocked() );
+        // relocks with the next complete sequence
+        CHECK_EQUAL( feed( encoder ), 1 );
+        CHECK( grPos.fLocate );
+        CHECK_EQUAL( grPos.lUs, 4 * 40000LL + 7 * 10000 );
+    }
+
+    TEST_FIXTURE( Fixture, Jump )
+    {
+        MtcEncoderT<FrameRate25> encoder;
+        feed( encoder );
+        feed( encoder );
+        encoder.seek( 1000 );
+        CHECK_EQUAL( feed( encoder ), 8 );
+        // detected with the label at piece 7
+        CHECK( grPos.fLocate );
+        CHECK_EQUAL( grPos.lUs, 1000 * 40000LL + 7 * 10000 );
+    }
+
+    TEST_FIXTURE( Fixture, FullFrame )
+    {
+        MidiByte rgbMsg[] = { 0xF0, 0x7F, 0x7F, 0x01, 0x01, 0x20 | 1, 2, 3, 4, 0xF7 };
+        CHECK( target.sysEx( rgbMsg, sizeof( rgbMsg ), 0, grPos ) );
+        CHECK( target.isLocked() );
+        CHECK( grPos.fLocate );
+        int iFrame = 25 * 3723 + 4;
+        CHECK_EQUAL( grPos.lUs, iFrame * 40000LL );
+
+        // quarter frames continue at once
+        MtcEncoderT<FrameRate25> encoder;
+        encoder.seek( iFrame );
+        CHECK_EQUAL( feed( encoder ), 8 );
+        CHECK( !grPos.fLocate );
+
+        MidiByte rgbOther[] = { 0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7 };
+        CHECK( !target.sysEx( rgbOther, sizeof( rgbOther ), 0, grPos ) );
+    }
+
+    TEST_FIXTURE( Fixture, RateFromLabel )
+    {
+        MtcEncoderT<FrameRate30> encoder;
+        encoder.seek( 30 * 10 );
+        CHECK_EQUAL( feed( encoder ), 1 );
+        CHECK_EQUAL( grPos.lUs, 10000000LL + 7 * 1000000LL / 120 );
+    }
+}
@@ -0,0 +1,77 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for class RunningStatus
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include "RunningStatus.h"
+
+SUITE(RunningStatusTest)
+{
+    TEST(Length)
+    {
+        CHECK_EQUAL( 2u, RunningStatus::length( 0x00F1 ) );
+        CHECK_EQUAL( 3u, RunningStatus::length( 0x7F3C90 ) );
+        CHECK_EQUAL( 2u, RunningStatus::length( 0x05C0 ) );
+        CHECK_EQUAL( 3u, RunningStatus::length( 0x0000F2 ) );
+        CHECK_EQUAL( 1u, RunningStatus::length( 0xF8 ) );
+    }
+
+    TEST(OmitsRepeatedStatus)
+    {
+        RunningStatus target;
+        CHECK_EQUAL( 3u, target.advance( 0x7F3C90 ) );
+        CHECK_EQUAL( 2u, target.size( 0x7F3D90 ) );
+        CHECK_EQUAL( 2u, target.advance( 0x7F3D90 ) );
+        // another channel
+        CHECK_EQUAL( 3u, target.advance( 0x7F3D91 ) );
+    }
+
+    TEST(QuarterFrameCancels)
+    {
+        RunningStatus target;
+        target.advance( 0x7F3C90 );
+        CHECK_EQUAL( 2u, target.advance( 0x10F1 ) );
+        CHECK_EQUAL( 3u, target.advance( 0x7F3C90 ) );
+    }
+
+    TEST(SysExCancels)
+    {
+        RunningStatus target;
+        target.advance( 0x7F3C90 );
+        target.reset();
+        CHECK_EQUAL( 3u, target.size( 0x7F3C90 ) );
+    }
+
+    TEST(RealTimeKeeps)
+    {
+        RunningStatus target;
+        target.advance( 0x7F3C90 );
+        CHECK_EQUAL( 1u, target.advance( 0xF8 ) );
+        CHECK_EQUAL( 2u, target.advance( 0x7F3C90 ) );
+    }
+
+    TEST(Disabled)
+    {
+        RunningStatus target( false );
+        target.advance( 0x7F3C90 );
+        CHECK_EQUAL( 3u, target.advance( 0x7F3C90 ) );
+    }
+}
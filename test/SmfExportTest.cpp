@@ -0,0 +1,225 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for the Standard MIDI File export
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <vector>
+#include <unistd.h>
+
+#include "SmfExport.h"
+
+SUITE(SmfExportTest)
+{
+    struct Event
+    {
+        int64_t lTick;
+        std::string szBytes;        // as sent (SysEx including F0)
+    };
+
+    static uint32_t readVarLen( const std::string& sz, size_t& i )
+    {
+        uint32_t l = 0;
+        unsigned char b;
+        do
+        {
+            b = sz[ i++ ];
+            l = ( l << 7 ) | ( b & 0x7F );
+        } while( b & 0x80 );
+        return l;
+    }
+
+    static uint32_t readLong( const std::string& sz, size_t i )
+    {
+        return ( (unsigned char)sz[ i ] << 24 ) | ( (unsigned char)sz[ i + 1 ] << 16 ) |
+            ( (unsigned char)sz[ i + 2 ] << 8 ) | (unsigned char)sz[ i + 3 ];
+    }
+
+    // events of the second track; the stream has no running status
+    static std::vector<Event> parse( const std::string& szFile, int& iDivision )
+    {
+        std::vector<Event> rg;
+        CHECK( szFile.compare( 0, 4, "MThd" ) == 0 );
+        CHECK_EQUAL( readLong( szFile, 4 ), 6u );
+        CHECK_EQUAL( (int)szFile[ 9 ], 1 ); // format
+        CHECK_EQUAL( (int)szFile[ 11 ], 2 ); // tracks
+        iDivision = ( (unsigned char)szFile[ 12 ] << 8 ) | (unsigned char)szFile[ 13 ];
+        size_t i = 14;
+        CHECK( szFile.compare( i, 4, "MTrk" ) == 0 );
+        i += 8 + readLong( szFile, i + 4 );
+        CHECK( szFile.compare( i, 4, "MTrk" ) == 0 );
+        size_t iEnd = i + 8 + readLong( szFile, i + 4 );
+        CHECK_EQUAL( iEnd, szFile.size() );
+        i += 8;
+        int64_t lTick = 0;
+        while( i < iEnd )
+        {
+            lTick += readVarLen( szFile, i );
+            Event grEvent;
+            grEvent.lTick = lTick;
+            unsigned char bStatus = szFile[ i ];
+            if( bStatus == 0xFF )
+            {
+                CHECK_EQUAL( (int)(unsigned char)szFile[ i + 1 ], 0x2F );
+                i += 3;
+                CHECK_EQUAL( i, iEnd );
+                break;
+            }
+            if( bStatus == 0xF0 )
+            {
+                ++i;
+                uint32_t cb = readVarLen( szFile, i );
+                grEvent.szBytes = std::string( 1, (char)0xF0 ) + szFile.substr( i, cb );
+                i += cb;
+            } else
+            {
+                size_t cb = bStatus == 0xF1 ? 2 : 3;
+                grEvent.szBytes = szFile.substr( i, cb );
+                i += cb;
+            }
+            rg.push_back( grEvent );
+        }
+        return rg;
+    }
+
+    struct Fixture
+    {
+        IdMap mpllId;
+        SongIdNotifier grBegin;
+        SongIdNotifier grEnd;
+
+        Fixture() : grBegin( mpllId, 0, SongIdNotifier::ESINC_NOTEON, 0 ),
+            grEnd( mpllId, 0, SongIdNotifier::ESINC_NOTEOFF, 1 ) {}
+    };
+
+    TEST_FIXTURE( Fixture, SongStream )
+    {
+        SmfExport target( FrameRate25::bRate, grBegin, grEnd );
+        SmfExport::Song grSong = { 300, 1010 };
+        int iDivision;
+        std::vector<Event> rg = parse( target.render( grSong ), iDivision );
+        CHECK_EQUAL( iDivision, ( ( -25 & 0xFF ) << 8 ) | 80 );
+
+        // begin notification and full frame 00:00:00:00 (25 fps)
+        CHECK( rg.size() > 2 );
+        CHECK_EQUAL( rg[ 0 ].lTick, 0 );
+        MidiMsg msg = grBegin.getMsg( 300 );
+        CHECK( rg[ 0 ].szBytes == std::string( { (char)( msg & 0xFF ), (char)( ( msg >> 8 ) & 0xFF ), (char)( msg >> 16 ) } ) );
+        const char rgchFull[] = { (char)0xF0, 0x7F, 0x7F, 0x01, 0x01, 0x20, 0, 0, 0, (char)0xF7 };
+        CHECK( rg[ 1 ].szBytes == std::string( rgchFull, 10 ) );
+
+        // quarter frames of frames 0..25 as the live encoder sends them, 20 ticks apart
+        MtcEncoderT<FrameRate25> grEncoder;
+        int cQuarter = 0;
+        size_t i = 2;
+        for( int iFrame = 0; iFrame < 26; iFrame += 2 )
+        {
+            MidiByte rgb[ 8 ];
+            grEncoder.nextQuarterFrames( rgb );
+            for( int iPiece = 0; iPiece < 8; ++iPiece, ++i )
+            {
+                int64_t lTick = iFrame * 80 + iPiece * 20;
+                if( lTick == 2020 )
+                {
+                    // end notification at 1010 ms
+                    CHECK_EQUAL( rg[ i ].lTick, 2020 );
+                    CHECK_EQUAL( (int)(unsigned char)rg[ i ].szBytes[ 0 ], 0x81 );
+                    ++i;
+                }
+                CHECK_EQUAL( rg[ i ].lTick, lTick );
+                CHECK_EQUAL( (int)(unsigned char)rg[ i ].szBytes[ 0 ], 0xF1 );
+                CHECK_EQUAL( (int)(unsigned char)rg[ i ].szBytes[ 1 ], (int)rgb[ iPiece ] );
+                ++cQuarter;
+            }
+        }
+        CHECK_EQUAL( i, rg.size() );
+        CHECK_EQUAL( cQuarter, 13 * 8 );
+    }
+
+    TEST_FIXTURE( Fixture, MmcAndDropFrame )
+    {
+        SmfExport target( FrameRate2997::bRate, grBegin, grEnd, 0x10 );
+        SmfExport::Song grSong = { 7, 0 };
+        int iDivision;
+        std::vector<Event> rg = parse( target.render( grSong ), iDivision );
+        CHECK_EQUAL( iDivision, ( ( -29 & 0xFF ) << 8 ) | 80 );
+        CHECK_EQUAL( rg.size(), 5u );
+        // locate to 00:00:00:00 with drop frame rate bits, deferred play, full frame, end
+        CHECK_EQUAL( rg[ 1 ].szBytes.size(), 13u );
+        CHECK_EQUAL( (int)rg[ 1 ].szBytes[ 2 ], 0x10 );
+        CHECK_EQUAL( (int)rg[ 1 ].szBytes[ 4 ], 0x44 );
+        CHECK_EQUAL( (int)rg[ 1 ].szBytes[ 7 ], 0x40 );
+        CHECK_EQUAL( (int)rg[ 2 ].szBytes[ 4 ], 0x03 );
+        CHECK_EQUAL( rg[ 3 ].szBytes.size(), 10u );
+        CHECK_EQUAL( (int)(unsigned char)rg[ 4 ].szBytes[ 0 ], 0x81 );
+    }
+
+    TEST_FIXTURE( Fixture, ParallelWrite )
+    {
+        char szDir[] = "/tmp/smfexportXXXXXX";
+        CHECK( mkdtemp( szDir ) );
+        std::vector<SmfExport::Song> rggrSongs;
+        for( int i = 0; i < 50; ++i )
+        {
+            SmfExport::Song grSong = { 100 + i, 1000 * i };
+            rggrSongs.push_back( grSong );
+        }
+        SmfExport target( FrameRate30::bRate, grBegin, grEnd );
+        target.write( rggrSongs, szDir, 4 );
+        for( int i = 0; i < 50; ++i )
+        {
+            char szName[ 64 ];
+            std::snprintf( szName, sizeof( szName ), "%s/%04d-%d.mid", szDir, i + 1, 100 + i );
+            std::ifstream fl( szName, std::ios::binary );
+            std::string szData( ( std::istreambuf_iterator<char>( fl ) ), std::istreambuf_iterator<char>() );
+            CHECK( szData == target.render( rggrSongs[ i ] ) );
+            std::remove( szName );
+        }
+        rmdir( szDir );
+    }
+
+    TEST( LoadSongs )
+    {
+        char szPath[] = "/tmp/smfsongsXXXXXX";
+        int fd = mkstemp( szPath );
+        CHECK( fd >= 0 );
+        close( fd );
+        {
+            std::ofstream fl( szPath );
+            fl << "# id duration\n12 183000\n\n  7 2500 # intro\n";
+        }
+        std::vector<SmfExport::Song> rggrSongs;
+        SmfExport::loadSongs( szPath, rggrSongs );
+        CHECK_EQUAL( rggrSongs.size(), 2u );
+        CHECK_EQUAL( rggrSongs[ 1 ].ilSongId, 7 );
+        CHECK_EQUAL( rggrSongs[ 1 ].lDuration, 2500 );
+        {
+            std::ofstream fl( szPath );
+            fl << "12 three minutes\n";
+        }
+        CHECK_THROW( SmfExport::loadSongs( szPath, rggrSongs ), std::runtime_error );
+        std::remove( szPath );
+    }
+}
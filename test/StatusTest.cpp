@@ -76,5 +76,44 @@ SUITE(StatusTest)
         CHECK( consttarget.getTime() == TimePoint( 1, ltp2 ) );
     }
 
+    TEST_FIXTURE( Fixture, Prediction )
+    {
+        // initially unknown
+        CHECK_EQUAL( consttarget.getDuration(), XTimePointInvalid );
+        CHECK_EQUAL( consttarget.getNextSongId(), XSongIdInvalid );
+
+        target.setDuration( 180000 );
+        target.setNextSongId( 43 );
+        CHECK_EQUAL( consttarget.getDuration(), 180000 );
+        CHECK_EQUAL( consttarget.getNextSongId(), 43 );
+    }
+
+    TEST( Coalesce )
+    {
+        Status older, newer;
+        older.setPlaybackStatus( Status::EPS_PLAYING );
+        older.setSongId( 1 );
+        older.setTime( 100, 1 );
+        newer = older;
+        newer.setTime( 200, 2 );
+
+        // pure playtime update
+        CHECK( ExchangeTraits<Status>::coalesce( older, newer ) );
+
+        // prediction data only needs the latest value
+        newer.setDuration( 180000 );
+        newer.setNextSongId( 3 );
+        CHECK( ExchangeTraits<Status>::coalesce( older, newer ) );
+
+        // song change
+        newer.setSongId( 2 );
+        CHECK( !ExchangeTraits<Status>::coalesce( older, newer ) );
+
+        // playback status change
+        newer.setSongId( 1 );
+        newer.setPlaybackStatus( Status::EPS_STOPPED );
+        CHECK( !ExchangeTraits<Status>::coalesce( older, newer ) );
+    }
+
 }
 
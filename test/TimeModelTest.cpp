@@ -0,0 +1,140 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for class TimeModel
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include "TimeModel.h"
+
+SUITE(TimeModelTest)
+{
+    struct Fixture
+    {
+        TimeModel target;
+    };
+
+    TEST_FIXTURE( Fixture, Default )
+    {
+        // real time speed
+        target.setIntercept( TimePoint( 0, 1000 ) );
+        CHECK_EQUAL( target.at( 0 ), 1000 );
+        CHECK_EQUAL( target.at( 1 ), 1000 + LTimeMs );
+        CHECK_EQUAL( target.at( 3600000 ), 1000 + 3600000 * LTimeMs );
+    }
+
+    TEST_FIXTURE( Fixture, Rounding )
+    {
+        // 1/3 ms per ms
+        target.setSlope( LTimeMs, 3 );
+        target.setIntercept( TimePoint( 0, 0 ) );
+        CHECK_EQUAL( target.at( 1 ), 333333 );
+        CHECK_EQUAL( target.at( 2 ), 666667 );
+        CHECK_EQUAL( target.at( 3 ), LTimeMs );
+    }
+
+    TEST_FIXTURE( Fixture, NegativeSlope )
+    {
+        target.setSlope( -5, 10 );
+        CHECK_EQUAL( target.getSlopeFixed(), 0 );
+        target.setIntercept( TimePoint( 100, 42 ) );
+        CHECK_EQUAL( target.at( 0 ), 42 );
+        CHECK_EQUAL( target.at( 1000000 ), 42 );
+    }
+
+    TEST_FIXTURE( Fixture, LongPlayback )
+    {
+        UNITTEST_TIME_CONSTRAINT(2000);
+        // 24 h of virtual playback with a sound card running 37 ppm fast and the model
+        // updated every 100 ms. Quarter frames at 30 fps are extrapolated in between.
+        const int64_t xEnd = 24LL * 3600 * 1000;
+        const LTimePoint lStart = 1000LL * 3600 * 1000000000; // local clock not starting at 0
+        const double dfRate = 1.0 - 37e-6;
+
+        // initial model from the first two statuses
+        target.setSlope( static_cast<LTimePoint>( 100 * dfRate * LTimeMs ), 100 );
+        target.setIntercept( TimePoint( 0, lStart ) );
+
+        LTimePoint lLast = lStart;
+        int64_t xUpdate = 0;
+        int cBackwards = 0;
+        double dfErrMax = 0;
+        for( int64_t x = 0; x <= xEnd; x += 8 )
+        {
+            if( x >= xUpdate + 100 )
+            {
+                TimePoint t1( xUpdate, lStart + static_cast<LTimePoint>( xUpdate * dfRate * LTimeMs ) );
+                TimePoint t2( x, lStart + static_cast<LTimePoint>( x * dfRate * LTimeMs ) );
+                target.setSlope( t2.ltime - t1.ltime, t2.xtime - t1.xtime );
+                target.setIntercept( t2 );
+                xUpdate = x;
+            }
+            LTimePoint l = target.at( x );
+            if( l < lLast )
+                ++cBackwards;
+            lLast = l;
+
+            double dfErr = static_cast<double>( l - lStart ) - x * dfRate * LTimeMs;
+            if( dfErr < 0 )
+                dfErr = -dfErr;
+            if( dfErr > dfErrMax )
+                dfErrMax = dfErr;
+        }
+
+        CHECK_EQUAL( cBackwards, 0 );
+        CHECK( dfErrMax < 10 ); // nanoseconds
+    }
+
+    TEST_FIXTURE( Fixture, Monotone )
+    {
+        // no matter the slope, time stamps must not decrease
+        const LTimePoint rgdL[] = { 1, 999999, 1000001, 123456789, 3 };
+        const XTimePoint rgdX[] = { 7, 1, 1, 97, 1000 };
+        for( unsigned int i = 0; i < sizeof( rgdL ) / sizeof( rgdL[ 0 ] ); ++i )
+        {
+            target.setSlope( rgdL[ i ], rgdX[ i ] );
+            target.setIntercept( TimePoint( 12345, 0 ) );
+            LTimePoint lLast = target.at( 0 );
+            for( int64_t x = 1; x < 100000; ++x )
+            {
+                LTimePoint l = target.at( x );
+                CHECK( l >= lLast );
+                lLast = l;
+            }
+        }
+    }
+
+    TEST_FIXTURE( Fixture, Extremes )
+    {
+        // largest xmms2 time (~24.8 days) at a slow local clock must not overflow
+        target.setSlope( 2 * LTimeMs, 1 );
+        target.setIntercept( TimePoint( 0, 0 ) );
+        CHECK_EQUAL( target.at( INT32_MAX ), 2 * LTimeMs * INT32_MAX );
+    }
+
+    TEST_FIXTURE( Fixture, Micro )
+    {
+        target.setSlope( 1001 * LTimeMs, 1000 );
+        target.setIntercept( TimePoint( 0, 7 ) );
+        // consistent with millisecond extrapolation
+        CHECK_EQUAL( target.atMicro( 5000000 ), target.at( 5000 ) );
+        CHECK_EQUAL( target.atMicro( 1500 ), 7 + 1501500 );
+        CHECK_EQUAL( target.atMicro( -1500 ), 7 - 1501500 );
+    }
+}
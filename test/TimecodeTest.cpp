@@ -0,0 +1,161 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for the MIDI time code frame arithmetic
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include "Timecode.h"
+
+SUITE(TimecodeTest)
+{
+    static void checkBSD( const MtcEncoder& target, int iFrame, int h, int m, int s, int f )
+    {
+        BSDTime grBSD = target.bsdTime( iFrame );
+        CHECK_EQUAL( grBSD.hour & 0x1F, h );
+        CHECK_EQUAL( grBSD.hour & 0x60, target.rateBits() );
+        CHECK_EQUAL( grBSD.minute, m );
+        CHECK_EQUAL( grBSD.second, s );
+        CHECK_EQUAL( grBSD.frame, f );
+    }
+
+    TEST( Pal )
+    {
+        MtcEncoderT<FrameRate25> target;
+        CHECK_EQUAL( target.rateBits(), 0x20 );
+        CHECK_EQUAL( target.frameAt( 39 ), 0 );
+        CHECK_EQUAL( target.frameAt( 40 ), 1 );
+        CHECK_EQUAL( target.frameStartUs( 3 ), 120000 );
+        checkBSD( target, 25 * 3661 + 7, 1, 1, 1, 7 );
+        // wraps after 24 h
+        checkBSD( target, 25 * 86400, 0, 0, 0, 0 );
+    }
+
+    TEST( Film )
+    {
+        MtcEncoderT<FrameRate24> target;
+        CHECK_EQUAL( target.rateBits(), 0x00 );
+        CHECK_EQUAL( target.frameAt( 1000 ), 24 );
+        CHECK_EQUAL( target.frameStartUs( 1 ), 41667 );
+        checkBSD( target, 24 * 59 + 23, 0, 0, 59, 23 );
+    }
+
+    TEST( Ntsc )
+    {
+        MtcEncoderT<FrameRate30> target;
+        CHECK_EQUAL( target.rateBits(), 0x60 );
+        CHECK_EQUAL( target.frameAt( 1000 ), 30 );
+        checkBSD( target, 30 * 60, 0, 1, 0, 0 );
+        checkBSD( target, 30 * 3600 * 17, 17, 0, 0, 0 );
+    }
+
+    TEST( NtscDropFrame )
+    {
+        MtcEncoderT<FrameRate2997> target;
+        CHECK_EQUAL( target.rateBits(), 0x40 );
+        // 30000 frames per 1001 s
+        CHECK_EQUAL( target.frameAt( 1001000 ), 30000 );
+        CHECK_EQUAL( target.frameStartUs( 30000 ), 1001000000LL );
+        CHECK_EQUAL( target.frameStartUs( 1 ), 33367 );
+
+        // labels 0 and 1 are dropped at each minute ...
+        checkBSD( target, 1799, 0, 0, 59, 29 );
+        checkBSD( target, 1800, 0, 1, 0, 2 );
+        checkBSD( target, 3597, 0, 1, 59, 29 );
+        checkBSD( target, 3598, 0, 2, 0, 2 );
+        // ... except for every tenth minute
+        checkBSD( target, 17981, 0, 9, 59, 29 );
+        checkBSD( target, 17982, 0, 10, 0, 0 );
+        checkBSD( target, 17983, 0, 10, 0, 1 );
+        checkBSD( target, 17982 + 1800, 0, 11, 0, 2 );
+        // an hour of drop-frame time code is 107892 frames
+        checkBSD( target, 107892, 1, 0, 0, 0 );
+    }
+
+    // the counter must produce the same quarter frames as a full computation per block
+    template<class Rate>
+    static void checkCounter( int iStart, int cBlocks )
+    {
+        MtcEncoderT<Rate> target;
+        target.seek( iStart );
+        for( int i = 0; i < cBlocks; ++i )
+        {
+            int iFrame = iStart + 2 * i;
+            CHECK_EQUAL( target.frame(), iFrame );
+            BSDTime grBSD = target.bsdTime( iFrame );
+            BSDTime grCur = target.current();
+            CHECK_EQUAL( grCur.hour, grBSD.hour );
+            CHECK_EQUAL( grCur.minute, grBSD.minute );
+            CHECK_EQUAL( grCur.second, grBSD.second );
+            CHECK_EQUAL( grCur.frame, grBSD.frame );
+            BSDTime grNext = target.successor( grCur ), grNextExpected = target.bsdTime( iFrame + 1 );
+            CHECK_EQUAL( grNext.hour, grNextExpected.hour );
+            CHECK_EQUAL( grNext.minute, grNextExpected.minute );
+            CHECK_EQUAL( grNext.second, grNextExpected.second );
+            CHECK_EQUAL( grNext.frame, grNextExpected.frame );
+
+            MidiByte rgb[ 8 ];
+            target.nextQuarterFrames( rgb );
+            MidiByte rgbExpected[] = {
+                static_cast<MidiByte>( 0x00 | ( grBSD.frame & 0x0F ) ),
+                static_cast<MidiByte>( 0x10 | ( grBSD.frame >> 4 ) ),
+                static_cast<MidiByte>( 0x20 | ( grBSD.second & 0x0F ) ),
+                static_cast<MidiByte>( 0x30 | ( grBSD.second >> 4 ) ),
+                static_cast<MidiByte>( 0x40 | ( grBSD.minute & 0x0F ) ),
+                static_cast<MidiByte>( 0x50 | ( grBSD.minute >> 4 ) ),
+                static_cast<MidiByte>( 0x60 | ( grBSD.hour & 0x0F ) ),
+                static_cast<MidiByte>( 0x70 | ( grBSD.hour >> 4 ) ) };
+            CHECK_ARRAY_EQUAL( rgb, rgbExpected, 8 );
+        }
+    }
+
+    TEST( Counter )
+    {
+        // across an hour and the 24 h wrap, even and odd frames
+        checkCounter<FrameRate24>( 24 * 3600 - 100, 200 );
+        checkCounter<FrameRate25>( 25 * 86400 - 101, 200 );
+        checkCounter<FrameRate30>( 30 * 3600 * 9 - 50, 100 );
+        // 24 h of drop-frame time code
+        checkCounter<FrameRate2997>( 0, 107892 * 12 );
+        checkCounter<FrameRate2997>( 1, 107892 * 12 );
+    }
+
+    // labels decode back to their frames
+    template<class Rate>
+    static void checkFrameOf( int iStart, int cFrames )
+    {
+        MtcEncoderT<Rate> target;
+        for( int iFrame = iStart; iFrame < iStart + cFrames; ++iFrame )
+            CHECK_EQUAL( target.frameOf( target.bsdTime( iFrame ) ), iFrame );
+    }
+
+    TEST( FrameOf )
+    {
+        checkFrameOf<FrameRate24>( 0, 24 * 120 );
+        checkFrameOf<FrameRate25>( 25 * 3600 - 10, 100 );
+        checkFrameOf<FrameRate30>( 30 * 3600 * 5, 100 );
+        checkFrameOf<FrameRate2997>( 0, 107892 * 2 );
+    }
+
+    TEST( CreateByRateBits )
+    {
+        for( MidiByte bRate = 0; bRate < 0x80; bRate += 0x20 )
+            CHECK_EQUAL( MtcEncoder::create( bRate )->rateBits(), bRate );
+    }
+}
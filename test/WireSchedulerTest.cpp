@@ -0,0 +1,171 @@
+/*  Xmms2MidiMaster - XMMS2-Client emitting MIDI timecode to synchronize arbitrary MIDI-capable devices
+ *  Copyright (C) 2014  Maximilian Stein
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @brief   Test for class WireScheduler
+ */
+
+#include <unittest++/UnitTest++.h>
+
+#include "WireScheduler.h"
+
+SUITE(WireSchedulerTest)
+{
+    // wire time of one byte on a DIN link
+    static const LTimePoint lByte = 320000;
+
+    // quarter frames of 30 FPS
+    static const LTimePoint lQuarter = 1000000000LL / 120;
+
+    struct Fixture
+    {
+        Fixture() : target( WireScheduler::cDinBaud ) {}
+
+        void submitShort( LTimePoint when, MidiMsg msg )
+        {
+            WireMsg grMsg;
+            grMsg.when = when;
+            grMsg.msg = msg;
+            target.submit( grMsg );
+            drain();
+        }
+
+        void submitFullFrame( LTimePoint when )
+        {
+            WireMsg grMsg = { when, 0, { 0xF0, 0x7F, 0x7F, 0x01, 0x01, 0, 0, 0, 0, 0xF7 } };
+            target.submit( grMsg );
+            drain();
+        }
+
+        void drain()
+        {
+            WireMsg grMsg;
+            LTimePoint lDelay;
+            while( target.pop( grMsg, lDelay ) )
+            {
+                rgMsg[ cMsg ] = grMsg;
+                rglDelay[ cMsg ] = lDelay;
+                ++cMsg;
+            }
+        }
+
+        WireScheduler target;
+        WireMsg rgMsg[ 64 ];
+        LTimePoint rglDelay[ 64 ];
+        int cMsg = 0;
+    };
+
+    TEST(SizeSysEx)
+    {
+        const MidiByte rgb[] = { 0xF0, 0x7F, 0x7F, 0x01, 0x01, 0, 0, 0, 0, 0xF7 };
+        CHECK_EQUAL( 10u, WireScheduler::sizeSysEx( rgb ) );
+    }
+
+    TEST(Unlimited)
+    {
+        WireScheduler target;
+        WireMsg grMsg = { 1000, 0x00F1, { 0 } };
+        target.submit( grMsg );
+        grMsg.when = 1001;
+        target.submit( grMsg );
+        LTimePoint lDelay;
+        CHECK( target.pop( grMsg, lDelay ) );
+        CHECK_EQUAL( 1000, grMsg.when );
+        CHECK_EQUAL( 0, lDelay );
+        CHECK( target.pop( grMsg, lDelay ) );
+        CHECK_EQUAL( 1001, grMsg.when );
+        CHECK( !target.pop( grMsg, lDelay ) );
+    }
+
+    TEST_FIXTURE(Fixture, MessageFitsGap)
+    {
+        LTimePoint l = 1000 * LTimeMs;
+        submitShort( l, 0x00F1 );
+        submitShort( l + lQuarter, 0x10F1 );
+        // 3 bytes right after a quarter frame fit before the next one
+        submitShort( l + lQuarter + 2 * lByte, 0x7F3C90 );
+        CHECK_EQUAL( 3, cMsg );
+        CHECK_EQUAL( 0, rglDelay[ 2 ] );
+        submitShort( l + 2 * lQuarter, 0x20F1 );
+        CHECK_EQUAL( 0, rglDelay[ 3 ] );
+    }
+
+    TEST_FIXTURE(Fixture, MessageDeferredBehindQuarterFrame)
+    {
+        LTimePoint l = 1000 * LTimeMs;
+        submitShort( l, 0x00F1 );
+        submitShort( l + lQuarter, 0x10F1 );
+        // would still be on the wire when the next quarter frame is due
+        LTimePoint when = l + 2 * lQuarter - 2 * lByte;
+        submitShort( when, 0x7F3C90 );
+        CHECK_EQUAL( 2, cMsg );
+        CHECK_EQUAL( 1u, target.deferred() );
+        submitShort( l + 2 * lQuarter, 0x20F1 );
+        CHECK_EQUAL( 4, cMsg );
+        CHECK_EQUAL( 0u, target.deferred() );
+        // the quarter frame is on time, the message follows
+        CHECK_EQUAL( 0x20F1u, rgMsg[ 2 ].msg );
+        CHECK_EQUAL( 0, rglDelay[ 2 ] );
+        CHECK_EQUAL( 0x7F3C90u, rgMsg[ 3 ].msg );
+        CHECK_EQUAL( l + 2 * lQuarter + 2 * lByte, rgMsg[ 3 ].when );
+        CHECK_EQUAL( rgMsg[ 3 ].when - when, rglDelay[ 3 ] );
+    }
+
+    TEST_FIXTURE(Fixture, FullFrameDelaysQuarterFrame)
+    {
+        LTimePoint l = 1000 * LTimeMs;
+        submitFullFrame( l );
+        submitShort( l + lByte, 0x00F1 );
+        CHECK_EQUAL( 2, cMsg );
+        CHECK_EQUAL( 9 * lByte, rglDelay[ 1 ] );
+    }
+
+    TEST(RunningStatusShortensBurst)
+    {
+        WireScheduler target( WireScheduler::cDinBaud, true );
+        LTimePoint l = 1000 * LTimeMs;
+        WireMsg grMsg = { l, 0x7F3C90, { 0 } };
+        target.submit( grMsg );
+        grMsg.msg = 0x7F3D90;
+        target.submit( grMsg );
+        grMsg.msg = 0x00F1;
+        target.submit( grMsg );
+        LTimePoint lDelay;
+        CHECK( target.pop( grMsg, lDelay ) );
+        CHECK( target.pop( grMsg, lDelay ) );
+        // the second message went without status byte
+        CHECK_EQUAL( 3 * lByte, lDelay );
+        CHECK( target.pop( grMsg, lDelay ) );
+        CHECK_EQUAL( 5 * lByte, lDelay );
+    }
+
+    TEST_FIXTURE(Fixture, EndStreamReleases)
+    {
+        LTimePoint l = 1000 * LTimeMs;
+        submitShort( l, 0x00F1 );
+        submitShort( l + lQuarter, 0x10F1 );
+        submitShort( l + 2 * lQuarter - lByte, 0x7F3C90 );
+        CHECK_EQUAL( 2, cMsg );
+        target.endStream();
+        drain();
+        CHECK_EQUAL( 3, cMsg );
+        CHECK_EQUAL( 0, rglDelay[ 2 ] );
+        // no stream any more
+        submitShort( l + 3 * lQuarter, 0x7F3D90 );
+        CHECK_EQUAL( 4, cMsg );
+    }
+}